@@ -0,0 +1,140 @@
+// CPU only: what --capture costs a worker per 1920x1080 frame, PNG encoding against the raw
+// row flip. The frame is a flat clear color with textured squares over a third of it, or
+// any image stb_image reads (a --capture frame, say) given as the first argument. Every
+// PNG is decoded again and compared, so a broken encoder can't look fast.
+//
+//     capture_bench [image] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <spdlog/spdlog.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "png_encoder.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct Frame
+{
+	std::vector<uint8_t> pixels; // RGBA8, bottom up like a readback
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+};
+
+static auto make_frame() -> Frame
+{
+	Frame frame;
+	frame.pixels.resize(size_t(frame.width) * frame.height * 4);
+	for (size_t i = 0; i < frame.pixels.size(); i += 4)
+	{
+		const uint8_t clear[4] = { 51, 76, 76, 255 };
+		std::memcpy(frame.pixels.data() + i, clear, 4);
+	}
+
+	// Squares of a grainy wood-ish texture, about a third of the frame
+	uint32_t seed = 1;
+	const auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+	for (uint32_t square = 0; square < 60; square++)
+	{
+		const uint32_t size = 100 + random() % 100;
+		const uint32_t x0 = random() % (frame.width - size);
+		const uint32_t y0 = random() % (frame.height - size);
+		for (uint32_t y = y0; y < y0 + size; y++)
+		{
+			for (uint32_t x = x0; x < x0 + size; x++)
+			{
+				uint8_t* p = frame.pixels.data() + (size_t(y) * frame.width + x) * 4;
+				const uint32_t grain = ((x - x0) * 7 + (y - y0) / 3) % 32 + random() % 8;
+				p[0] = static_cast<uint8_t>(140 + grain);
+				p[1] = static_cast<uint8_t>(90 + grain);
+				p[2] = static_cast<uint8_t>(40 + grain / 2);
+			}
+		}
+	}
+	return frame;
+}
+
+static auto load_frame(const char* path, Frame& frame) -> bool
+{
+	int32_t width, height, channels;
+	stbi_set_flip_vertically_on_load(true);
+	uint8_t* pixels = stbi_load(path, &width, &height, &channels, 4);
+	if (!pixels)
+		return false;
+	frame.width = width;
+	frame.height = height;
+	frame.pixels.assign(pixels, pixels + size_t(width) * height * 4);
+	stbi_image_free(pixels);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Frame frame;
+	if (argc > 1 && std::strcmp(argv[1], "-") != 0)
+	{
+		if (!load_frame(argv[1], frame))
+		{
+			spdlog::error("Failed to read {}", argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+	else
+	{
+		frame = make_frame();
+	}
+	const uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 20;
+
+	const size_t stride = size_t(frame.width) * 4;
+	const uint8_t* top = frame.pixels.data() + stride * (frame.height - 1);
+	const double megapixels = frame.width * frame.height / 1e6;
+
+	// What FrameCapture does for raw frames, minus the write
+	std::vector<uint8_t> raw(frame.pixels.size());
+	auto start = bench_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		for (uint32_t y = 0; y < frame.height; y++)
+		{
+			uint8_t* row = raw.data() + y * stride;
+			std::memcpy(row, top - y * stride, stride);
+			for (size_t x = 3; x < stride; x += 4)
+				row[x] = 0xff;
+		}
+	}
+	const double raw_ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count() / iterations;
+
+	PngEncoder encoder;
+	size_t png_size = 0;
+	start = bench_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+		png_size = encoder.encode(top, frame.width, frame.height, -static_cast<ptrdiff_t>(stride), true).size();
+	const double png_ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count() / iterations;
+
+	const auto png = encoder.encode(top, frame.width, frame.height, -static_cast<ptrdiff_t>(stride), true);
+	int32_t width, height, channels;
+	stbi_set_flip_vertically_on_load(false);
+	std::unique_ptr<uint8_t, decltype(&stbi_image_free)> decoded(
+		stbi_load_from_memory(png.data(), static_cast<int>(png.size()), &width, &height, &channels, 4), stbi_image_free);
+	bool matches = decoded && uint32_t(width) == frame.width && uint32_t(height) == frame.height;
+	for (size_t i = 0; matches && i < raw.size(); i++)
+		matches = decoded.get()[i] == raw[i];
+
+	spdlog::info("{}x{}, {} iterations", frame.width, frame.height, iterations);
+	spdlog::info("raw: {:8.2f} ms per frame, {:7.1f} Mpixel/s, {:.1f} MiB", raw_ms, megapixels / raw_ms * 1000.0, raw.size() / (1024.0 * 1024.0));
+	spdlog::info("png: {:8.2f} ms per frame, {:7.1f} Mpixel/s, {:.2f} MiB ({:.1f}% of raw RGB), {} workers keep up with 60 fps",
+		png_ms, megapixels / png_ms * 1000.0, png_size / (1024.0 * 1024.0), 100.0 * png_size / (frame.width * frame.height * 3.0),
+		static_cast<uint32_t>(png_ms * 60.0 / 1000.0) + 1);
+	if (!matches)
+	{
+		spdlog::error("PNG DOES NOT DECODE TO THE FRAME");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
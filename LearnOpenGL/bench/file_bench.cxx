@@ -0,0 +1,204 @@
+// CPU only: times the old getline / stringstream read_file and truncating write_file
+// against file.h (one read, or a mapping) on one large file and many small ones, then
+// expanding #includes in a set of shaders sharing a library, re-read per shader the old
+// way against ShaderPreprocessor cold and warm. Files come out of the page cache
+//
+//     file_bench [large file MiB] [shader count]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "file.h"
+#include "legacy_file.h"
+#include "shader_preprocessor.h"
+
+namespace fs = std::filesystem;
+using bench_clock = std::chrono::steady_clock;
+
+static auto elapsed_ms(bench_clock::time_point start) -> double
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// Reads every byte, so a mapping pays for its page faults like the others pay for copying
+static auto checksum(const char* data, size_t size) -> uint64_t
+{
+	uint64_t sum = 0;
+	for (size_t i = 0; i < size; i++)
+		sum += static_cast<uint8_t>(data[i]);
+	return sum;
+}
+
+static auto text_of_size(size_t size) -> std::string
+{
+	std::string text;
+	text.reserve(size + 64);
+	for (uint32_t i = 0; text.size() < size; i++)
+		fmt::format_to(std::back_inserter(text), "vec4 value{} = vec4({}.0, 0.25, 0.5, 1.0); // line {}\n", i, i % 97, i);
+	return text;
+}
+
+static void write_raw(const fs::path& path, const std::string& text)
+{
+	std::error_code ec;
+	if (!write_file(path, text, ec))
+	{
+		spdlog::error("Failed to write {}: {}", path.string(), ec.message());
+		exit(EXIT_FAILURE);
+	}
+}
+
+// What #include support on top of the old read_file looks like, every include read again
+static void legacy_expand(const fs::path& path, std::string& out)
+{
+	std::istringstream stream(legacy_read_file(path.string().c_str()));
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		if (line.rfind("#include \"", 0) == 0)
+			legacy_expand(path.parent_path() / line.substr(10, line.size() - 11), out);
+		else
+			out.append(line).push_back('\n');
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t large_mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+	const uint32_t shader_count = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 200;
+	const fs::path directory = fs::temp_directory_path() / "file_bench";
+	fs::remove_all(directory);
+	fs::create_directories(directory);
+
+	std::error_code ec;
+
+	// One large file
+	{
+		const auto path = directory / "large.txt";
+		const auto text = text_of_size(large_mib * 1024 * 1024);
+		write_raw(path, text);
+
+		auto start = bench_clock::now();
+		const auto legacy = legacy_read_file(path.string().c_str());
+		const uint64_t legacy_sum = checksum(legacy.data(), legacy.size());
+		const double legacy_ms = elapsed_ms(start);
+
+		start = bench_clock::now();
+		const auto read = read_file(path, ec);
+		const uint64_t read_sum = checksum(read.data(), read.size());
+		const double read_ms = elapsed_ms(start);
+
+		start = bench_clock::now();
+		const auto view = map_file(path, ec);
+		const uint64_t map_sum = checksum(view.data(), view.size());
+		const double map_ms = elapsed_ms(start);
+
+		if (legacy_sum != read_sum || read_sum != map_sum)
+			spdlog::error("Checksums differ: {} {} {}", legacy_sum, read_sum, map_sum);
+		spdlog::info("{} MiB file: legacy read_file {:.1f} ms, read_file {:.1f} ms ({:.1f}x), map_file {:.1f} ms ({:.1f}x)",
+			large_mib, legacy_ms, read_ms, legacy_ms / read_ms, map_ms, legacy_ms / map_ms);
+	}
+
+	// Many small files
+	{
+		constexpr uint32_t small_count = 2000;
+		const auto text = text_of_size(8 * 1024);
+		std::vector<fs::path> paths;
+		for (uint32_t i = 0; i < small_count; i++)
+		{
+			paths.push_back(directory / fmt::format("small{}.txt", i));
+			write_raw(paths.back(), text);
+		}
+
+		auto start = bench_clock::now();
+		uint64_t sum = 0;
+		for (const auto& path : paths)
+		{
+			const auto legacy = legacy_read_file(path.string().c_str());
+			sum += checksum(legacy.data(), legacy.size());
+		}
+		const double legacy_ms = elapsed_ms(start);
+
+		start = bench_clock::now();
+		for (const auto& path : paths)
+		{
+			const auto read = read_file(path, ec);
+			sum -= checksum(read.data(), read.size());
+		}
+		const double read_ms = elapsed_ms(start);
+
+		if (sum != 0)
+			spdlog::error("Checksums differ");
+		spdlog::info("{} x 8 KiB files: legacy read_file {:.1f} ms, read_file {:.1f} ms ({:.1f}x)",
+			small_count, legacy_ms, read_ms, legacy_ms / read_ms);
+
+		// Writing the same files again, the new write_file notices nothing changed
+		start = bench_clock::now();
+		for (const auto& path : paths)
+			legacy_write_file(path.string().c_str(), text.c_str());
+		const double legacy_write_ms = elapsed_ms(start);
+
+		start = bench_clock::now();
+		for (const auto& path : paths)
+			write_file(path, text, ec);
+		const double unchanged_write_ms = elapsed_ms(start);
+
+		const auto changed = text_of_size(8 * 1024 + 1);
+		start = bench_clock::now();
+		for (const auto& path : paths)
+			write_file(path, changed, ec);
+		const double changed_write_ms = elapsed_ms(start);
+
+		spdlog::info("{} x 8 KiB writes: legacy write_file {:.1f} ms, write_file {:.1f} ms unchanged, {:.1f} ms changed (atomic rename)",
+			small_count, legacy_write_ms, unchanged_write_ms, changed_write_ms);
+	}
+
+	// Shaders sharing a library
+	{
+		write_raw(directory / "common.glsl", text_of_size(16 * 1024));
+		write_raw(directory / "lighting.glsl", "#include \"common.glsl\"\n" + text_of_size(8 * 1024));
+		std::vector<fs::path> shaders;
+		for (uint32_t i = 0; i < shader_count; i++)
+		{
+			shaders.push_back(directory / fmt::format("shader{}.glsl", i));
+			write_raw(shaders.back(), "#version 430 core\n#include \"common.glsl\"\n#include \"lighting.glsl\"\n" + text_of_size(4 * 1024));
+		}
+
+		auto start = bench_clock::now();
+		size_t legacy_bytes = 0;
+		for (const auto& path : shaders)
+		{
+			std::string out;
+			legacy_expand(path, out);
+			legacy_bytes += out.size();
+		}
+		const double legacy_ms = elapsed_ms(start);
+
+		ShaderPreprocessor preprocessor;
+		double pass_ms[2] = {};
+		size_t bytes = 0;
+		for (double& ms : pass_ms)
+		{
+			start = bench_clock::now();
+			bytes = 0;
+			for (const auto& path : shaders)
+				bytes += preprocessor.load(path)->text.size();
+			ms = elapsed_ms(start);
+		}
+
+		// The legacy expansion pastes common.glsl twice and has no #line directives
+		spdlog::info("{} shaders, 2 shared includes: legacy {:.1f} ms ({} KiB), preprocessor cold {:.1f} ms, warm {:.1f} ms ({} KiB, {} reads, {} cache hits)",
+			shader_count, legacy_ms, legacy_bytes / 1024, pass_ms[0], pass_ms[1], bytes / 1024, preprocessor.stats().reads, preprocessor.stats().hits);
+	}
+
+	fs::remove_all(directory);
+	return 0;
+}
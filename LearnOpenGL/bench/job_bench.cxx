@@ -0,0 +1,135 @@
+// CPU only: the simulation's per frame work (world bounds, bvh refit, frustum cull and
+// model matrices of the survivors) for a large scene, on the job system with 1, 2, 4 ...
+// threads up to the core count. Prints the median frame time of each stage, the speedup
+// over one thread and the parallel efficiency, and checks every run matches one thread
+//
+//     job_bench [objects] [frames] [max threads, default the core count]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "culling.h"
+#include "hash.h"
+#include "job_system.h"
+#include "scene.h"
+#include "transform.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static auto elapsed_ms(bench_clock::time_point start) -> double
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static auto median(std::vector<double> values) -> double
+{
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+struct Timings
+{
+	double bounds = 0.0;
+	double refit = 0.0;
+	double cull = 0.0;
+	double transforms = 0.0;
+	double frame = 0.0;
+	uint64_t checksum = 0;
+	JobSystem::Stats stats;
+};
+
+int main(int argc, char** argv)
+{
+	const uint32_t count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1'000'000;
+	const uint32_t frames = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 30;
+
+	const auto positions = make_cube_positions(count);
+	TransformSoA transforms;
+	transforms.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+		transforms.push_back(positions[i], glm::vec3(1.0f, 0.3f, 0.5f), glm::radians(20.0f * i));
+
+	const Aabb cube{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+	std::vector<Aabb> bounds;
+	compute_world_bounds(transforms, cube, bounds);
+	Bvh bvh;
+	bvh.build(bounds);
+
+	// The orbiting camera of the app, on its fixed 60 Hz clock
+	const float_t radius = orbit_radius(count);
+	const float_t far_plane = std::max(100.0f, radius + scene_extent(count) * 2.0f);
+	const auto proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, far_plane);
+
+	const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t max_threads = argc > 3 ? std::max(1u, static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10))) : cores;
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2)
+		thread_counts.push_back(threads);
+	thread_counts.push_back(max_threads);
+
+	spdlog::info("{} objects, {} frames, {} cores, {} transform kernel", count, frames, cores, simd_level_name(best_simd_level()));
+
+	std::vector<uint32_t> visible;
+	visible.reserve(count);
+	std::vector<glm::mat4> matrices(count);
+
+	std::vector<Timings> results;
+	for (const uint32_t threads : thread_counts)
+	{
+		JobSystem jobs({ threads });
+		std::vector<double> stage[5];
+		uint64_t checksum = 0;
+
+		for (uint32_t frame = 0; frame < frames; frame++)
+		{
+			const double time = frame / 60.0;
+			const glm::vec3 camera(std::sin(time) * radius, 0.0f, std::cos(time) * radius);
+			const auto view = glm::lookAt(camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+			const auto frame_start = bench_clock::now();
+			auto start = frame_start;
+			compute_world_bounds(jobs, transforms, cube, bounds);
+			stage[0].push_back(elapsed_ms(start));
+
+			start = bench_clock::now();
+			bvh.refit(jobs, bounds);
+			stage[1].push_back(elapsed_ms(start));
+
+			start = bench_clock::now();
+			visible.clear();
+			bvh.cull(jobs, extract_frustum(proj * view), bounds, visible);
+			stage[2].push_back(elapsed_ms(start));
+
+			start = bench_clock::now();
+			build_model_matrices(jobs, transforms, visible.data(), visible.size(), &matrices[0][0][0]);
+			stage[3].push_back(elapsed_ms(start));
+			stage[4].push_back(elapsed_ms(frame_start));
+
+			checksum += visible.size();
+			if (frame + 1 == frames)
+				checksum ^= fnv1a_bytes(visible.data(), visible.size() * sizeof(uint32_t)) ^ fnv1a_bytes(matrices.data(), visible.size() * sizeof(glm::mat4));
+		}
+
+		results.push_back({ median(stage[0]), median(stage[1]), median(stage[2]), median(stage[3]), median(stage[4]), checksum, jobs.stats() });
+	}
+
+	const auto& base = results.front();
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const auto& r = results[i];
+		const double speedup = base.frame / r.frame;
+		spdlog::info("{:>2} threads: frame {:7.2f} ms ({:4.2f}x, {:3.0f}% efficiency) = bounds {:6.2f} + refit {:6.2f} + cull {:6.2f} + transforms {:6.2f} ms, {} jobs, {} stolen{}",
+			thread_counts[i], r.frame, speedup, 100.0 * speedup / thread_counts[i], r.bounds, r.refit, r.cull, r.transforms,
+			r.stats.executed, r.stats.stolen, r.checksum == base.checksum ? "" : ", RESULTS DIFFER");
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+// CPU only: welds, cache optimizes and quantizes a large grid mesh whose
+// triangles arrive in random order, the worst case for the vertex cache
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#include "mesh.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static auto elapsed_ms(bench_clock::time_point start) -> double
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t target_triangles = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1'000'000;
+	const auto n = static_cast<uint32_t>(std::ceil(std::sqrt(target_triangles / 2.0)));
+
+	// n x n quads, two triangles each, written out as a flat x, y, z, u, v triangle list
+	std::vector<uint32_t> order(n * n * 2);
+	for (uint32_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+	std::vector<float_t> flat;
+	flat.reserve(order.size() * 3 * 5);
+	const auto corner = [&](uint32_t x, uint32_t y) {
+		const float_t u = static_cast<float_t>(x) / n;
+		const float_t v = static_cast<float_t>(y) / n;
+		flat.insert(flat.end(), { u - 0.5f, 0.0f, v - 0.5f, u, v });
+	};
+	for (uint32_t t : order)
+	{
+		const uint32_t quad = t / 2;
+		const uint32_t x = quad % n;
+		const uint32_t y = quad / n;
+		if (t % 2 == 0)
+		{
+			corner(x, y); corner(x + 1, y); corner(x + 1, y + 1);
+		}
+		else
+		{
+			corner(x, y); corner(x + 1, y + 1); corner(x, y + 1);
+		}
+	}
+	const size_t vertex_count = flat.size() / 5;
+
+	spdlog::info("{} triangles, {} unindexed vertices", order.size(), vertex_count);
+
+	auto start = bench_clock::now();
+	const auto welded = build_indexed_mesh(flat.data(), vertex_count, 5);
+	const double weld_ms = elapsed_ms(start);
+
+	auto optimized = welded;
+	start = bench_clock::now();
+	optimize_vertex_cache(optimized);
+	const double optimize_ms = elapsed_ms(start);
+
+	start = bench_clock::now();
+	const auto quantized = quantize_mesh(optimized);
+	const double quantize_ms = elapsed_ms(start);
+
+	spdlog::info("weld {:.1f} ms, vertex cache optimize {:.1f} ms, quantize {:.1f} ms", weld_ms, optimize_ms, quantize_ms);
+	log_mesh_report("grid", vertex_count, sizeof(float_t) * 5, welded, optimized, quantized);
+
+	return 0;
+}
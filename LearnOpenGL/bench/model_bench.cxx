@@ -0,0 +1,170 @@
+// CPU only: writes a rippled grid of 1M+ triangles as an OBJ, then times loading it the old
+// way (read_file plus a stringstream per line), through import_obj on one thread and on
+// every core, and from the cooked .lmesh mapping later runs take. Everything comes out of
+// the page cache, so this measures parsing, not the disk
+//
+//     model_bench [triangles] [obj path]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "legacy_file.h"
+#include "mapped_file.h"
+#include "mesh_file.h"
+#include "mesh_import.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static auto elapsed_ms(bench_clock::time_point start) -> double
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static void write_grid(const std::filesystem::path& path, uint32_t n)
+{
+	std::string text;
+	auto out = std::back_inserter(text);
+	for (uint32_t y = 0; y <= n; y++)
+	{
+		for (uint32_t x = 0; x <= n; x++)
+		{
+			const float u = static_cast<float>(x) / n;
+			const float v = static_cast<float>(y) / n;
+			fmt::format_to(out, "v {:.6f} {:.6f} {:.6f}\nvt {:.6f} {:.6f}\n", u - 0.5f, 0.02f * std::sin(u * 40.0f) * std::cos(v * 40.0f), v - 0.5f, u, v);
+		}
+	}
+	fmt::format_to(out, "usemtl grid\n");
+	for (uint32_t y = 0; y < n; y++)
+	{
+		for (uint32_t x = 0; x < n; x++)
+		{
+			const uint32_t a = y * (n + 1) + x + 1;
+			const uint32_t b = a + 1;
+			const uint32_t c = b + n + 1;
+			const uint32_t d = a + n + 1;
+			fmt::format_to(out, "f {}/{} {}/{} {}/{} {}/{}\n", a, a, b, b, c, c, d, d);
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+// What a loader built on the old read_file looks like, triangles out without welding
+static auto naive_parse(const char* path) -> size_t
+{
+	const std::string text = legacy_read_file(path);
+	std::istringstream stream(text);
+	std::vector<float> positions;
+	std::vector<float> uvs;
+	std::vector<uint32_t> corners;
+
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::istringstream fields(line);
+		std::string keyword;
+		fields >> keyword;
+		if (keyword == "v")
+		{
+			float x, y, z;
+			fields >> x >> y >> z;
+			positions.insert(positions.end(), { x, y, z });
+		}
+		else if (keyword == "vt")
+		{
+			float u, v;
+			fields >> u >> v;
+			uvs.insert(uvs.end(), { u, v });
+		}
+		else if (keyword == "f")
+		{
+			std::vector<uint32_t> face;
+			std::string corner;
+			while (fields >> corner)
+				face.push_back(static_cast<uint32_t>(std::stoul(corner.substr(0, corner.find('/')))) - 1);
+			for (size_t i = 2; i < face.size(); i++)
+				corners.insert(corners.end(), { face[0], face[i - 1], face[i] });
+		}
+	}
+	return corners.size() / 3;
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t target_triangles = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1'000'000;
+	const std::filesystem::path path = argc > 2 ? std::filesystem::path(argv[2]) : std::filesystem::temp_directory_path() / "model_bench.obj";
+	const auto n = static_cast<uint32_t>(std::ceil(std::sqrt(target_triangles / 2.0)));
+
+	write_grid(path, n);
+	const auto source_size = std::filesystem::file_size(path);
+	spdlog::info("{}: {} triangles, {:.1f} MiB", path.string(), size_t(n) * n * 2, source_size / (1024.0 * 1024.0));
+
+	auto start = bench_clock::now();
+	const size_t naive_triangles = naive_parse(path.string().c_str());
+	const double naive_ms = elapsed_ms(start);
+	spdlog::info("read_file + stringstream: {:.1f} ms, {} triangles, unwelded", naive_ms, naive_triangles);
+
+	MappedFile source;
+	if (!source.open(path.string().c_str()))
+	{
+		spdlog::error("Failed to map {}", path.string());
+		return EXIT_FAILURE;
+	}
+
+	ImportedMesh imported;
+	std::vector<uint32_t> thread_counts{ 1 };
+	if (std::thread::hardware_concurrency() > 1)
+		thread_counts.push_back(std::thread::hardware_concurrency());
+	for (const uint32_t threads : thread_counts)
+	{
+		JobSystem jobs({ threads });
+		start = bench_clock::now();
+		imported = import_obj(jobs, source.data(), source.size());
+		spdlog::info("import_obj, {} threads: {:.1f} ms ({} vertices)", threads, elapsed_ms(start), imported.vertices.size());
+	}
+
+	auto cache_path = path;
+	cache_path += mesh_file_extension;
+	start = bench_clock::now();
+	if (!write_mesh_file(cache_path, imported, source_size, 0))
+	{
+		spdlog::error("Failed to write {}", cache_path.string());
+		return EXIT_FAILURE;
+	}
+	spdlog::info("write {}: {:.1f} ms, {:.1f} MiB", cache_path.string(), elapsed_ms(start), std::filesystem::file_size(cache_path) / (1024.0 * 1024.0));
+
+	// Map, validate and read every byte once, which is what the upload does to the pages
+	start = bench_clock::now();
+	MappedFile cache;
+	const MeshFileHeader* header = cache.open(cache_path.string().c_str()) ? parse_mesh_file(cache.data(), cache.size()) : nullptr;
+	if (!header)
+	{
+		spdlog::error("{} doesn't parse back", cache_path.string());
+		return EXIT_FAILURE;
+	}
+	uint64_t sum = 0;
+	const auto* words = reinterpret_cast<const uint64_t*>(cache.data());
+	for (size_t i = 0; i < cache.size() / sizeof(uint64_t); i++)
+		sum += words[i];
+	const double cache_ms = elapsed_ms(start);
+	spdlog::info("map {} and read it through: {:.1f} ms ({:.1f}x faster than read_file + stringstream, checksum {:x})",
+		mesh_file_extension, cache_ms, naive_ms / cache_ms, sum);
+
+	std::filesystem::remove(cache_path);
+	if (argc <= 2)
+		std::filesystem::remove(path);
+	return 0;
+}
@@ -0,0 +1,99 @@
+// CPU only microbenchmark: per object glm (the path main.cxx used) against
+// the structure of arrays batch kernels, for model and model-view-projection matrices
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene.h"
+#include "transform.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+constexpr int runs = 15;
+
+template<typename F>
+static auto median_ms(F&& fn) -> double
+{
+	std::vector<double> times;
+	for (int i = 0; i < runs; i++)
+	{
+		const auto start = bench_clock::now();
+		fn();
+		times.push_back(std::chrono::duration<double, std::milli>(bench_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+static auto max_error(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) -> float_t
+{
+	float_t err = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				err = std::max(err, std::abs(a[i][c][r] - b[i][c][r]));
+	return err;
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1'000'000;
+
+	const auto positions = make_cube_positions(count);
+	const glm::vec3 axis(1.0f, 0.3f, 0.5f);
+
+	TransformSoA transforms;
+	transforms.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		transforms.push_back(positions[i], axis, glm::radians(20.0f * i));
+	}
+
+	const auto view = glm::lookAt(glm::vec3(10.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const auto proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	const auto view_proj = proj * view;
+
+	std::vector<glm::mat4> reference(count), reference_mvp(count), out(count);
+
+	spdlog::info("{} transforms, best simd level {}", count, simd_level_name(best_simd_level()));
+
+	const double glm_ms = median_ms([&] {
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto model = glm::translate(glm::mat4(1.0f), positions[i]);
+			reference[i] = glm::rotate(model, glm::radians(20.0f * i), axis);
+		}
+	});
+	const double glm_mvp_ms = median_ms([&] {
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto model = glm::translate(glm::mat4(1.0f), positions[i]);
+			reference_mvp[i] = view_proj * glm::rotate(model, glm::radians(20.0f * i), axis);
+		}
+	});
+	spdlog::info("{:>14} model {:8.3f} ms   mvp {:8.3f} ms", "glm per object", glm_ms, glm_mvp_ms);
+
+	for (auto level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 })
+	{
+		if (level > best_simd_level())
+			continue;
+
+		const double model_ms = median_ms([&] { build_model_matrices(transforms, &out[0][0][0], level); });
+		const float_t model_err = max_error(reference, out);
+		const double mvp_ms = median_ms([&] { build_mvp_matrices(transforms, view_proj, &out[0][0][0], level); });
+		const float_t mvp_err = max_error(reference_mvp, out);
+
+		spdlog::info("{:>14} model {:8.3f} ms ({:5.2f}x, max err {:.2e})   mvp {:8.3f} ms ({:5.2f}x, max err {:.2e})",
+			fmt::format("soa {}", simd_level_name(level)),
+			model_ms, glm_ms / model_ms, model_err,
+			mvp_ms, glm_mvp_ms / mvp_ms, mvp_err);
+	}
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+// CPU only: cost of setting a uniform through the old vector based ShaderProgram::setUniform
+// against UniformTable. The GL entry points are swapped for empty functions, so only the
+// wrapper (lookup, allocation, dispatch) is measured, not the driver.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "uniforms.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static uint64_t g_calls = 0;
+
+template<typename... Args>
+static void APIENTRY count_call(Args...) { g_calls++; }
+
+static auto APIENTRY fake_location(GLuint, const GLchar* name) -> GLint
+{
+	return static_cast<GLint>(name[0]);
+}
+
+// ShaderProgram::setUniform as it was: arguments by value, cache keyed on the name pointer, contains + at
+class VectorUniforms
+{
+private:
+	std::unordered_map<const char*, uint32_t> m_uniforms = {};
+	uint32_t id = 1;
+public:
+	void setUniform(const char* name, std::vector<float_t> value)
+	{
+		if (value.empty())
+			throw std::invalid_argument("Not enough elements in vertex");
+		else if (value.size() > 4)
+			throw std::invalid_argument("too many elements, max is 4");
+
+		if (!m_uniforms.contains(name))
+		{
+			auto uniform = glGetUniformLocation(id, name);
+			m_uniforms.insert({ name, uniform });
+		}
+
+		switch (value.size())
+		{
+		case 1: glUniform1f(m_uniforms.at(name), value[0]); break;
+		case 2: glUniform2f(m_uniforms.at(name), value[0], value[1]); break;
+		case 3: glUniform3f(m_uniforms.at(name), value[0], value[1], value[2]); break;
+		case 4: glUniform4f(m_uniforms.at(name), value[0], value[1], value[2], value[3]); break;
+		}
+	}
+};
+
+template<typename F>
+static auto ns_per_call(uint32_t iterations, F&& f) -> double
+{
+	const auto start = bench_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+		f(static_cast<float_t>(i));
+	return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t iterations = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 10'000'000;
+
+	glad_glGetUniformLocation = fake_location;
+	glad_glUniform1f = count_call<GLint, GLfloat>;
+	glad_glUniform4f = count_call<GLint, GLfloat, GLfloat, GLfloat, GLfloat>;
+	glad_glProgramUniform1f = count_call<GLuint, GLint, GLfloat>;
+	glad_glProgramUniform4fv = count_call<GLuint, GLint, GLsizei, const GLfloat*>;
+
+	// A table the size of a typical material shader, so lookups aren't trivially short
+	UniformTable table(1);
+	const char* names[] = { "model", "view", "proj", "normal_matrix", "camera_pos", "light_dir", "light_color",
+		"ambient", "roughness", "metallic", "exposure", "time", "tint", "albedo_map", "normal_map", "instanced" };
+	for (int32_t i = 0; i < static_cast<int32_t>(std::size(names)); i++)
+		table.add(names[i], i, std::string_view(names[i]) == "tint" ? GL_FLOAT_VEC4 : GL_FLOAT, 1);
+
+	VectorUniforms before;
+
+	const double vector_float = ns_per_call(iterations, [&](float_t v) { before.setUniform("exposure", { v }); });
+	const double vector_vec4 = ns_per_call(iterations, [&](float_t v) { before.setUniform("tint", { v, v, v, 1.0f }); });
+
+	const double hashed_float = ns_per_call(iterations, [&](float_t v) { table.set("exposure", v); });
+	const double hashed_vec4 = ns_per_call(iterations, [&](float_t v) { table.set("tint", glm::vec4(v, v, v, 1.0f)); });
+
+	const Uniform exposure = table.find("exposure");
+	const Uniform tint = table.find("tint");
+	const double handle_float = ns_per_call(iterations, [&](float_t v) { table.set(exposure, v); });
+	const double handle_vec4 = ns_per_call(iterations, [&](float_t v) { table.set(tint, glm::vec4(v, v, v, 1.0f)); });
+
+	spdlog::info("{} calls each, GL entry points stubbed out ({} stub calls)", iterations, g_calls);
+	spdlog::info("{:<34} {:>8} {:>8}", "", "float", "vec4");
+	spdlog::info("{:<34} {:>5.1f} ns {:>5.1f} ns", "vector setUniform", vector_float, vector_vec4);
+	spdlog::info("{:<34} {:>5.1f} ns {:>5.1f} ns", "UniformTable::set(\"name\")", hashed_float, hashed_vec4);
+	spdlog::info("{:<34} {:>5.1f} ns {:>5.1f} ns", "UniformTable::set(handle)", handle_float, handle_vec4);
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation counters. alloc_stats.cxx replaces the global operator new / delete
+// with versions that count every call on any thread (two relaxed atomic adds) before
+// forwarding to malloc, so the difference between two snapshots is what the code in
+// between allocated. Targets that don't link alloc_stats.cxx keep the default heap.
+//
+//     const auto before = alloc_stats();
+//     draw_frame();
+//     const uint64_t allocated = alloc_stats().allocations - before.allocations;
+struct AllocStats
+{
+	uint64_t allocations = 0; // operator new calls, of any form
+	uint64_t bytes = 0;       // Requested by them
+	uint64_t frees = 0;       // operator delete calls with a non-null pointer
+};
+
+auto alloc_stats() noexcept -> AllocStats;
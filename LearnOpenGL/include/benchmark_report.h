@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_stats.h"
+
+// Records every frame of a headless run and summarizes it as JSON, so builds can be
+// compared by a script. Frame times include present(), unlike FrameStatsReporter.
+//
+// Heap allocations are split into warm-up and steady state, the frames after loading
+// settled, which are expected not to allocate at all.
+class BenchmarkReport
+{
+public:
+	struct Info
+	{
+		std::string renderer;
+		std::string version;
+		const char* mode;
+		const char* cull;
+		uint32_t instances;
+		int32_t width;
+		int32_t height;
+	};
+private:
+	using clock = std::chrono::steady_clock;
+
+	clock::time_point m_frame_start;
+	std::vector<double> m_frame_ms;
+	uint64_t m_draw_calls = 0;
+	uint64_t m_triangles = 0;
+	uint64_t m_submitted = 0;
+	uint64_t m_culled = 0;
+	uint64_t m_occluded = 0;
+	uint64_t m_ring_stalls = 0;
+	uint64_t m_program_switches = 0;
+	uint64_t m_texture_binds = 0;
+	uint64_t m_vao_switches = 0;
+	uint64_t m_binds_avoided = 0;
+	uint64_t m_allocations = 0;
+	uint64_t m_steady_allocations = 0;
+	uint32_t m_steady_frames = 0;
+	uint32_t m_allocating_frames = 0; // Steady state frames that allocated
+public:
+	explicit BenchmarkReport(uint32_t frames);
+
+	void begin_frame() noexcept;
+	// steady_state once warm-up is over, the first allocating frame after that is logged
+	void end_frame(const FrameStats& stats, bool steady_state);
+
+	auto steady_state_allocations() const noexcept -> uint64_t { return m_steady_allocations; }
+	auto steady_frames() const noexcept -> uint32_t { return m_steady_frames; }
+
+	auto to_json(const Info& info) const -> std::string;
+	// Logs and returns false when the file can't be written
+	auto write(const std::string& path, const Info& info) const -> bool;
+};
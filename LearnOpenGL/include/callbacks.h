@@ -4,13 +4,10 @@
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 
+// The callbacks run on the thread polling events, which doesn't own the GL context.
+// The GL calls they stand for are recorded and made by apply_window_events()
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
-void debug_msg_callback(
-	GLenum source,
-	GLenum type,
-	GLuint id,
-	GLenum severity,
-	GLsizei length,
-	const GLchar *message,
-	const void *userParam);
+
+// Context thread, once per frame before drawing
+void apply_window_events();
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include "transform.h"
+
+struct Aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// Planes point inwards, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Gribb-Hartmann extraction, works on the proj * view matrix the renderer already has
+auto extract_frustum(const glm::mat4& view_proj) -> Frustum;
+auto intersects(const Frustum& frustum, const Aabb& box) noexcept -> bool;
+
+// World space bounds of local_bounds under every transform
+void compute_world_bounds(const TransformSoA& transforms, const Aabb& local_bounds, std::vector<Aabb>& out);
+void compute_world_bounds(JobSystem& jobs, const TransformSoA& transforms, const Aabb& local_bounds, std::vector<Aabb>& out);
+
+// Bounding volume hierarchy over object bounds, stored depth first so a
+// node's left child directly follows it and children always come after parents
+class Bvh
+{
+private:
+	struct Node
+	{
+		Aabb bounds;
+		uint32_t first; // Leaf: first entry in m_indices, interior: right child
+		uint32_t count; // Leaf: object count, interior: 0
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_indices;
+	std::vector<glm::vec3> m_centroids;
+	std::vector<uint32_t> m_subtrees;                   // Roots culled and refitted by one job each, left to right
+	std::vector<uint32_t> m_top_nodes;                  // The nodes above them, parents first
+	std::vector<uint32_t> m_next_subtrees;              // split_subtrees() scratch, kept for its capacity
+	mutable std::vector<std::vector<uint32_t>> m_partial; // Their visible lists, sized by split_subtrees()
+
+	auto build_node(uint32_t begin, uint32_t end) -> uint32_t;
+	void split_subtrees();
+	void refit_nodes(const std::vector<Aabb>& bounds, uint32_t first, uint32_t end);
+	void cull_subtree(const Frustum& frustum, const std::vector<Aabb>& bounds, uint32_t root, std::vector<uint32_t>& visible) const;
+public:
+	static constexpr uint32_t max_leaf_size = 4;
+
+	// Full rebuild, O(n log n)
+	void build(const std::vector<Aabb>& bounds);
+	// Recomputes node bounds bottom up keeping the topology, O(n). Only valid
+	// while the object count is unchanged, quality degrades if objects move far
+	void refit(const std::vector<Aabb>& bounds);
+	void refit(JobSystem& jobs, const std::vector<Aabb>& bounds);
+
+	// Appends the index of every object whose bounds touch the frustum, bounds
+	// must be the array the hierarchy was last built or refitted with
+	void cull(const Frustum& frustum, const std::vector<Aabb>& bounds, std::vector<uint32_t>& visible) const;
+	// Subtrees culled in parallel and appended in order, visible ends up the same. Not
+	// reentrant, the per subtree lists belong to the hierarchy
+	void cull(JobSystem& jobs, const Frustum& frustum, const std::vector<Aabb>& bounds, std::vector<uint32_t>& visible) const;
+
+	auto object_count() const noexcept -> size_t { return m_indices.size(); }
+	auto node_count() const noexcept -> size_t { return m_nodes.size(); }
+};
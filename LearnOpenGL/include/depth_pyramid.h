@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gl_objects.h"
+#include "shader_program.h"
+
+// Hierarchical depth buffer for occlusion culling. After a frame is drawn, build() copies
+// its depth into a texture and a compute pass (res/shaders/hiz.comp.glsl) reduces it level
+// by level into a mip chain, each texel holding the farthest depth of the ones below it.
+// The next frame's cull pass projects every object with the matrix the pyramid was built
+// with: if its nearest depth is behind the farthest of the (at most 2x2) texels covering
+// it, whatever was drawn in front hides it.
+//
+// Level 0 is half the framebuffer, depth pixel p lands in texel p >> (level + 1).
+//
+//     DepthPyramid pyramid(hiz_src);
+//     culler.cull(ring, frustum, true, &pyramid);
+//     ... draw ...
+//     pyramid.build(framebuffer, proj * view);
+class DepthPyramid
+{
+public:
+	// Where the cull pass finds the pyramid
+	static constexpr uint32_t texture_unit = 15;
+private:
+	ShaderProgram m_program;
+	Uniform m_source_level;
+	Uniform m_source_size;
+
+	// Same format as the framebuffer's depth, blits need them to match
+	Texture m_depth;
+	Framebuffer m_depth_target;
+	GLenum m_depth_format = GL_NONE;
+
+	Texture m_pyramid; // GL_R32F
+	int32_t m_width = 0;  // Of the depth it was built from
+	int32_t m_height = 0;
+	uint32_t m_levels = 0;
+
+	glm::mat4 m_view_proj{ 1.0f };
+	bool m_valid = false;
+
+	void resize(uint32_t framebuffer, int32_t width, int32_t height);
+public:
+	explicit DepthPyramid(const char* hiz_src);
+
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+	// After drawing, reduces the depth of framebuffer's (0 for the window's) viewport,
+	// which was drawn with view_proj
+	void build(uint32_t framebuffer, const glm::mat4& view_proj);
+	// Binds the pyramid to texture_unit
+	void bind() const noexcept;
+
+	// False until the first build, there is nothing to test against yet
+	auto valid() const noexcept -> bool { return m_valid; }
+	auto view_proj() const noexcept -> const glm::mat4& { return m_view_proj; }
+	auto size() const noexcept -> glm::ivec2 { return { m_width, m_height }; }
+	auto levels() const noexcept -> uint32_t { return m_levels; }
+};
@@ -1,4 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include "mapped_file.h"
+
+// Whole file contents, either a read only mapping or, for files too small to be worth
+// mapping, the bytes read in one go. Don't keep a view of a file something else may
+// rewrite in place, the pages of a truncated mapping fault on access
+class FileView
+{
+private:
+	MappedFile m_mapping;
+	std::string m_buffer;
+public:
+	FileView() = default;
+	explicit FileView(MappedFile&& mapping) noexcept : m_mapping(std::move(mapping)) {}
+	explicit FileView(std::string&& buffer) noexcept : m_buffer(std::move(buffer)) {}
+
+	auto data() const noexcept -> const char* { return m_mapping.is_open() ? reinterpret_cast<const char*>(m_mapping.data()) : m_buffer.data(); }
+	auto size() const noexcept -> size_t { return m_mapping.is_open() ? m_mapping.size() : m_buffer.size(); }
+	auto view() const noexcept -> std::string_view { return { data(), size() }; }
+	auto mapped() const noexcept -> bool { return m_mapping.is_open(); }
+};
+
+// Files at least this large are mapped by map_file, smaller ones are read
+constexpr size_t map_threshold = 64 * 1024;
 
-std::string read_file(const char* file_path);
-void write_file(const char* file_name, const char* content);
+// Nothing here logs or exits, failures come back through ec (and an empty result)
+auto map_file(const std::filesystem::path& path, std::error_code& ec) -> FileView;
+// One read into a string sized from the file
+auto read_file(const std::filesystem::path& path, std::error_code& ec) -> std::string;
+// Leaves the file alone when it already holds content, otherwise writes a temporary next
+// to it and renames it over, so readers never see half a file
+auto write_file(const std::filesystem::path& path, std::string_view content, std::error_code& ec) -> bool;
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <vector>
+
+// Reports files in one directory (not recursive) that were written, created or moved in.
+// Uses inotify on Linux and falls back to comparing modification times elsewhere.
+class FileWatcher
+{
+private:
+	std::filesystem::path m_directory;
+#if defined(__linux__)
+	int m_fd = -1;
+#else
+	std::map<std::filesystem::path, std::filesystem::file_time_type> m_times;
+	std::chrono::steady_clock::time_point m_next_scan;
+
+	void scan(std::vector<std::filesystem::path>* changed);
+#endif
+public:
+	explicit FileWatcher(const std::filesystem::path& directory);
+	~FileWatcher() noexcept;
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Paths changed since the last call, each at most once, never blocks
+	auto poll() -> std::vector<std::filesystem::path>;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Free list of equally sized blocks, carved out of chunks that are kept until the pool
+// goes away. Taking and returning a block is a pointer swap, so objects of one size that
+// come and go every frame stop reaching the heap once the pool is big enough.
+//
+// Not thread safe. thread_pool<T>() hands every thread its own pool for blocks of T, and
+// a block goes back to the pool it came from. As a std::pmr::memory_resource, requests
+// bigger than a block are passed on to the default heap.
+//
+//     auto& pool = thread_pool<DrawPage>();
+//     auto* page = static_cast<DrawPage*>(pool.allocate_block());
+//     ...
+//     pool.free_block(page);
+template<size_t BlockSize, size_t Alignment>
+class FixedPool final : public std::pmr::memory_resource
+{
+private:
+	union Node
+	{
+		Node* next;
+		alignas(Alignment) std::byte storage[BlockSize];
+	};
+
+	std::vector<std::unique_ptr<Node[]>> m_chunks;
+	Node* m_free = nullptr;
+	size_t m_next_chunk;
+	size_t m_in_use = 0;
+
+	auto do_allocate(size_t bytes, size_t alignment) -> void* override
+	{
+		if (bytes > BlockSize || alignment > Alignment)
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		return allocate_block();
+	}
+
+	void do_deallocate(void* block, size_t bytes, size_t alignment) override
+	{
+		if (bytes > BlockSize || alignment > Alignment)
+			std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+		else
+			free_block(block);
+	}
+
+	auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override { return this == &other; }
+public:
+	static constexpr size_t block_size = BlockSize;
+
+	// Chunks start at first_chunk blocks and double up to 1024
+	explicit FixedPool(size_t first_chunk = 16) : m_next_chunk(std::max<size_t>(first_chunk, 1)) {}
+
+	FixedPool(const FixedPool&) = delete;
+	FixedPool& operator=(const FixedPool&) = delete;
+
+	auto allocate_block() -> void*
+	{
+		if (!m_free)
+		{
+			auto& chunk = m_chunks.emplace_back(new Node[m_next_chunk]);
+			for (size_t i = m_next_chunk; i-- > 0;)
+			{
+				chunk[i].next = m_free;
+				m_free = &chunk[i];
+			}
+			m_next_chunk = std::min<size_t>(m_next_chunk * 2, 1024);
+		}
+
+		Node* node = m_free;
+		m_free = node->next;
+		m_in_use++;
+		return node->storage;
+	}
+
+	void free_block(void* block) noexcept
+	{
+		auto* node = reinterpret_cast<Node*>(block);
+		node->next = m_free;
+		m_free = node;
+		m_in_use--;
+	}
+
+	auto in_use() const noexcept -> size_t { return m_in_use; }
+};
+
+// The calling thread's pool for blocks the size of T. Pools live until exit, so a block
+// can still be returned (by whoever holds it, once its thread is done) after the thread ended
+template<typename T>
+auto thread_pool() -> FixedPool<sizeof(T), alignof(T)>&
+{
+	using Pool = FixedPool<sizeof(T), alignof(T)>;
+	static std::mutex mutex;
+	static std::vector<std::unique_ptr<Pool>> pools;
+
+	thread_local Pool* pool = [] {
+		std::lock_guard lock(mutex);
+		return pools.emplace_back(std::make_unique<Pool>()).get();
+	}();
+	return *pool;
+}
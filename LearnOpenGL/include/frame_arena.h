@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of the frame. Allocating is a
+// pointer increment, freeing does nothing, and reset() after the swap drops everything
+// at once. A frame that doesn't fit spills onto the heap and the block grows to what
+// the frame needed, so after the first few frames nothing is allocated anymore.
+//
+// It's a std::pmr::memory_resource, so pmr containers can live in it. They must be
+// gone (or never touched again) by the reset. Owned by one thread, the render thread.
+//
+//     std::pmr::vector<const Stats*> active(&arena);
+//     auto* keys = arena.allocate_array<uint64_t>(count);
+//     ...
+//     glfwSwapBuffers(window);
+//     arena.reset();
+class FrameArena final : public std::pmr::memory_resource
+{
+private:
+	std::unique_ptr<std::byte[]> m_block;
+	size_t m_capacity;
+	size_t m_used = 0;
+
+	// Allocations that didn't fit in the block this frame, freed by reset()
+	std::vector<std::unique_ptr<std::byte[]>> m_spills;
+	size_t m_spilled_bytes = 0;
+	size_t m_peak = 0;
+
+	auto do_allocate(size_t bytes, size_t alignment) -> void* override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override { return this == &other; }
+public:
+	explicit FrameArena(size_t capacity);
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// Uninitialized storage for count objects, which are never destroyed
+	template<typename T>
+	auto allocate_array(size_t count) -> T*
+	{
+		static_assert(std::is_trivially_destructible_v<T>);
+		return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	// Frees everything allocated since the last reset, growing the block if it spilled
+	void reset();
+
+	auto used() const noexcept -> size_t { return m_used + m_spilled_bytes; }
+	auto capacity() const noexcept -> size_t { return m_capacity; }
+	// Most used by any frame so far
+	auto peak() const noexcept -> size_t { return m_peak; }
+};
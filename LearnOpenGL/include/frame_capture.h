@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <glad/glad.h>
+#include "gl_objects.h"
+#include "job_system.h"
+#include "png_encoder.h"
+
+// Writes rendered frames to disk without a blocking glReadPixels. capture() has the gpu copy
+// the framebuffer into the next buffer of a ring of persistently mapped pixel buffers and
+// fences it. update() hands every buffer whose fence has passed to the job system, where a
+// worker flips the rows and encodes them straight from the mapping, as a PNG or as raw
+// RGBA. The GL thread neither waits for the copy nor touches a pixel.
+//
+// A buffer is busy from its capture until its file is written. When the whole ring is,
+// the frame is dropped, or with wait_when_busy waited for (headless runs, where every
+// frame matters more than the frame rate).
+//
+//     FrameCapture capture(jobs, { "captures" });
+//     capture.update();  // Start of every frame
+//     ... draw ...
+//     capture.capture(); // Before the swap
+class FrameCapture
+{
+public:
+	enum class Format
+	{
+		Png,
+		Raw, // Top down RGBA8 without a header, what ffmpeg -f rawvideo -pix_fmt rgba reads
+	};
+
+	struct Settings
+	{
+		std::string directory = "captures";
+		Format format = Format::Png;
+		uint32_t every = 1;          // Capture every nth frame
+		uint32_t ring_size = 4;      // Captures in flight, read back or being encoded
+		bool wait_when_busy = false;
+	};
+
+	struct Stats
+	{
+		uint32_t captured = 0; // Copies issued
+		uint32_t dropped = 0;  // Frames skipped because every buffer was busy
+		uint32_t written = 0;
+		uint32_t failed = 0;
+		uint64_t bytes = 0;    // Written to disk
+		double encode_ms = 0;  // Conversion, encoding and writing, summed over the workers
+	};
+private:
+	enum class SlotState : uint32_t
+	{
+		Free,
+		Reading,  // Copy issued, fence pending
+		Encoding, // Queued on or running on a worker
+	};
+
+	struct Slot
+	{
+		FrameCapture* owner = nullptr;
+		Buffer buffer;
+		const uint8_t* pixels = nullptr; // Bottom up, as GL reads them
+		size_t capacity = 0;
+		GLsync fence = nullptr;
+		int32_t width = 0;
+		int32_t height = 0;
+		uint32_t frame = 0;
+		std::atomic<SlotState> state{ SlotState::Free };
+		JobCounter encoded;
+
+		// Worker side, kept so the same frame size never allocates again
+		PngEncoder encoder;
+		std::unique_ptr<uint8_t[]> row;
+		size_t row_capacity = 0;
+	};
+
+	JobSystem& m_jobs;
+	Settings m_settings;
+	std::unique_ptr<Slot[]> m_slots;
+	uint32_t m_next = 0;  // Slot the next capture goes into
+	uint32_t m_frame = 0; // Frames seen by capture(), captured or not
+	uint32_t m_captured = 0;
+	uint32_t m_dropped = 0;
+
+	std::atomic<uint32_t> m_written{ 0 };
+	std::atomic<uint32_t> m_failed{ 0 };
+	std::atomic<uint64_t> m_bytes{ 0 };
+	std::atomic<uint64_t> m_encode_ns{ 0 };
+
+	void resize(Slot& slot, int32_t width, int32_t height);
+	void encode(Slot& slot);
+	void dispatch(Slot& slot);
+	void wait(Slot& slot);
+public:
+	// The directory has to exist already
+	FrameCapture(JobSystem& jobs, const Settings& settings);
+	// Finishes every capture in flight, needs the context current
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// GL thread, queues the encoding of every capture the gpu is done with
+	void update();
+	// GL thread, reads back the viewport of the bound framebuffer if this frame is captured
+	void capture();
+
+	auto stats() const noexcept -> Stats;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Counters for a single frame, filled in by the render loop
+struct FrameStats
+{
+	uint32_t draw_calls = 0;
+	uint32_t instances = 0; // Objects submitted to the gpu
+	uint32_t culled = 0;    // Objects outside the frustum
+	uint32_t occluded = 0;  // Objects inside it that the depth pyramid hid, not counted in culled
+	uint64_t triangles = 0; // Submitted to the gpu, before any gpu side culling
+	uint32_t ring_stalls = 0; // Waits for the gpu before reusing stream buffer memory
+	uint32_t program_switches = 0;
+	uint32_t texture_binds = 0;
+	uint32_t vao_switches = 0;
+	uint32_t binds_avoided = 0; // Dropped by gl_state because the object was already bound
+	uint32_t allocations = 0;   // Heap allocations on any thread since the previous frame ended
+};
+
+// Accumulates per frame CPU time and counters, logging a summary every interval
+class FrameStatsReporter
+{
+private:
+	using clock = std::chrono::steady_clock;
+
+	const char* m_label;
+	double m_interval;
+	clock::time_point m_frame_start;
+	clock::time_point m_report_start;
+
+	uint32_t m_frames = 0;
+	double m_cpu_total_ms = 0.0;
+	double m_cpu_max_ms = 0.0;
+	uint32_t m_ring_stalls = 0;
+	uint64_t m_allocations = 0;
+	FrameStats m_last = {};
+public:
+	FrameStatsReporter(const char* label, double interval_seconds);
+
+	void begin_frame() noexcept;
+	// Call before glfwSwapBuffers so the vsync wait is not counted as CPU time
+	void end_frame(const FrameStats& stats);
+};
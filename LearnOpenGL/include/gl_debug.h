@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "lockfree_queue.h"
+
+// Names for the GL_DEBUG_* enums, table lookups without allocating. The enums come
+// in contiguous runs, anything outside them is "UNKNOWN"
+constexpr auto debug_source_name(GLenum source) -> std::string_view
+{
+	constexpr std::array<std::string_view, 6> names{
+		"API", "WINDOW SYSTEM", "SHADER COMPILER", "THIRD PARTY", "APPLICATION", "OTHER"
+	};
+	const GLenum index = source - GL_DEBUG_SOURCE_API;
+	return index < names.size() ? names[index] : "UNKNOWN";
+}
+
+constexpr auto debug_type_name(GLenum type) -> std::string_view
+{
+	constexpr std::array<std::string_view, 6> names{
+		"ERROR", "DEPRECATED BEHAVIOR", "UNDEFINED BEHAVIOR", "PORTABILITY", "PERFORMANCE", "OTHER"
+	};
+	constexpr std::array<std::string_view, 3> group_names{ "MARKER", "PUSH GROUP", "POP GROUP" };
+	const GLenum index = type - GL_DEBUG_TYPE_ERROR;
+	const GLenum group_index = type - GL_DEBUG_TYPE_MARKER;
+	return index < names.size() ? names[index]
+		: group_index < group_names.size() ? group_names[group_index]
+		: "UNKNOWN";
+}
+
+constexpr auto debug_severity_name(GLenum severity) -> std::string_view
+{
+	constexpr std::array<std::string_view, 3> names{ "HIGH", "MEDIUM", "LOW" };
+	const GLenum index = severity - GL_DEBUG_SEVERITY_HIGH;
+	return index < names.size() ? names[index]
+		: severity == GL_DEBUG_SEVERITY_NOTIFICATION ? "NOTIFICATION"
+		: "UNKNOWN";
+}
+
+static_assert(debug_source_name(GL_DEBUG_SOURCE_OTHER) == "OTHER");
+static_assert(debug_type_name(GL_DEBUG_TYPE_POP_GROUP) == "POP GROUP");
+static_assert(debug_severity_name(GL_DEBUG_SEVERITY_LOW) == "LOW");
+
+// KHR_debug output that stays cheap when a driver floods it. The callback copies the
+// message into a lock-free queue and returns, update() (once per frame) hands them to
+// an async spdlog logger that does the formatting and writing on its own thread.
+// Each (source, type, id) is only logged repeats_per_interval times per summary
+// interval, the rest are counted and reported in a periodic summary.
+class GlDebugOutput
+{
+public:
+	struct Settings
+	{
+		size_t queue_capacity = 1024;      // Power of two
+		uint32_t repeats_per_interval = 3; // Full messages logged per (source, type, id) between summaries
+		double summary_interval = 5.0;     // Seconds
+		bool synchronous = true;           // GL_DEBUG_OUTPUT_SYNCHRONOUS, callbacks on the calling thread
+	};
+private:
+	struct Message
+	{
+		GLenum source;
+		GLenum type;
+		GLenum severity;
+		GLuint id;
+		uint32_t length;
+		char text[492];
+	};
+
+	// Open addressed, slots are claimed with a CAS on key and never freed
+	struct Counter
+	{
+		std::atomic<uint64_t> key{ 0 };
+		std::atomic<uint32_t> interval_count{ 0 };
+		std::atomic<uint64_t> total{ 0 };
+		std::atomic<GLenum> severity{ 0 };
+	};
+	static constexpr size_t counter_slots = 512;
+
+	Settings m_settings;
+	bool m_enabled = false;
+	MpmcQueue<Message> m_queue;
+	std::unique_ptr<std::array<Counter, counter_slots>> m_counters;
+	std::atomic<uint64_t> m_dropped{ 0 };    // Queue full
+	std::atomic<uint64_t> m_untracked{ 0 };  // Counter table full, logged without rate limiting
+	std::shared_ptr<spdlog::logger> m_logger;
+	double m_last_summary = 0.0;
+
+	static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+		GLsizei length, const GLchar* message, const void* user);
+	auto counter(uint64_t key) noexcept -> Counter*;
+	void push(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message) noexcept;
+	void log_summary();
+public:
+	// Installs the callback if the current context was created with the debug flag,
+	// enabled() is false otherwise
+	explicit GlDebugOutput(const Settings& settings);
+	// Detaches the callback, destroy it before the context
+	~GlDebugOutput() noexcept;
+
+	GlDebugOutput(const GlDebugOutput&) = delete;
+	GlDebugOutput& operator=(const GlDebugOutput&) = delete;
+
+	// Call once per frame on the GL thread
+	void update();
+
+	auto enabled() const noexcept -> bool { return m_enabled; }
+
+	// Synchronous output points debugger breakpoints and stacks at the offending call,
+	// drop it once that capture is done so the driver can report from its own threads
+	static void set_synchronous(bool synchronous);
+	static auto synchronous() -> bool;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string_view>
+#include <glad/glad.h>
+
+// Extensions the vendored glad (plain GL 4.6 core) was generated without.
+// Their entry points are loaded by hand, everything stays null / false when
+// the driver doesn't advertise the extension.
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct GlExtensions
+{
+	// GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile
+	bool parallel_shader_compile = false;
+	void (APIENTRY* max_shader_compiler_threads)(GLuint count) = nullptr;
+
+	// GL_ARB_indirect_parameters, the draw count of a multi draw read from GL_PARAMETER_BUFFER
+	bool indirect_parameters = false;
+	void (APIENTRY* multi_draw_elements_indirect_count)(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride) = nullptr;
+
+	// GL_ARB_bindless_texture, 64 bit handles shaders sample from without binding anything
+	bool bindless_texture = false;
+	GLuint64 (APIENTRY* get_texture_sampler_handle)(GLuint texture, GLuint sampler) = nullptr;
+	void (APIENTRY* make_texture_handle_resident)(GLuint64 handle) = nullptr;
+	void (APIENTRY* make_texture_handle_non_resident)(GLuint64 handle) = nullptr;
+};
+
+extern GlExtensions gl_extensions;
+
+// Call once after gladLoadGLLoader with the same loader
+void load_gl_extensions(GLADloadproc load);
+auto has_gl_extension(std::string_view name) -> bool;
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <glad/glad.h>
+
+// Move only owners for GL objects, created and edited through direct state access so
+// nothing is bound just to be modified. Binding for drawing goes through gl_state.
+//
+//     auto vbo = Buffer::create(sizeof(vertices), vertices);
+//     auto vao = VertexArray::create();
+//     vao.vertex_buffer(0, vbo, 0, sizeof(Vertex));
+//     vao.attrib_format(0, 0, 3, GL_FLOAT, false, offsetof(Vertex, position));
+//
+// A default constructed or moved from object holds name 0 and deletes nothing.
+template<typename Traits>
+class GlObject
+{
+protected:
+	uint32_t m_id = 0;
+
+	explicit GlObject(uint32_t id) noexcept : m_id(id) {}
+public:
+	GlObject() noexcept = default;
+	~GlObject() noexcept { reset(); }
+
+	GlObject(GlObject&& other) noexcept : m_id(std::exchange(other.m_id, 0)) {}
+	GlObject& operator=(GlObject&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_id = std::exchange(other.m_id, 0);
+		}
+		return *this;
+	}
+
+	GlObject(const GlObject&) = delete;
+	GlObject& operator=(const GlObject&) = delete;
+
+	void reset() noexcept
+	{
+		if (m_id != 0)
+			Traits::destroy(m_id);
+		m_id = 0;
+	}
+
+	auto id() const noexcept -> uint32_t { return m_id; }
+	explicit operator bool() const noexcept { return m_id != 0; }
+};
+
+struct BufferTraits { static void destroy(uint32_t id) noexcept; };
+struct VertexArrayTraits { static void destroy(uint32_t id) noexcept; };
+struct TextureTraits { static void destroy(uint32_t id) noexcept; };
+struct SamplerTraits { static void destroy(uint32_t id) noexcept; };
+struct FramebufferTraits { static void destroy(uint32_t id) noexcept; };
+struct RenderbufferTraits { static void destroy(uint32_t id) noexcept; };
+
+// Immutable storage (glNamedBufferStorage), flags decide whether it can be mapped
+class Buffer : public GlObject<BufferTraits>
+{
+	using GlObject::GlObject;
+public:
+	Buffer() noexcept = default;
+	static auto create(size_t size, const void* data = nullptr, GLbitfield flags = 0) -> Buffer;
+
+	auto map_range(size_t offset, size_t size, GLbitfield access) const noexcept -> void*
+	{
+		return glMapNamedBufferRange(m_id, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), access);
+	}
+	void unmap() const noexcept { glUnmapNamedBuffer(m_id); }
+	void sub_data(size_t offset, size_t size, const void* data) const noexcept
+	{
+		glNamedBufferSubData(m_id, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+	}
+};
+
+// Attribute formats and buffer bindings are set up separately (ARB_vertex_attrib_binding)
+class VertexArray : public GlObject<VertexArrayTraits>
+{
+	using GlObject::GlObject;
+public:
+	VertexArray() noexcept = default;
+	static auto create() -> VertexArray;
+
+	void vertex_buffer(uint32_t binding, const Buffer& buffer, size_t offset, size_t stride) const noexcept
+	{
+		glVertexArrayVertexBuffer(m_id, binding, buffer.id(), static_cast<GLintptr>(offset), static_cast<GLsizei>(stride));
+	}
+	void element_buffer(const Buffer& buffer) const noexcept { glVertexArrayElementBuffer(m_id, buffer.id()); }
+
+	// Float attribute, integer types are converted (normalized or not) by the fetch
+	void attrib_format(uint32_t attrib, uint32_t binding, int32_t size, GLenum type, bool normalized, uint32_t relative_offset) const noexcept
+	{
+		glEnableVertexArrayAttrib(m_id, attrib);
+		glVertexArrayAttribFormat(m_id, attrib, size, type, normalized ? GL_TRUE : GL_FALSE, relative_offset);
+		glVertexArrayAttribBinding(m_id, attrib, binding);
+	}
+	// Integer attribute, read by the shader as int / uint without conversion
+	void attrib_i_format(uint32_t attrib, uint32_t binding, int32_t size, GLenum type, uint32_t relative_offset) const noexcept
+	{
+		glEnableVertexArrayAttrib(m_id, attrib);
+		glVertexArrayAttribIFormat(m_id, attrib, size, type, relative_offset);
+		glVertexArrayAttribBinding(m_id, attrib, binding);
+	}
+	// Non zero advances the binding once per divisor instances instead of per vertex
+	void binding_divisor(uint32_t binding, uint32_t divisor) const noexcept { glVertexArrayBindingDivisor(m_id, binding, divisor); }
+};
+
+class Texture : public GlObject<TextureTraits>
+{
+	using GlObject::GlObject;
+public:
+	Texture() noexcept = default;
+	static auto create(GLenum target) -> Texture;
+
+	void storage_2d(int32_t levels, GLenum internal_format, int32_t width, int32_t height) const noexcept
+	{
+		glTextureStorage2D(m_id, levels, internal_format, width, height);
+	}
+	// Arrays and 3D textures, depth is the layer count of an array
+	void storage_3d(int32_t levels, GLenum internal_format, int32_t width, int32_t height, int32_t depth) const noexcept
+	{
+		glTextureStorage3D(m_id, levels, internal_format, width, height, depth);
+	}
+	// pixels is an offset into the bound GL_PIXEL_UNPACK_BUFFER if there is one
+	void sub_image_2d(int32_t level, int32_t width, int32_t height, GLenum format, GLenum type, const void* pixels) const noexcept
+	{
+		glTextureSubImage2D(m_id, level, 0, 0, width, height, format, type, pixels);
+	}
+	void generate_mipmap() const noexcept { glGenerateTextureMipmap(m_id); }
+	void parameter(GLenum name, int32_t value) const noexcept { glTextureParameteri(m_id, name, value); }
+};
+
+// Filtering and wrapping apart from the texture, bound per unit
+class Sampler : public GlObject<SamplerTraits>
+{
+	using GlObject::GlObject;
+public:
+	Sampler() noexcept = default;
+	static auto create() -> Sampler;
+
+	void parameter(GLenum name, int32_t value) const noexcept { glSamplerParameteri(m_id, name, value); }
+	void parameter(GLenum name, float_t value) const noexcept { glSamplerParameterf(m_id, name, value); }
+};
+
+class Renderbuffer : public GlObject<RenderbufferTraits>
+{
+	using GlObject::GlObject;
+public:
+	Renderbuffer() noexcept = default;
+	static auto create(GLenum internal_format, int32_t width, int32_t height) -> Renderbuffer;
+};
+
+class Framebuffer : public GlObject<FramebufferTraits>
+{
+	using GlObject::GlObject;
+public:
+	Framebuffer() noexcept = default;
+	static auto create() -> Framebuffer;
+
+	void attach(GLenum attachment, const Renderbuffer& renderbuffer) const noexcept
+	{
+		glNamedFramebufferRenderbuffer(m_id, attachment, GL_RENDERBUFFER, renderbuffer.id());
+	}
+	void attach(GLenum attachment, const Texture& texture, int32_t level = 0) const noexcept
+	{
+		glNamedFramebufferTexture(m_id, attachment, texture.id(), level);
+	}
+	auto status(GLenum target = GL_FRAMEBUFFER) const noexcept -> GLenum { return glCheckNamedFramebufferStatus(m_id, target); }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Shadow of the binding state of the current context. Every bind goes through here
+// and is dropped when the object is already bound, the counters show how many were.
+// Code that binds behind its back has to call invalidate() afterwards.
+class GlStateCache
+{
+public:
+	static constexpr uint32_t max_texture_units = 32;
+
+	struct Stats
+	{
+		uint64_t binds = 0;   // Issued to the driver
+		uint64_t avoided = 0; // Already bound, skipped
+	};
+private:
+	// Nothing known yet, the first bind of each slot is always issued
+	static constexpr uint32_t unknown = ~0u;
+
+	// Targets bound with bind_buffer, the indexed ones go through StreamBuffer::bind
+	static constexpr std::array<GLenum, 7> buffer_targets{
+		GL_ARRAY_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_PACK_BUFFER,
+		GL_COPY_READ_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER,
+		GL_PARAMETER_BUFFER,
+	};
+
+	uint32_t m_program = unknown;
+	uint32_t m_vertex_array = unknown;
+	uint32_t m_draw_framebuffer = unknown;
+	uint32_t m_read_framebuffer = unknown;
+	std::array<uint32_t, max_texture_units> m_textures;
+	std::array<uint32_t, max_texture_units> m_samplers;
+	std::array<uint32_t, buffer_targets.size()> m_buffers;
+	Stats m_stats;
+
+	auto update(uint32_t& bound, uint32_t id) noexcept -> bool;
+public:
+	GlStateCache() noexcept;
+
+	// Each returns true if the bind reached the driver
+	auto use_program(uint32_t program) noexcept -> bool;
+	auto bind_vertex_array(uint32_t vertex_array) noexcept -> bool;
+	auto bind_texture_unit(uint32_t unit, uint32_t texture) noexcept -> bool;
+	auto bind_sampler(uint32_t unit, uint32_t sampler) noexcept -> bool;
+	// GL_FRAMEBUFFER sets both the draw and read bindings
+	auto bind_framebuffer(GLenum target, uint32_t framebuffer) noexcept -> bool;
+	auto bind_buffer(GLenum target, uint32_t buffer) noexcept -> bool;
+
+	// Called when an object is deleted, GL unbinds it and its name may be reused
+	void forget_program(uint32_t program) noexcept;
+	void forget_vertex_array(uint32_t vertex_array) noexcept;
+	void forget_texture(uint32_t texture) noexcept;
+	void forget_sampler(uint32_t sampler) noexcept;
+	void forget_framebuffer(uint32_t framebuffer) noexcept;
+	void forget_buffer(uint32_t buffer) noexcept;
+
+	// Forget everything, e.g. after a context switch or a third party library ran
+	void invalidate() noexcept;
+
+	auto stats() const noexcept -> const Stats& { return m_stats; }
+};
+
+// The state of the one context the app renders with
+extern GlStateCache gl_state;
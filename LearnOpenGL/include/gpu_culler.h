@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "depth_pyramid.h"
+#include "gl_objects.h"
+#include "render_queue.h"
+#include "shader_program.h"
+#include "stream_buffer.h"
+#include "transform.h"
+
+// Frustum culling on the gpu for objects that don't move. Model matrices and bounding
+// spheres are uploaded once, every frame a compute pass (res/shaders/cull.comp.glsl)
+// tests each object and appends the survivors to their material's indirect command,
+// which is drawn with glMultiDrawElementsIndirect. With GL_ARB_indirect_parameters the
+// draw count comes from the gpu as well, so a material without survivors costs nothing.
+// The cpu issues the same handful of calls whether there are 10 objects or 1M.
+// Given a DepthPyramid, objects in the frustum are also tested against last frame's depth.
+//
+//     culler.attach(mesh.vao, 2, 1);
+//     culler.cull(ring, extract_frustum(proj * view), true, &pyramid);
+//     draw.indirect = culler.indirect(material);
+//     ... queue.execute(ring) ...
+//     culler.end_frame();
+class GpuCuller
+{
+public:
+	// DrawElementsIndirectCommand
+	struct Command
+	{
+		uint32_t count;
+		uint32_t instance_count;
+		uint32_t first_index;
+		int32_t base_vertex;
+		uint32_t base_instance;
+	};
+
+	// std140 layout of the Cull block in cull.comp.glsl, pushed to the ring every frame
+	struct CullBlock
+	{
+		glm::vec4 planes[6];
+		glm::mat4 occlusion_view_proj;
+		uint32_t object_count;
+		uint32_t material_count;
+		uint32_t cull_enabled;
+		uint32_t occlusion_enabled;
+		glm::ivec2 depth_size;
+		int32_t pyramid_levels;
+		uint32_t padding;
+	};
+	static_assert(sizeof(CullBlock) == 192);
+private:
+	static constexpr uint32_t workgroup_size = 256;
+	static constexpr uint32_t readback_frames = 3;
+
+	ShaderProgram m_program;
+	Buffer m_models;         // mat4 per object, storage block 0 of the draws
+	Buffer m_bounds;         // vec4 sphere per object
+	Buffer m_visible;        // Object ids, per instance attribute of the draws
+	Buffer m_commands;       // Command per material
+	Buffer m_reset_commands; // Copied over m_commands before every pass
+	Buffer m_draw_counts;    // uint per material, 0 or 1
+	Buffer m_occluded;       // uint, objects the depth pyramid hid
+
+	// Commands copied back after drawing, then the occluded count of every frame. Read once
+	// their fence has passed, never waited on
+	Buffer m_readback;
+	const Command* m_readback_data = nullptr;
+	std::array<GLsync, readback_frames> m_fences{};
+	uint32_t m_frame = 0;
+
+	uint32_t m_object_count;
+	uint32_t m_material_count;
+	uint32_t m_visible_count; // As of the newest readback
+	uint32_t m_occluded_count = 0;
+public:
+	// Object i uses material i % material_count, every command draws index_count indices
+	GpuCuller(const char* cull_src, const TransformSoA& transforms, const std::vector<Aabb>& bounds,
+		uint32_t material_count, uint32_t index_count);
+	~GpuCuller() noexcept;
+
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	// Feeds the object id of each instance to attrib (a uint) through binding of vao
+	void attach(const VertexArray& vao, uint32_t attrib, uint32_t binding) const noexcept;
+
+	// Resets the commands and dispatches the pass, binds the matrices to storage block 0
+	// and takes uniform block 2 from the ring. Without culling every object survives, without
+	// a valid occlusion pyramid only the frustum is tested
+	void cull(StreamBuffer& ring, const Frustum& frustum, bool cull_enabled, const DepthPyramid* occlusion = nullptr);
+	// Queues the readback of this frame's commands, after the draws
+	void end_frame();
+
+	auto indirect(uint32_t material) const noexcept -> RenderQueue::Indirect;
+
+	// Survivors a few frames ago, the gpu is never waited on for the exact count
+	auto visible_count() const noexcept -> uint32_t { return m_visible_count; }
+	// In the frustum but hidden, as of the same readback
+	auto occluded_count() const noexcept -> uint32_t { return m_occluded_count; }
+	auto object_count() const noexcept -> uint32_t { return m_object_count; }
+};
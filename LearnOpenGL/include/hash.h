@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 64 bit FNV-1a, constexpr so names can be hashed at compile time
+constexpr uint64_t fnv1a_offset = 0xcbf29ce484222325ull;
+constexpr uint64_t fnv1a_prime = 0x100000001b3ull;
+
+constexpr auto fnv1a(std::string_view str, uint64_t hash = fnv1a_offset) noexcept -> uint64_t
+{
+	for (const char c : str)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= fnv1a_prime;
+	}
+	return hash;
+}
+
+inline auto fnv1a_bytes(const void* data, size_t size, uint64_t hash = fnv1a_offset) noexcept -> uint64_t
+{
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= fnv1a_prime;
+	}
+	return hash;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include "gl_objects.h"
+
+// Offscreen GL context for benchmark runs on machines without a display or GPU.
+// The context comes from EGL (surfaceless on Mesa, so llvmpipe works), rendering goes
+// into an FBO that stands in for the default framebuffer and nothing waits on vsync.
+//
+//     HeadlessContext context(WIDTH, HEIGHT, debug);
+//     gladLoadGLLoader(HeadlessContext::get_proc_address);
+//     context.create_framebuffer();
+class HeadlessContext
+{
+private:
+	void* m_display = nullptr;
+	void* m_context = nullptr;
+	void* m_surface = nullptr; // Only without EGL_KHR_surfaceless_context
+
+	Framebuffer m_framebuffer;
+	Renderbuffer m_color;
+	Renderbuffer m_depth;
+	int32_t m_width;
+	int32_t m_height;
+public:
+	// Creates a GL 4.6 (or 4.5) core context and makes it current, throws gl_error when
+	// there is no usable EGL or the build has none
+	HeadlessContext(int32_t width, int32_t height, bool debug);
+	~HeadlessContext() noexcept;
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	static auto get_proc_address(const char* name) -> void*;
+
+	// Moves the context between threads, release() on the old one first
+	void make_current();
+	void release();
+
+	// Needs the GL functions loaded, binds the framebuffer and sets the viewport
+	void create_framebuffer();
+	// Stands in for glfwSwapBuffers, submits the frame without waiting for it
+	void present();
+
+	auto framebuffer() const noexcept -> uint32_t { return m_framebuffer.id(); }
+	auto width() const noexcept -> int32_t { return m_width; }
+	auto height() const noexcept -> int32_t { return m_height; }
+};
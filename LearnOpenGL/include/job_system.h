@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "work_stealing_deque.h"
+
+// Counts the jobs queued against it that haven't finished, JobSystem::wait blocks on it
+class JobCounter
+{
+private:
+	std::atomic<uint32_t> m_pending{ 0 };
+	friend class JobSystem;
+public:
+	auto done() const noexcept -> bool { return m_pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Worker threads, one per core but the caller's, fed through Chase-Lev deques. Every
+// thread queuing jobs gets its own deque, pushes and pops at its end and is stolen from
+// at the other, so a thread splitting work mostly runs its own jobs while idle workers
+// take the rest. Jobs are a function pointer, its data and a range, taken from a pool
+// per thread, so queuing never allocates.
+//
+// A job depending on others waits on their counter. Waiting runs queued jobs instead of
+// blocking, so nested waits don't deadlock and the waiting thread adds to the throughput.
+// Jobs must not throw.
+//
+//     JobSystem jobs({});
+//     jobs.parallel_for(count, 256, [&](uint32_t begin, uint32_t end) { ... });
+//
+//     JobCounter decoded;
+//     jobs.run(decode, &request, 0, 1, &decoded);
+//     ...
+//     jobs.wait(decoded);
+class JobSystem
+{
+public:
+	using Function = void (*)(void* data, uint32_t begin, uint32_t end);
+
+	struct Settings
+	{
+		uint32_t thread_count = 0; // The waiting thread included, 0 picks the core count (at least one worker)
+	};
+
+	struct Stats
+	{
+		uint64_t executed = 0; // Jobs run, by any thread
+		uint64_t stolen = 0;   // Of those, taken from another thread's deque
+	};
+private:
+	static constexpr size_t max_threads = 64;
+	static constexpr size_t jobs_per_thread = 4096;
+
+	struct Job
+	{
+		Function function = nullptr;
+		void* data = nullptr;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		JobCounter* counter = nullptr;
+		std::atomic<bool> queued{ false }; // Until it ran, the pool slot is not handed out again
+	};
+
+	// Owned by one thread, only its deque is touched by others
+	struct ThreadState
+	{
+		WorkStealingDeque<Job*> deque{ jobs_per_thread };
+		std::unique_ptr<Job[]> pool{ new Job[jobs_per_thread] };
+		uint32_t next_job = 0;
+		uint32_t victim = 0; // Where the next steal attempt starts
+		std::thread::id id;
+		std::atomic<uint64_t> executed{ 0 };
+		std::atomic<uint64_t> stolen{ 0 };
+	};
+
+	const uint64_t m_id; // Tells systems apart in the per thread cache, addresses get reused
+	std::array<std::unique_ptr<ThreadState>, max_threads> m_threads;
+	std::atomic<uint32_t> m_thread_count{ 0 };
+	std::mutex m_register_mutex;
+
+	std::vector<std::thread> m_workers;
+	std::atomic<uint32_t> m_epoch{ 0 }; // Bumped whenever work is queued, idle workers wait on it
+	std::atomic<bool> m_stopping{ false };
+
+	auto this_thread() -> ThreadState&;
+	auto register_thread() -> ThreadState&;
+	void push(ThreadState& thread, Function function, void* data, uint32_t begin, uint32_t end, JobCounter* counter);
+	void wake(bool all) noexcept;
+	auto try_run_one(ThreadState& thread) -> bool;
+	void execute(ThreadState& thread, Job& job);
+	void worker_main();
+public:
+	explicit JobSystem(const Settings& settings);
+	// Runs whatever is still queued, then joins the workers
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Queues function(data, begin, end), counter (if any) drops by one once it returned
+	void run(Function function, void* data, uint32_t begin, uint32_t end, JobCounter* counter);
+	// Runs queued jobs until counter reaches zero
+	void wait(const JobCounter& counter);
+
+	// Calls fn(begin, end) over [0, count) in ranges of at least grain, on every thread,
+	// and returns once all of them are done. fn runs concurrently with itself
+	template<typename Fn>
+	void parallel_for(uint32_t count, uint32_t grain, Fn&& fn);
+
+	auto thread_count() const noexcept -> uint32_t { return static_cast<uint32_t>(m_workers.size()) + 1; }
+	auto stats() const noexcept -> Stats;
+};
+
+template<typename Fn>
+void JobSystem::parallel_for(uint32_t count, uint32_t grain, Fn&& fn)
+{
+	if (count == 0)
+		return;
+
+	// A few ranges per thread, so stealing can even out ranges that take longer than others
+	grain = std::max(grain, 1u);
+	const uint32_t range_count = thread_count() == 1 ? 1 : std::min((count + grain - 1) / grain, thread_count() * 4);
+	if (range_count <= 1)
+	{
+		fn(0u, count);
+		return;
+	}
+
+	using Callable = std::remove_reference_t<Fn>;
+	const Function invoke = [](void* data, uint32_t begin, uint32_t end) { (*static_cast<Callable*>(data))(begin, end); };
+	void* data = const_cast<void*>(static_cast<const void*>(std::addressof(fn)));
+	const auto range_begin = [&](uint32_t range) { return static_cast<uint32_t>(uint64_t(count) * range / range_count); };
+
+	// Queued back to front, the caller pops the first ranges itself while thieves take the last
+	auto& thread = this_thread();
+	JobCounter counter;
+	for (uint32_t range = range_count; range-- > 1;)
+		push(thread, invoke, data, range_begin(range), range_begin(range + 1), &counter);
+	wake(true);
+
+	invoke(data, 0, range_begin(1));
+	wait(counter);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Bounded multi producer / multi consumer queue (Dmitry Vyukov's design).
+// Every cell carries a sequence number so producers and consumers only
+// contend on their own index, push and pop never block and never allocate
+template<typename T>
+class MpmcQueue
+{
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	// Keep the two indices on separate cache lines so producers and consumers don't false share
+	static constexpr size_t cache_line = 64;
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	alignas(cache_line) std::atomic<size_t> m_enqueue_pos{ 0 };
+	alignas(cache_line) std::atomic<size_t> m_dequeue_pos{ 0 };
+public:
+	// capacity must be a power of two
+	explicit MpmcQueue(size_t capacity)
+		: m_cells(new Cell[capacity]), m_mask(capacity - 1)
+	{
+		assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+		for (size_t i = 0; i < capacity; i++)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MpmcQueue(const MpmcQueue&) = delete;
+	MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+	// Returns false when the queue is full, value is left untouched
+	auto try_push(T& value) noexcept -> bool
+	{
+		Cell* cell;
+		size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t seq = cell->sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+			if (diff == 0)
+			{
+				if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data = std::move(value);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	auto try_push(T&& value) noexcept -> bool { return try_push(value); }
+
+	// Returns false when the queue is empty
+	auto try_pop(T& value) noexcept -> bool
+	{
+		Cell* cell;
+		size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t seq = cell->sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_dequeue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		value = std::move(cell->data);
+		cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	auto capacity() const noexcept -> size_t { return m_mask + 1; }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#if defined(WINDOWS)
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+
+	void close() noexcept;
+public:
+	MappedFile() = default;
+	~MappedFile() noexcept { close(); }
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file doesn't exist, is empty or can't be mapped
+	auto open(const char* path) -> bool;
+
+	// Asks the OS to start reading the pages in, so the first access doesn't fault
+	void prefetch() const noexcept;
+
+	auto data() const noexcept -> const uint8_t* { return m_data; }
+	auto size() const noexcept -> size_t { return m_size; }
+	auto is_open() const noexcept -> bool { return m_data != nullptr; }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "gl_objects.h"
+
+struct MeshVertex
+{
+	glm::vec3 position;
+	glm::vec2 uv;
+};
+
+// Indexed triangle list
+struct Mesh
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// Welds an unindexed triangle list of interleaved floats (x, y, z, u, v, ...)
+// into unique vertices plus an index buffer
+auto build_indexed_mesh(const float_t* data, size_t vertex_count, size_t stride_floats) -> Mesh;
+
+// Reorders triangles for the post transform vertex cache (Tipsify, Sander et al.
+// 2007, linear time), then renumbers vertices in first use order so vertex
+// fetch walks the buffer forwards
+void optimize_vertex_cache(Mesh& mesh, uint32_t cache_size = 16);
+
+// Average cache miss ratio, vertex shader invocations per triangle for a FIFO
+// cache of cache_size entries. 3.0 is no reuse at all, 0.5 is the ideal for a regular grid
+auto compute_acmr(const std::vector<uint32_t>& indices, uint32_t cache_size = 16) -> float_t;
+
+// 12 bytes: half float position padded to 8 bytes, unorm16 uv
+struct QuantizedVertex
+{
+	uint16_t position[4];
+	uint16_t uv[2];
+};
+static_assert(sizeof(QuantizedVertex) == 12);
+
+struct QuantizedMesh
+{
+	std::vector<QuantizedVertex> vertices;
+	std::vector<uint8_t> indices; // uint16_t when vertices fit, else uint32_t
+	uint32_t index_count = 0;
+	uint32_t index_type = 0;      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+};
+
+// Throws std::invalid_argument if a uv is outside [0, 1], unorm16 can't represent it
+auto quantize_mesh(const Mesh& mesh) -> QuantizedMesh;
+
+// Vertex array with attribute 0 (position) and 1 (uv) set up for QuantizedVertex
+struct GpuMesh
+{
+	VertexArray vao;
+	Buffer vbo;
+	Buffer ebo;
+	uint32_t index_count = 0;
+	uint32_t index_type = 0;
+};
+
+auto upload_mesh(const QuantizedMesh& mesh) -> GpuMesh;
+
+// Same from raw arrays, e.g. straight out of a mapped .lmesh so nothing is copied on the cpu.
+// uv_half reads the uvs as half floats instead of unorm16
+auto upload_mesh(const QuantizedVertex* vertices, size_t vertex_count, const void* indices, uint32_t index_count,
+	uint32_t index_type, bool uv_half = false) -> GpuMesh;
+
+// Logs bytes before and after, and the ACMR of the original and optimized index order
+void log_mesh_report(const char* name, size_t raw_vertex_count, size_t raw_vertex_size,
+	const Mesh& welded, const Mesh& optimized, const QuantizedMesh& quantized);
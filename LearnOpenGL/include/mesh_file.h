@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Cooked mesh container (.lmesh), written next to an imported model the first time it's
+// loaded and memory mapped on later runs. A header, the submesh table, then the vertices
+// (QuantizedVertex, see mesh.h) and the indices, both 16 byte aligned so they go to
+// glNamedBufferStorage straight from the mapping.
+constexpr char mesh_file_magic[8] = { 'L', 'O', 'G', 'L', 'M', 'S', 'H', '\0' };
+constexpr uint32_t mesh_file_version = 1;
+constexpr const char* mesh_file_extension = ".lmesh";
+constexpr uint64_t mesh_file_vertex_size = 12; // sizeof(QuantizedVertex)
+
+enum class MeshFileUv : uint32_t
+{
+	Unorm16 = 1, // Every uv was inside [0, 1]
+	Half = 2,    // Tiling uvs, stored as half floats
+};
+
+struct MeshFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	MeshFileUv uv_format;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t index_type;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t submesh_count;
+	uint64_t vertex_offset; // From the start of the file
+	uint64_t index_offset;
+	float bounds_min[3];    // Of the stored positions, the importer fits them into -0.5 .. 0.5
+	float bounds_max[3];
+	float source_scale;     // stored = (source - source_center) * source_scale
+	float source_center[3];
+	uint64_t source_size;   // The cache is stale once the source's size or write time changes
+	int64_t source_time;
+};
+
+// A usemtl / o / g group of the source, drawn as its own range of indices
+struct MeshFileSubmesh
+{
+	uint32_t first_index;
+	uint32_t index_count;
+	float bounds_min[3];
+	float bounds_max[3];
+	uint64_t name_hash;     // fnv1a of the group name, 0 for the unnamed first group
+};
+
+static_assert(sizeof(MeshFileHeader) == 104);
+static_assert(sizeof(MeshFileSubmesh) == 40);
+
+// Header of a mapped container, or nullptr if it's truncated, corrupt or from another version
+inline auto parse_mesh_file(const uint8_t* data, size_t size) -> const MeshFileHeader*
+{
+	if (!data || size < sizeof(MeshFileHeader))
+		return nullptr;
+
+	const auto* header = reinterpret_cast<const MeshFileHeader*>(data);
+	if (std::memcmp(header->magic, mesh_file_magic, sizeof(mesh_file_magic)) != 0
+		|| header->version != mesh_file_version
+		|| (header->uv_format != MeshFileUv::Unorm16 && header->uv_format != MeshFileUv::Half)
+		|| header->vertex_count == 0 || header->index_count == 0 || header->index_count % 3 != 0)
+		return nullptr;
+
+	const uint64_t index_size = header->index_type == 0x1403 /* GL_UNSIGNED_SHORT */ ? 2
+		: header->index_type == 0x1405 /* GL_UNSIGNED_INT */ ? 4 : 0;
+	if (index_size == 0 || (index_size == 2 && header->vertex_count > UINT16_MAX + 1))
+		return nullptr;
+
+	const uint64_t table_end = sizeof(MeshFileHeader) + uint64_t(header->submesh_count) * sizeof(MeshFileSubmesh);
+	const uint64_t vertex_bytes = uint64_t(header->vertex_count) * mesh_file_vertex_size;
+	const uint64_t index_bytes = uint64_t(header->index_count) * index_size;
+	if (size < table_end
+		|| header->vertex_offset < table_end || header->vertex_offset % 16 != 0
+		|| header->vertex_offset > size || vertex_bytes > size - header->vertex_offset
+		|| header->index_offset < header->vertex_offset + vertex_bytes || header->index_offset % 16 != 0
+		|| header->index_offset > size || index_bytes > size - header->index_offset)
+		return nullptr;
+
+	const auto* submeshes = reinterpret_cast<const MeshFileSubmesh*>(header + 1);
+	for (uint32_t i = 0; i < header->submesh_count; i++)
+	{
+		if (submeshes[i].first_index > header->index_count || submeshes[i].index_count > header->index_count - submeshes[i].first_index)
+			return nullptr;
+	}
+	return header;
+}
+
+inline auto mesh_file_submeshes(const MeshFileHeader* header) -> const MeshFileSubmesh*
+{
+	return reinterpret_cast<const MeshFileSubmesh*>(header + 1);
+}
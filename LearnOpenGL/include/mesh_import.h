@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "mesh_file.h"
+
+// A Wavefront OBJ parsed, welded, vertex cache optimized and quantized, in the layout of
+// a .lmesh container. Each usemtl / o / g group is a submesh with its own vertex range
+struct ImportedMesh
+{
+	std::vector<QuantizedVertex> vertices;
+	std::vector<uint8_t> indices; // uint16_t when vertices fit, else uint32_t
+	uint32_t index_count = 0;
+	uint32_t index_type = 0;      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	MeshFileUv uv_format = MeshFileUv::Unorm16;
+	std::vector<MeshFileSubmesh> submeshes;
+	Aabb bounds{};
+	float_t source_scale = 1.0f;
+	glm::vec3 source_center{};
+};
+
+// Parses the OBJ text in data in jobs, one chunk per thread for large files, without
+// allocating per line. Only positions, uvs and faces are read, polygons are fanned into
+// triangles and positions are fitted into -0.5 .. 0.5.
+// Throws std::runtime_error on faces that index past the vertices or on a mesh without faces
+auto import_obj(JobSystem& jobs, const uint8_t* data, size_t size) -> ImportedMesh;
+
+// Written to a temporary next to path and renamed over it, so a reader never maps half a file
+auto write_mesh_file(const std::filesystem::path& path, const ImportedMesh& mesh, uint64_t source_size, int64_t source_time) -> bool;
+
+struct Model
+{
+	GpuMesh mesh;
+	Aabb bounds;
+	std::vector<MeshFileSubmesh> submeshes;
+};
+
+// Maps <path>.lmesh and uploads from the mapping when it was cooked from the source as it is
+// now (same size and write time), otherwise imports path and writes the cache for the next
+// run. Logs and returns nullopt on failure
+auto load_model(JobSystem& jobs, const std::filesystem::path& path) -> std::optional<Model>;
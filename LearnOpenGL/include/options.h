@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum class RenderMode
+{
+	Legacy,    // One Object block range + glDrawElements per object
+	Instanced, // Model matrices in an SSBO range, one glDrawElementsInstanced
+	Gpu,       // Compute shader culling into indirect commands, one glMultiDrawElementsIndirect
+};
+
+enum class CullMode
+{
+	Off,
+	Static,  // Bvh built once, the scene never moves
+	Refit,   // Bounds recomputed and the Bvh refitted every frame
+	Rebuild, // Bounds recomputed and the Bvh rebuilt every frame
+};
+
+enum class ShaderCacheMode
+{
+	Off,
+	On,
+	Clear, // Empty the cache first, to measure a cold start
+};
+
+enum class ShaderVariantsMode
+{
+	Used, // Only the variant the run draws with
+	All,  // Every variant the driver can build, in one batch at startup
+};
+
+enum class GlDebugMode
+{
+	Off,
+	Async, // Driver may call back from its own threads, logged a frame later
+	Sync,  // GL_DEBUG_OUTPUT_SYNCHRONOUS, breakpoints land on the offending call (F2 toggles)
+};
+
+enum class CaptureFormat
+{
+	Png,
+	Raw, // Headerless top down RGBA8, one file per frame, for ffmpeg -f rawvideo
+};
+
+struct Options
+{
+	RenderMode mode = RenderMode::Instanced;
+	CullMode cull = CullMode::Static;
+	bool occlusion = true;       // --mode gpu also culls against last frame's depth pyramid
+	uint32_t instance_count = 10;
+	double stats_interval = 2.0; // Seconds between frame stat reports
+	uint32_t stream_test = 0;    // Extra texture loads queued at startup to stress the streaming path
+	ShaderCacheMode shader_cache = ShaderCacheMode::On;
+	ShaderVariantsMode shader_variants = ShaderVariantsMode::Used;
+	std::string trace_path;      // Chrome trace written on exit, empty for none
+	uint32_t headless_frames = 0; // Offscreen run of this many frames with a fixed clock, 0 opens a window
+	std::string report_path = "benchmark.json"; // Written at the end of a headless run
+	GlDebugMode gl_debug = GlDebugMode::Sync;    // Only with a debug context, i.e. debug builds
+	uint32_t material_count = 1; // Texture sets cycled through the objects
+	bool sort_draws = true;      // Order the render queue by state, off submits in scene order
+	bool bindless = true;        // Bindless texture handles where supported, off forces texture arrays
+	std::string model_path;      // OBJ drawn in place of the cube, empty for the cube
+	bool render_thread = true;   // GL on its own thread fed frame snapshots, off runs both in turn
+	uint32_t job_threads = 0;    // Job system threads, the main thread included, 0 for one per core
+	bool alloc_check = false;    // Fail a headless run if a frame allocates after warm-up
+	std::string capture_dir;     // Frames are read back and written here, empty for none
+	CaptureFormat capture_format = CaptureFormat::Png;
+	uint32_t capture_every = 1;  // Capture every nth frame
+};
+
+// Exits with a usage message on malformed arguments
+auto parse_options(int argc, char** argv) -> Options;
+auto render_mode_name(RenderMode mode) -> const char*;
+auto cull_mode_name(CullMode mode) -> const char*;
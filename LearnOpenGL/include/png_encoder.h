@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Small PNG writer for frame captures. Rows get the Up filter and go through a single
+// probe LZ77 pass and a fixed Huffman deflate block: far from the smallest files, but
+// one pass over the pixels, and rendered frames (flat clears, repeated texels) still
+// shrink a lot. Buffers stay with the encoder, so encoding the same size again doesn't
+// allocate. One encoder per thread.
+//
+//     PngEncoder encoder;
+//     // GL readbacks are bottom up, start at the last row and step backwards
+//     auto png = encoder.encode(pixels + (height - 1) * stride, width, height, -stride, true);
+class PngEncoder
+{
+private:
+	std::vector<uint8_t> m_filtered; // Filter byte and pixels of every row, what gets compressed
+	std::vector<uint8_t> m_out;
+	std::vector<int32_t> m_head;     // Last position of every 4 byte hash, -1 for none
+
+	auto deflate(uint8_t* out) -> uint8_t*;
+public:
+	// Sizes the buffers for any encode up to width x height, so the first one doesn't allocate either
+	void reserve(uint32_t width, uint32_t height);
+
+	// RGBA8 rows row_stride bytes apart. Opaque drops the alpha channel and writes RGB,
+	// for framebuffers whose alpha means nothing
+	auto encode(const uint8_t* pixels, uint32_t width, uint32_t height, ptrdiff_t row_stride, bool opaque) -> std::span<const uint8_t>;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frame_arena.h"
+
+// Frame profiler. CPU scopes are timed on any thread and pushed into a lock free ring
+// owned by that thread. GPU scopes are pairs of GL_TIMESTAMP queries from a per frame
+// pool, read back several frames later so the pipeline never waits on them. Each frame
+// the profiler drains both into rolling p50/p95/p99 stats and, when tracing, a Chrome
+// trace / Perfetto JSON file.
+//
+// Cheap enough to leave on: a CPU scope is two clock reads and a ring write, and while
+// no Profiler exists scopes skip even those.
+//
+//     PROFILE_CPU("cull");
+//     PROFILE_GPU(profiler, "draw");
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CPU(name) CpuScope PROFILE_CONCAT(cpu_scope_, __LINE__)(name)
+#define PROFILE_GPU(profiler, name) GpuScope PROFILE_CONCAT(gpu_scope_, __LINE__)(profiler, name)
+
+extern std::atomic<bool> g_profiling;
+
+inline auto profiler_now_ns() noexcept -> uint64_t
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// name must outlive the profiler, string literals in practice
+void record_cpu_event(const char* name, uint64_t begin_ns, uint64_t end_ns) noexcept;
+// Shows up as the thread's name in traces
+void set_profiler_thread_name(const char* name);
+
+class CpuScope
+{
+private:
+	const char* m_name;
+	uint64_t m_begin;
+public:
+	explicit CpuScope(const char* name) noexcept
+		: m_name(name), m_begin(g_profiling.load(std::memory_order_relaxed) ? profiler_now_ns() : 0) {}
+
+	~CpuScope() noexcept
+	{
+		if (m_begin != 0)
+			record_cpu_event(m_name, m_begin, profiler_now_ns());
+	}
+
+	CpuScope(const CpuScope&) = delete;
+	CpuScope& operator=(const CpuScope&) = delete;
+};
+
+class Profiler
+{
+public:
+	struct Settings
+	{
+		uint32_t gpu_latency = 4;         // Frames between issuing timestamp queries and reading them
+		uint32_t max_gpu_scopes = 64;     // Per frame, later scopes in the same frame aren't timed
+		uint32_t stats_window = 256;      // Samples per scope the percentiles are computed over
+		double report_interval = 2.0;     // Seconds between stats reports in the log
+		std::string trace_path;           // Chrome trace output written on destruction, empty to disable
+		size_t max_trace_events = 1 << 20;
+	};
+private:
+	struct GpuQuery
+	{
+		const char* name;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	struct GpuFrame
+	{
+		std::vector<uint32_t> queries; // 2 * max_gpu_scopes query objects
+		std::vector<GpuQuery> scopes;  // Issued this frame, pending readback
+		bool busy = false;             // Still pending from last time round, nothing new is issued
+	};
+
+	struct ScopeStats
+	{
+		std::string name;
+		bool gpu = false;
+		std::vector<float> samples_ms; // Ring of the last stats_window samples
+		uint32_t next = 0;
+		uint32_t count = 0;           // Samples since the last report
+	};
+
+	struct TraceEvent
+	{
+		const char* name;
+		uint32_t tid;
+		uint64_t begin_ns;
+		uint64_t duration_ns;
+	};
+
+	Settings m_settings;
+	std::vector<GpuFrame> m_gpu_frames;
+	uint32_t m_frame = 0;
+	int64_t m_gpu_offset_ns = 0; // GL_TIMESTAMP to profiler_now_ns()
+	uint32_t m_gpu_missed = 0;   // Readbacks skipped because the result wasn't ready
+
+	std::unordered_map<uint64_t, ScopeStats> m_stats;
+	std::vector<TraceEvent> m_trace;
+	bool m_trace_full = false;
+	uint64_t m_last_report_ns = 0;
+
+	void add_sample(const char* name, bool gpu, uint32_t tid, uint64_t begin_ns, uint64_t end_ns);
+	void read_gpu_frame(GpuFrame& frame);
+	void drain_cpu_events();
+	void report(FrameArena& arena);
+	void write_trace() const;
+public:
+	// Needs a current GL context, CPU scopes on every thread are live until destruction
+	explicit Profiler(const Settings& settings);
+	~Profiler();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// GL thread, first thing in the frame: collects what finished and recycles the oldest query
+	// pool. The periodic report sorts in arena, so reporting doesn't allocate either
+	void begin_frame(FrameArena& arena);
+
+	// Used by GpuScope, returns an index for gpu_end or UINT32_MAX if the pool is full
+	auto gpu_begin(const char* name) noexcept -> uint32_t;
+	void gpu_end(uint32_t scope) noexcept;
+};
+
+class GpuScope
+{
+private:
+	Profiler& m_profiler;
+	uint32_t m_scope;
+public:
+	GpuScope(Profiler& profiler, const char* name) noexcept
+		: m_profiler(profiler), m_scope(profiler.gpu_begin(name)) {}
+	~GpuScope() noexcept { m_profiler.gpu_end(m_scope); }
+
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// On disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// Entries are keyed by a hash of every stage's source and the driver's vendor,
+// renderer and version strings, so a driver update simply stops hitting old entries.
+// Those age out through the eviction pass run when the cache is opened.
+//
+// Needs a current GL context, and like the rest of the GL code, the GL thread.
+class ProgramCache
+{
+public:
+	struct Settings
+	{
+		std::filesystem::path directory = "shader_cache";
+		uint64_t max_bytes = 64 * 1024 * 1024;                    // Least recently used entries go first past this
+		std::chrono::hours max_age = std::chrono::hours(24 * 30); // Entries unused for this long are removed
+	};
+
+	struct Stats
+	{
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		uint32_t rejected = 0; // Found on disk but refused by the driver
+	};
+private:
+	Settings m_settings;
+	uint64_t m_driver_hash = 0;
+	bool m_enabled = false;
+	Stats m_stats;
+
+	auto entry_path(uint64_t key) const -> std::filesystem::path;
+	void evict();
+public:
+	// Disabled (every load misses, store does nothing) if the driver has no binary formats
+	explicit ProgramCache(const Settings& settings);
+
+	auto key(const char* vert_src, const char* frag_src) const noexcept -> uint64_t;
+
+	// Loads the cached binary for key into program, false if there is none or the driver rejected it
+	auto load(uint32_t program, uint64_t key) -> bool;
+
+	// Saves a linked program, it must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void store(uint32_t program, uint64_t key);
+
+	auto enabled() const noexcept -> bool { return m_enabled; }
+	auto stats() const noexcept -> const Stats& { return m_stats; }
+};
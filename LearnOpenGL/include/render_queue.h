@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include <glad/glad.h>
+
+#include "fixed_pool.h"
+#include "frame_arena.h"
+#include "stream_buffer.h"
+
+// Collects a frame's draws, orders them by pipeline state and submits them through
+// gl_state, which skips any program, vertex array or texture bind already in place.
+// Each draw becomes a 64 bit key + payload index, the keys are radix sorted:
+//
+//     63     60 59        48 47            36 35    24 23           0
+//     | layer  |  program   |  texture set   |  vao   |    depth     |
+//
+// so draws are grouped by program first, then textures, then vao, and front to back
+// within a group. Programs and vaos are mapped to dense 12 bit ids on first use.
+//
+// Keys and texture sets live in the frame arena. Draws are written into fixed size pages
+// from the submitting thread's pool, returned at the next begin_frame(), so a queue fed by
+// one thread stops allocating once the arena and the pool have grown to the scene.
+//
+//     queue.begin_frame(arena);
+//     const auto set = queue.add_texture_set({ texture0, texture1 });
+//     queue.submit({ .program = program.id, .texture_set = set, ... });
+//     queue.sort();
+//     stats = queue.execute(ring);
+class RenderQueue
+{
+public:
+	static constexpr uint32_t max_textures = 4; // Bound to units 0 .. max_textures - 1
+
+	// Commands read from a GL_DRAW_INDIRECT_BUFFER, e.g. written by GpuCuller
+	struct Indirect
+	{
+		uint32_t buffer = 0;           // 0 for a direct draw
+		size_t offset = 0;             // Byte offset of the first DrawElementsIndirectCommand
+		uint32_t draw_count = 1;       // Or the upper bound with a parameter buffer
+		uint32_t parameter_buffer = 0; // Draw count as a uint, only used with GL_ARB_indirect_parameters
+		size_t parameter_offset = 0;
+	};
+
+	struct Draw
+	{
+		uint8_t layer = 0;          // Highest priority, e.g. opaque before transparent
+		uint32_t program = 0;
+		uint32_t vao = 0;
+		uint32_t texture_set = 0;   // From add_texture_set()
+		float_t depth = 0.0f;       // 0 near .. 1 far
+		uint32_t index_count = 0;
+		GLenum index_type = GL_UNSIGNED_INT;
+		uint32_t instance_count = 1;
+		StreamBuffer::Allocation object;    // Bound to uniform block 1 if size != 0
+		StreamBuffer::Allocation instances; // Bound to storage block 0 if size != 0
+		Indirect indirect;          // Replaces index_count and instance_count when it has a buffer
+	};
+
+	// State changes issued by execute(), the point of sorting is to keep these low
+	struct Stats
+	{
+		uint32_t draws = 0;         // A multi draw counts once
+		uint32_t program_switches = 0;
+		uint32_t vao_switches = 0;
+		uint32_t texture_binds = 0; // One per texture unit that changed
+	};
+private:
+	using TextureSet = std::array<uint32_t, max_textures>;
+
+	static constexpr uint32_t draws_per_page = 256;
+	using DrawPage = std::array<Draw, draws_per_page>;
+	using PagePool = FixedPool<sizeof(DrawPage), alignof(DrawPage)>;
+
+	// Everything the frame submitted, in the arena it was begun with
+	struct Frame
+	{
+		explicit Frame(std::pmr::memory_resource* arena)
+			: keys(arena), order(arena), scratch_keys(arena), scratch_order(arena), texture_sets(arena) {}
+
+		// Commands are (key, draw index) pairs, kept apart so the sort moves 12 bytes per draw
+		std::pmr::vector<uint64_t> keys;
+		std::pmr::vector<uint32_t> order;
+		std::pmr::vector<uint64_t> scratch_keys;
+		std::pmr::vector<uint32_t> scratch_order;
+		std::pmr::vector<TextureSet> texture_sets;
+		uint32_t draw_count = 0;
+	};
+
+	std::optional<Frame> m_frame;     // Gone with the arena after the swap, only reset here
+	std::vector<Draw*> m_pages;       // Outside the arena, they are returned after its reset
+	PagePool* m_page_pool = nullptr;  // Pool of the thread that took the pages
+	size_t m_last_draw_count = 0;     // Reserved up front next frame, so the arrays don't regrow
+	std::vector<uint32_t> m_programs; // Dense id -> GL name, kept across frames
+	std::vector<uint32_t> m_vaos;
+
+	auto dense_id(std::vector<uint32_t>& names, uint32_t name) -> uint64_t;
+	void release_pages() noexcept;
+	auto draw_at(uint32_t index) const noexcept -> const Draw& { return m_pages[index / draws_per_page][index % draws_per_page]; }
+public:
+	RenderQueue() = default;
+	~RenderQueue();
+
+	RenderQueue(const RenderQueue&) = delete;
+	RenderQueue& operator=(const RenderQueue&) = delete;
+
+	// Drops last frame's draws and texture sets and starts collecting into arena, which
+	// has to outlive the queue and must not be reset before execute()
+	void begin_frame(FrameArena& arena);
+
+	// GL texture names for units 0.., unlisted units are left as they are
+	auto add_texture_set(std::initializer_list<uint32_t> textures) -> uint32_t;
+	void submit(const Draw& draw);
+
+	// Without sorting execute() runs the draws in submission order
+	void sort();
+	// Binds the ring ranges and issues every draw, leaves the last state bound.
+	// State that's still bound from the previous frame isn't bound again
+	auto execute(const StreamBuffer& ring) const -> Stats;
+
+	auto size() const noexcept -> size_t { return m_frame ? m_frame->draw_count : 0; }
+};
+
+// LSD radix sort on the key, 8 bits per pass, passes where every key shares the byte are skipped
+void radix_sort_keys(uint64_t* keys, uint32_t* values, size_t count, uint64_t* scratch_keys, uint32_t* scratch_values);
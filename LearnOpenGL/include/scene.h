@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+// The first ten positions are the original hand placed cubes, any extra
+// cubes are laid out on a jittered grid centred on the origin
+auto make_cube_positions(uint32_t count) -> std::vector<glm::vec3>;
+
+// Half size of the cube that contains every position returned by make_cube_positions
+auto scene_extent(uint32_t count) -> float_t;
+// Distance the camera orbits the origin at, the original 10 for the hand placed cubes
+auto orbit_radius(uint32_t count) -> float_t;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Expands #include "file" in GLSL sources, relative to the including file. Every file is
+// read and scanned for includes once and kept until its write time changes, so a library
+// shared by many shaders (or a shader rebuilt many times) costs a stat per use.
+//
+// Each file is pasted at most once per shader, later includes of it are dropped, so
+// libraries need no guards and cycles end by themselves. Pasted files are framed with
+// #line directives whose source string number is the file's index in Source::files,
+// which is what compile errors report.
+//
+//     ShaderPreprocessor preprocessor;
+//     const auto vert = preprocessor.load("res/shaders/basic.vert.glsl");
+//     if (vert) ... vert->text, vert->files ...
+class ShaderPreprocessor
+{
+public:
+	struct Source
+	{
+		std::string text;
+		std::vector<std::filesystem::path> files; // Every file pasted in, the root first
+	};
+
+	struct Stats
+	{
+		uint64_t reads = 0;  // Files read from disk
+		uint64_t hits = 0;   // Files taken from the cache
+	};
+private:
+	struct Include
+	{
+		size_t begin; // The directive's line, its newline included
+		size_t end;
+		uint32_t line;
+		std::filesystem::path path;
+	};
+
+	struct File
+	{
+		std::string text;
+		std::vector<Include> includes;
+		std::filesystem::file_time_type write_time;
+	};
+
+	std::unordered_map<std::string, File> m_files;
+	Stats m_stats;
+
+	auto file(const std::filesystem::path& path, std::string& error) -> const File*;
+	auto expand(const std::filesystem::path& path, Source& source, std::string& error) -> bool;
+public:
+	// Logs the failure (a missing file or include) and returns nullopt
+	auto load(const std::filesystem::path& path) -> std::optional<Source>;
+
+	// Which file a compile error's source string number refers to, for the log
+	static auto describe_files(const std::vector<std::filesystem::path>& files) -> std::string;
+
+	auto stats() const noexcept -> const Stats& { return m_stats; }
+};
@@ -2,24 +2,52 @@
 
 #include <cstdint>
 #include <cmath>
-#include <vector>
-#include <unordered_map>
+#include <string>
 #include <gl_error.h>
+#include "uniforms.h"
 
+class ProgramCache;
+
+// Compile and link errors are written to the log, make_shader throws gl_error after logging
 auto make_shader(const char* src, uint32_t type) -> uint32_t;
+auto shader_info_log(uint32_t shader) -> std::string;
+auto program_info_log(uint32_t program) -> std::string;
 
 class ShaderProgram
 {
 private:
-    std::unordered_map<const char*, uint32_t> m_uniforms = {};
+    UniformTable m_uniforms;
 public:
     uint32_t id;
 
-    ShaderProgram(const char* vert_src, const char* frag_src);
+    // With a cache the program is loaded from a stored binary when possible and stored after a compile
+    ShaderProgram(const char* vert_src, const char* frag_src, ProgramCache* cache = nullptr);
+    // Compute program, not cached
+    explicit ShaderProgram(const char* comp_src);
+    // Takes over a program that is already linked (e.g. by ShaderVariants)
+    explicit ShaderProgram(uint32_t linked_program);
     ~ShaderProgram() noexcept;
 
+    // Move only, a moved from program has id 0. Anything holding a pointer to the old
+    // object (e.g. ShaderReloader::watch) has to be pointed at the new one
+    ShaderProgram(ShaderProgram&& other) noexcept;
+    ShaderProgram& operator=(ShaderProgram&& other) noexcept;
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Through gl_state, so a program that is already in use isn't bound again
     void use() noexcept;
 
-    void setUniform(const char* name, std::vector<float_t> value);
-    void setUniform(const char* name, std::vector<int32_t> value);
+    // Takes over a program linked elsewhere (e.g. by ShaderReloader), the old one is deleted
+    void adopt(uint32_t program);
+
+    // Resolve once with uniform("name"), then set(handle, value) in the hot path.
+    // Types are checked against the shader in debug builds.
+    auto uniform(UniformName name) const -> Uniform { return m_uniforms.find(name); }
+    auto uniforms() const noexcept -> const UniformTable& { return m_uniforms; }
+
+    template<typename T>
+    void set(const Uniform& uniform, const T& value) const { m_uniforms.set(uniform, value); }
+    template<typename T>
+    void set(UniformName name, const T& value) const { m_uniforms.set(name, value); }
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+#include "file_watcher.h"
+#include "shader_preprocessor.h"
+#include "shader_program.h"
+#include "shader_variants.h"
+
+class ProgramCache;
+
+// Rebuilds watched programs when one of their source files changes. The build is
+// started in update() and polled on later frames, with GL_KHR_parallel_shader_compile
+// the driver compiles on its own threads and nothing here blocks on it. The old
+// program keeps drawing until the new one has linked, a build that fails to compile
+// or link is logged and dropped. Saving a file either stage #includes rebuilds too.
+//
+// GL thread only.
+class ShaderReloader
+{
+public:
+	using ReloadCallback = std::function<void(ShaderProgram&)>;
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Watched
+	{
+		ShaderProgram* program;
+		std::filesystem::path vert_path;
+		std::filesystem::path frag_path;
+		ReloadCallback on_reload;
+		// Sources come from here when set, with the variant's defines
+		ShaderVariants* variants = nullptr;
+		ShaderVariants::Mask mask = 0;
+		// As of the last build, compile errors number their files by these
+		std::vector<std::filesystem::path> vert_files;
+		std::vector<std::filesystem::path> frag_files;
+	};
+
+	enum class Stage
+	{
+		Compiling,
+		Linking,
+	};
+
+	struct Build
+	{
+		size_t watched;
+		Stage stage;
+		uint32_t program;
+		uint32_t vert;
+		uint32_t frag;
+		uint64_t cache_key;
+		uint64_t variant_key;
+		clock::time_point start;
+	};
+
+	FileWatcher m_watcher;
+	ShaderPreprocessor* m_preprocessor;
+	ProgramCache* m_cache;
+	std::vector<Watched> m_watched;
+	std::vector<Build> m_builds;
+
+	auto load(const Watched& watched, uint32_t type) -> std::optional<ShaderPreprocessor::Source>;
+	void start(size_t watched);
+	void finish(const Build& build, const char* how);
+	void discard(Build& build) noexcept;
+	auto advance(Build& build) -> bool;
+public:
+	ShaderReloader(const std::filesystem::path& directory, ShaderPreprocessor& preprocessor, ProgramCache* cache = nullptr);
+	~ShaderReloader() noexcept;
+
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	// on_reload runs after program has switched over, uniforms start at their defaults again
+	void watch(ShaderProgram& program, const std::filesystem::path& vert_path, const std::filesystem::path& frag_path, ReloadCallback on_reload = {});
+	// The program of one variant, rebuilt with its keywords defined
+	void watch(ShaderVariants& variants, ShaderVariants::Mask mask, ReloadCallback on_reload = {});
+
+	// Once per frame, starts builds for changed files and swaps in the ones that finished
+	void update();
+};
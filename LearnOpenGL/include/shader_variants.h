@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "shader_preprocessor.h"
+#include "shader_program.h"
+
+class ProgramCache;
+
+// Variants of one vertex + fragment pair, picked by a mask of feature keywords. A shader
+// declares its keywords on a line of their own, in the file itself or anything it includes:
+//
+//     #pragma keywords INSTANCED INDIRECT
+//
+// and tests them with #ifdef. A variant's stages get a #define for each requested keyword
+// that stage declares, right after #version and followed by a #line so errors keep their
+// numbers. Keywords are numbered in the order they are first seen, vertex stage first.
+//
+// Built variants are keyed by the hash of their final sources: masks that differ only in
+// keywords no stage reads share one program, and a stage source shared by several
+// programs (the vertex stage of a fragment-only keyword, say) is compiled once. Programs
+// go through the ProgramCache like any other.
+//
+//     ShaderVariants variants(preprocessor, "res/shaders/basic.vert.glsl", "res/shaders/basic.frag.glsl", cache);
+//     auto& program = variants.get(variants.keyword("INSTANCED") | variants.keyword("INDIRECT"));
+//
+// GL thread only.
+class ShaderVariants
+{
+public:
+	using Mask = uint32_t;
+
+	struct Stats
+	{
+		uint32_t variants = 0;        // Masks resolved to a program
+		uint32_t programs = 0;        // Distinct programs among them
+		uint32_t shaders = 0;         // Stage sources compiled
+		uint32_t shared_shaders = 0;  // Stage sources another program had compiled already
+	};
+private:
+	struct Stage
+	{
+		uint32_t type; // GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+		std::filesystem::path path;
+	};
+
+	// Final sources of one variant and the keys they are shared by
+	struct Build
+	{
+		Mask mask;
+		ShaderPreprocessor::Source vert;
+		ShaderPreprocessor::Source frag;
+		uint64_t vert_key = 0;
+		uint64_t frag_key = 0;
+		uint64_t program_key = 0;
+		uint32_t program = 0; // 0 until it is linked, or loaded from the cache
+	};
+
+	ShaderPreprocessor* m_preprocessor;
+	ProgramCache* m_cache;
+	Stage m_vert;
+	Stage m_frag;
+	std::vector<std::string> m_keywords; // Bit i of a mask is keyword i
+
+	std::vector<std::unique_ptr<ShaderProgram>> m_programs;
+	std::unordered_map<uint64_t, ShaderProgram*> m_by_source;
+	std::unordered_map<Mask, ShaderProgram*> m_variants;
+	std::unordered_map<uint64_t, uint32_t> m_shaders; // Compiled stage sources by key
+	Stats m_stats;
+
+	auto declare(const std::string& text) -> Mask;
+	auto prepare(Mask mask) -> std::optional<Build>;
+	auto shader(const Stage& stage, const ShaderPreprocessor::Source& source, uint64_t key) -> uint32_t;
+	auto compile(std::span<Build> builds) -> bool;
+public:
+	// Loads both stages for their keywords, throws gl_error when either can't be loaded
+	ShaderVariants(ShaderPreprocessor& preprocessor, const std::filesystem::path& vert_path, const std::filesystem::path& frag_path, ProgramCache* cache = nullptr);
+	~ShaderVariants() noexcept;
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// The bit of a declared keyword, 0 for anything else so a keyword a shader dropped
+	// simply stops mattering
+	auto keyword(std::string_view name) const noexcept -> Mask;
+	// Every declared keyword
+	auto all_keywords() const noexcept -> Mask { return m_keywords.size() >= 32 ? ~Mask(0) : (Mask(1) << m_keywords.size()) - 1; }
+
+	// The variant's program, compiled on first use. Throws gl_error when it fails to build.
+	// The reference stays valid for the life of the variants
+	auto get(Mask mask) -> ShaderProgram&;
+
+	// Builds every mask that isn't built yet in one batch: all compiles are issued before the
+	// first status check, so a driver with GL_KHR_parallel_shader_compile runs them side by
+	// side. Failures are logged, then thrown as one gl_error
+	void prewarm(std::span<const Mask> masks);
+
+	// A stage's final source for mask, loaded again through the preprocessor (for ShaderReloader)
+	auto source(uint32_t type, Mask mask) -> std::optional<ShaderPreprocessor::Source>;
+	// Rekeys a program that was relinked from other sources, so variants built later share
+	// it only when they would have compiled the same thing
+	void relinked(ShaderProgram& program, uint64_t program_key);
+	static auto program_key(std::string_view vert_src, std::string_view frag_src) noexcept -> uint64_t;
+
+	auto vert_path() const noexcept -> const std::filesystem::path& { return m_vert.path; }
+	auto frag_path() const noexcept -> const std::filesystem::path& { return m_frag.path; }
+	auto keyword_names(Mask mask) const -> std::string;
+	auto stats() const noexcept -> const Stats& { return m_stats; }
+};
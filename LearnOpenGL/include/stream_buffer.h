@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+#include "gl_objects.h"
+
+// Persistently mapped ring for data rewritten every frame (uniform blocks, per object
+// data, instance arrays). The buffer is split into one region per frame in flight, a
+// fence per region keeps the CPU from overwriting anything the GPU hasn't read yet.
+// Allocations are bound with glBindBufferRange, nothing is mapped, unmapped or
+// orphaned per frame.
+//
+//     ring.begin_frame();
+//     auto block = ring.push(frame_data);
+//     ring.bind(GL_UNIFORM_BUFFER, 0, block);
+//     ... draw ...
+//     ring.end_frame();
+class StreamBuffer
+{
+public:
+	static constexpr uint32_t max_frames = 4;
+
+	struct Allocation
+	{
+		void* data = nullptr;
+		size_t offset = 0;
+		size_t size = 0;
+	};
+private:
+	Buffer m_buffer;
+	uint8_t* m_mapped = nullptr;
+	size_t m_frame_bytes = 0;
+	size_t m_alignment = 0;
+	uint32_t m_frame_count = 0;
+
+	uint32_t m_frame = 0;       // Region written this frame
+	size_t m_head = 0;          // Next free byte in that region
+	std::array<GLsync, max_frames> m_fences{};
+	uint32_t m_stalls = 0;      // begin_frame() calls that had to wait on the gpu
+public:
+	// frames regions of frame_bytes each, usually 3 so the cpu can run two frames ahead
+	StreamBuffer(size_t frame_bytes, uint32_t frames = 3);
+	~StreamBuffer() noexcept;
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// Moves to the next region, waiting if the gpu is still reading it
+	void begin_frame();
+	// Fences everything allocated since begin_frame()
+	void end_frame();
+
+	// Aligned for binding as a uniform or shader storage range, throws gl_error when the region is full
+	auto allocate(size_t size) -> Allocation;
+
+	template<typename T>
+	auto push(const T& value) -> Allocation
+	{
+		auto allocation = allocate(sizeof(T));
+		std::memcpy(allocation.data, &value, sizeof(T));
+		return allocation;
+	}
+
+	void bind(GLenum target, uint32_t binding, const Allocation& allocation) const noexcept
+	{
+		glBindBufferRange(target, binding, m_buffer.id(), static_cast<GLintptr>(allocation.offset), static_cast<GLsizeiptr>(allocation.size));
+	}
+
+	// Rounds size up to the binding alignment, for sizing frame_bytes
+	auto aligned_size(size_t size) const noexcept -> size_t { return (size + m_alignment - 1) & ~(m_alignment - 1); }
+	static auto binding_alignment() noexcept -> size_t;
+
+	auto id() const noexcept -> uint32_t { return m_buffer.id(); }
+	auto frame_bytes() const noexcept -> size_t { return m_frame_bytes; }
+	auto stalls() const noexcept -> uint32_t { return m_stalls; }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Line scanning shared by the shader preprocessor, the shader variants and the OBJ
+// importer. Spaces are blanks and tabs, and a carriage return so CRLF files read the same.
+
+inline auto is_space(char c) noexcept -> bool
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// First position at or after pos that isn't a space, line.size() if there is none
+inline auto skip_spaces(std::string_view line, size_t pos) noexcept -> size_t
+{
+	while (pos < line.size() && is_space(line[pos]))
+		pos++;
+	return pos;
+}
+
+inline auto skip_spaces(const char* p, const char* end) noexcept -> const char*
+{
+	while (p != end && is_space(*p))
+		p++;
+	return p;
+}
+
+inline auto skip_token(const char* p, const char* end) noexcept -> const char*
+{
+	while (p != end && !is_space(*p))
+		p++;
+	return p;
+}
+
+// The '\n' ending the line p is on, or end
+inline auto line_end(const char* p, const char* end) noexcept -> const char*
+{
+	const auto* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+	return eol ? eol : end;
+}
+
+// Calls f(line, offset, number) for every line of text, newline included, numbered from
+// 1. Stops early when f returns false
+template<typename F>
+void for_each_line(std::string_view text, F&& f)
+{
+	uint32_t number = 1;
+	for (size_t begin = 0; begin < text.size(); number++)
+	{
+		const size_t newline = text.find('\n', begin);
+		const size_t end = newline == std::string_view::npos ? text.size() : newline + 1;
+		if (!f(text.substr(begin, end - begin), begin, number))
+			return;
+		begin = end;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Cooked texture container (.ltex), written by tools/texture_cook and memory mapped at runtime.
+// Laid out like a stripped down KTX2: a header, a table with one entry per mip level
+// (largest first) and then the level data, every level 16 byte aligned so it can be
+// handed to glTexSubImage2D straight from the mapping.
+constexpr char texture_file_magic[8] = { 'L', 'O', 'G', 'L', 'T', 'E', 'X', '\0' };
+constexpr uint32_t texture_file_version = 1;
+constexpr const char* texture_file_extension = ".ltex";
+
+enum class TextureFileFormat : uint32_t
+{
+	RGBA8 = 1,
+};
+
+struct TextureFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	TextureFileFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_count;
+	uint32_t reserved;
+	uint64_t source_hash; // fnv1a of the source image file, the cook step skips unchanged sources
+};
+
+struct TextureFileLevel
+{
+	uint64_t offset; // From the start of the file
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+static_assert(sizeof(TextureFileHeader) == 40);
+static_assert(sizeof(TextureFileLevel) == 24);
+
+// Header of a mapped container, or nullptr if it's truncated, corrupt or from another version
+inline auto parse_texture_file(const uint8_t* data, size_t size) -> const TextureFileHeader*
+{
+	if (!data || size < sizeof(TextureFileHeader))
+		return nullptr;
+
+	const auto* header = reinterpret_cast<const TextureFileHeader*>(data);
+	if (std::memcmp(header->magic, texture_file_magic, sizeof(texture_file_magic)) != 0
+		|| header->version != texture_file_version
+		|| header->format != TextureFileFormat::RGBA8
+		|| header->width == 0 || header->height == 0
+		|| header->level_count == 0 || header->level_count > 32)
+		return nullptr;
+
+	const size_t table_end = sizeof(TextureFileHeader) + header->level_count * sizeof(TextureFileLevel);
+	if (size < table_end)
+		return nullptr;
+
+	// Levels halve down from the header's size, clamped to 1, and stop at 1x1
+	const auto* levels = reinterpret_cast<const TextureFileLevel*>(data + sizeof(TextureFileHeader));
+	uint32_t width = header->width, height = header->height;
+	for (uint32_t i = 0; i < header->level_count; i++)
+	{
+		if (i > 0)
+		{
+			if (width == 1 && height == 1)
+				return nullptr;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+
+		const auto& level = levels[i];
+		if (level.width != width || level.height != height
+			|| level.offset < table_end || level.offset > size || level.size > size - level.offset
+			|| level.size != uint64_t(width) * height * 4)
+			return nullptr;
+	}
+	return header;
+}
+
+inline auto texture_file_levels(const TextureFileHeader* header) -> const TextureFileLevel*
+{
+	return reinterpret_cast<const TextureFileLevel*>(header + 1);
+}
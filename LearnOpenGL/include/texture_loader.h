@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "gl_objects.h"
+#include "job_system.h"
+#include "lockfree_queue.h"
+#include "mapped_file.h"
+#include "texture_file.h"
+
+// Loads images in jobs on the job system and streams them to the GL thread.
+// Cooked containers (path + ".ltex", see tools/texture_cook.cxx) are memory
+// mapped and every mip level is uploaded straight from the mapping. Anything
+// that wasn't cooked is decoded with stb_image and staged through a
+// persistently mapped pixel unpack buffer. Until a texture is resident
+// texture() returns a placeholder, so drawing never waits on a load.
+//
+// Everything except the decode jobs runs on the thread that owns the GL context.
+class TextureLoader
+{
+public:
+	using Handle = uint32_t;
+
+	struct Settings
+	{
+		size_t staging_bytes = 32 * 1024 * 1024;    // Size of the pixel unpack ring buffer
+		size_t upload_budget = 8 * 1024 * 1024;     // Max bytes uploaded per update()
+	};
+private:
+	struct Request
+	{
+		Handle handle = 0;
+		std::string path;
+	};
+
+	struct Decoded
+	{
+		Handle handle = 0;
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t channels = 0;
+		uint8_t* pixels = nullptr; // stbi allocation, nullptr if decoding failed or the image was cooked
+		MappedFile cooked;
+		const TextureFileHeader* header = nullptr; // Into cooked, nullptr if there is no valid container
+	};
+
+	struct Slot
+	{
+		Texture texture;
+		bool resident = false;
+		bool failed = false;
+		std::string path;
+	};
+
+	// A range of the staging ring the gpu may still be reading from
+	struct InFlight
+	{
+		GLsync fence;
+		size_t begin;
+		size_t end;
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	JobSystem& m_jobs;
+	Settings m_settings;
+	std::vector<Slot> m_slots;
+	Texture m_placeholder;
+
+	MpmcQueue<Request> m_requests;
+	MpmcQueue<Decoded> m_decoded;
+	JobCounter m_decoding;            // One job per request pushed to m_requests
+	std::atomic<bool> m_stopping{ false };
+
+	std::deque<Request> m_overflow;  // Requests that didn't fit in m_requests yet
+	std::deque<Decoded> m_ready;     // Decoded images waiting for staging space or budget
+
+	Buffer m_pbo;
+	uint8_t* m_mapped = nullptr;
+	size_t m_head = 0;
+	std::deque<InFlight> m_in_flight;
+
+	// Streaming stats, reset whenever the loader goes idle
+	size_t m_outstanding = 0;
+	size_t m_streamed_count = 0;
+	size_t m_streamed_bytes = 0;
+	size_t m_streamed_cooked = 0;
+	clock::time_point m_stream_start;
+	clock::time_point m_last_update;
+	double m_worst_frame_ms = 0.0;
+	double m_worst_update_ms = 0.0;
+
+	static void decode_job(void* loader, uint32_t, uint32_t);
+	void decode_next();
+	void retire_staging();
+	auto allocate_staging(size_t size) -> size_t;
+	void allocate_texture(const Texture& texture, int32_t levels, GLenum internal_format, int32_t width, int32_t height);
+	void upload(const Decoded& image, size_t staging_offset);
+	void upload_cooked(const Decoded& image);
+public:
+	static constexpr size_t no_space = SIZE_MAX;
+
+	TextureLoader(JobSystem& jobs, const Settings& settings);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// Queues path for loading, returns immediately
+	auto load(const char* path) -> Handle;
+
+	// GL texture for handle, the placeholder while it's still loading or if it failed
+	auto texture(Handle handle) const noexcept -> uint32_t;
+	auto resident(Handle handle) const noexcept -> bool { return m_slots[handle].resident; }
+	auto failed(Handle handle) const noexcept -> bool { return m_slots[handle].failed; }
+	auto idle() const noexcept -> bool { return m_outstanding == 0; }
+
+	// Call once per frame on the GL thread, uploads whatever finished decoding
+	void update();
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include <glad/glad.h>
+#include "gl_objects.h"
+#include "texture_loader.h"
+
+// Makes streamed textures addressable by index from shaders, so objects with different
+// materials can share one draw. Each material is a row of the material table, an SSBO
+// with one uvec2 per texture slot:
+//
+//     bindless  x, y = the 64 bit handle (GL_ARB_bindless_texture)
+//     arrays    x = array << 24 | layer, y = 0
+//
+// Without bindless every texture is copied on the gpu, all levels, into a layer of the
+// GL_TEXTURE_2D_ARRAY holding the textures of its size and format. Those arrays sit on
+// units 0 .. max_arrays - 1 for the whole frame. A slot whose texture is still loading
+// reads as missing and the shader draws the placeholder instead.
+//
+//     const auto material = residency.add_material({ wood, face });
+//     ... per frame ...
+//     residency.update(loader);
+//     residency.bind(6);
+class TextureResidency
+{
+public:
+	static constexpr uint32_t textures_per_material = 2;
+	static constexpr uint32_t max_arrays = 4;
+	static constexpr uint32_t missing = ~0u;
+
+	using Entry = std::array<uint32_t, 2>;
+private:
+	// One per size and format, grown by doubling when its layers run out
+	struct TextureArray
+	{
+		Texture texture;
+		GLenum internal_format = 0;
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t levels = 0;
+		int32_t layers = 0;
+		int32_t capacity = 0;
+	};
+
+	struct Pending
+	{
+		uint32_t entry;
+		TextureLoader::Handle texture;
+	};
+
+	uint32_t m_sampler;
+	bool m_bindless;
+	int32_t m_max_layers = 0;
+	bool m_full_logged = false;
+
+	std::vector<TextureArray> m_arrays;
+	std::vector<GLuint64> m_handles;  // Made resident, released in the destructor
+	std::vector<Entry> m_resident;    // By loader handle, so a texture shared by materials is copied once
+	std::vector<Entry> m_table;
+	std::vector<Pending> m_pending;
+
+	Buffer m_table_buffer;
+	size_t m_table_capacity = 0; // Entries m_table_buffer has room for
+	size_t m_dirty_begin = SIZE_MAX;
+	size_t m_dirty_end = 0;
+
+	auto make_resident(uint32_t texture) -> Entry;
+	auto add_layer(uint32_t texture) -> Entry;
+	void grow(TextureArray& array, int32_t capacity);
+public:
+	// The sampler's state is baked into bindless handles and bound with the arrays otherwise
+	TextureResidency(const Sampler& sampler, bool allow_bindless = true);
+	~TextureResidency() noexcept;
+
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+
+	// Returns the material index the shaders are given, slots after the listed ones stay missing
+	auto add_material(std::initializer_list<TextureLoader::Handle> textures) -> uint32_t;
+
+	// Call once per frame after loader.update(), picks up textures that finished loading
+	void update(const TextureLoader& loader);
+	void bind(uint32_t binding) const noexcept;
+
+	// GL name of array i for binding to unit i, 0 when there is none (or with bindless)
+	auto array(uint32_t index) const noexcept -> uint32_t { return index < m_arrays.size() ? m_arrays[index].texture.id() : 0; }
+	auto array_count() const noexcept -> uint32_t { return static_cast<uint32_t>(m_arrays.size()); }
+	auto bindless() const noexcept -> bool { return m_bindless; }
+	auto material_count() const noexcept -> uint32_t { return static_cast<uint32_t>(m_table.size() / textures_per_material); }
+	auto pending() const noexcept -> size_t { return m_pending.size(); }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "job_system.h"
+
+// Object transforms stored as structure of arrays so the batch kernels can
+// load 4 (SSE) or 8 (AVX2) objects worth of a component in a single instruction
+class TransformSoA
+{
+public:
+	std::vector<float_t> pos_x, pos_y, pos_z;
+	std::vector<float_t> axis_x, axis_y, axis_z; // Normalized rotation axis
+	std::vector<float_t> angle;                  // Radians, kept within [-pi, pi] for the SIMD sincos
+	std::vector<float_t> scale;                  // Uniform scale
+
+	void reserve(size_t count);
+	void push_back(const glm::vec3& position, const glm::vec3& axis, float_t angle_radians, float_t uniform_scale = 1.0f);
+
+	auto size() const noexcept -> size_t { return angle.size(); }
+};
+
+enum class SimdLevel
+{
+	Scalar, // glm, one object at a time
+	SSE2,
+	AVX2,
+};
+
+// Highest level supported by both the build and the running cpu
+auto best_simd_level() noexcept -> SimdLevel;
+auto simd_level_name(SimdLevel level) -> const char*;
+
+// Writes translate * rotate * scale for every transform as column major mat4s,
+// out only needs float alignment so it can point straight into a mapped buffer
+void build_model_matrices(const TransformSoA& transforms, float_t* out, SimdLevel level = best_simd_level());
+// Model matrices of transforms[indices[0]] ... transforms[indices[count - 1]], packed
+// into out. Used to upload only the objects that survived culling
+void build_model_matrices(const TransformSoA& transforms, const uint32_t* indices, size_t count, float_t* out, SimdLevel level = best_simd_level());
+
+// The same split over the job system, the results are identical
+constexpr uint32_t parallel_grain = 2048; // Transforms per job, at least
+void build_model_matrices(JobSystem& jobs, const TransformSoA& transforms, float_t* out, SimdLevel level = best_simd_level());
+void build_model_matrices(JobSystem& jobs, const TransformSoA& transforms, const uint32_t* indices, size_t count, float_t* out, SimdLevel level = best_simd_level());
+
+// Same as build_model_matrices but premultiplied by view_proj
+void build_mvp_matrices(const TransformSoA& transforms, const glm::mat4& view_proj, float_t* out, SimdLevel level = best_simd_level());
@@ -0,0 +1,190 @@
+#pragma once
+
+// Batch kernels shared by the SSE2 and AVX2 translation units. V is a small
+// traits struct wrapping one instruction set, see transform.cxx and
+// transform_avx2.cxx. Everything here is a template so each TU gets its own
+// instantiation compiled with its own target flags. Keep glm and the project
+// headers out of here: any inline function the AVX2 TU pulls in gets an AVX2
+// compiled copy the linker is free to pick for every other caller.
+
+#include <cstddef>
+
+namespace transform_simd
+{
+
+// A few transforms picked by index and copied together, the same layout as TransformSoA
+// in fixed arrays so gathering lives on the stack instead of in per thread vectors
+struct TransformGather
+{
+	static constexpr size_t capacity = 256;
+
+	alignas(32) float pos_x[capacity], pos_y[capacity], pos_z[capacity];
+	alignas(32) float axis_x[capacity], axis_y[capacity], axis_z[capacity];
+	alignas(32) float angle[capacity];
+	alignas(32) float scale[capacity];
+};
+
+// The components of a TransformSoA or a TransformGather, all the kernels get to see
+struct TransformArrays
+{
+	const float* pos_x;
+	const float* pos_y;
+	const float* pos_z;
+	const float* axis_x;
+	const float* axis_y;
+	const float* axis_z;
+	const float* angle;
+	const float* scale;
+};
+
+#if defined(SIMD_X86)
+// Defined in transform_avx2.cxx, the only TU built with AVX2 enabled. vp is a column major mat4
+auto build_models_avx2(const TransformArrays& t, size_t begin, size_t end, float* out) -> size_t;
+auto build_mvps_avx2(const TransformArrays& t, size_t size, const float* vp, float* out) -> size_t;
+#endif
+
+// Cephes style sincos, accurate to ~1e-7 over the range glm::rotate cares about
+template<typename V>
+inline void sincos(typename V::f x, typename V::f& s, typename V::f& c)
+{
+	using f = typename V::f;
+	using i = typename V::i;
+
+	f sign_sin = V::and_(x, V::sign_mask());
+	x = V::andnot(V::sign_mask(), x);
+
+	f y = V::mul(x, V::set1(1.27323954473516f)); // 4 / pi
+	i j = V::cvtt(y);
+	j = V::and_i(V::add_i(j, V::set1_i(1)), V::set1_i(~1));
+	y = V::cvt(j);
+
+	const f swap_sign_sin = V::cast_f(V::shl29(V::and_i(j, V::set1_i(4))));
+	const f poly_mask = V::cast_f(V::cmpeq_i(V::and_i(j, V::set1_i(2)), V::set1_i(0)));
+	const f sign_cos = V::cast_f(V::shl29(V::andnot_i(V::sub_i(j, V::set1_i(2)), V::set1_i(4))));
+	sign_sin = V::xor_(sign_sin, swap_sign_sin);
+
+	// Extended precision modular arithmetic, x - y * pi / 4
+	x = V::add(x, V::mul(y, V::set1(-0.78515625f)));
+	x = V::add(x, V::mul(y, V::set1(-2.4187564849853515625e-4f)));
+	x = V::add(x, V::mul(y, V::set1(-3.77489497744594108e-8f)));
+
+	const f z = V::mul(x, x);
+
+	f yc = V::add(V::mul(V::set1(2.443315711809948e-5f), z), V::set1(-1.388731625493765e-3f));
+	yc = V::add(V::mul(yc, z), V::set1(4.166664568298827e-2f));
+	yc = V::mul(V::mul(yc, z), z);
+	yc = V::sub(yc, V::mul(z, V::set1(0.5f)));
+	yc = V::add(yc, V::set1(1.0f));
+
+	f ys = V::add(V::mul(V::set1(-1.9515295891e-4f), z), V::set1(8.3321608736e-3f));
+	ys = V::add(V::mul(ys, z), V::set1(-1.6666654611e-1f));
+	ys = V::add(V::mul(V::mul(ys, z), x), x);
+
+	const f sin_poly = V::or_(V::and_(poly_mask, ys), V::andnot(poly_mask, yc));
+	const f cos_poly = V::or_(V::and_(poly_mask, yc), V::andnot(poly_mask, ys));
+
+	s = V::xor_(sin_poly, sign_sin);
+	c = V::xor_(cos_poly, sign_cos);
+}
+
+// m[col][row] for the upper 3x4 of translate * rotate * scale, the last row is always (0, 0, 0, 1)
+template<typename V>
+inline void model_batch(const TransformArrays& t, size_t first, typename V::f m[4][3])
+{
+	using f = typename V::f;
+
+	const f x = V::load(t.axis_x + first);
+	const f y = V::load(t.axis_y + first);
+	const f z = V::load(t.axis_z + first);
+	const f scale = V::load(t.scale + first);
+
+	f s, c;
+	sincos<V>(V::load(t.angle + first), s, c);
+
+	// Same expansion as glm::rotate
+	const f k = V::sub(V::set1(1.0f), c);
+	const f kx = V::mul(k, x), ky = V::mul(k, y), kz = V::mul(k, z);
+	const f sx = V::mul(s, x), sy = V::mul(s, y), sz = V::mul(s, z);
+
+	m[0][0] = V::mul(V::add(c, V::mul(kx, x)), scale);
+	m[0][1] = V::mul(V::add(V::mul(kx, y), sz), scale);
+	m[0][2] = V::mul(V::sub(V::mul(kx, z), sy), scale);
+
+	m[1][0] = V::mul(V::sub(V::mul(ky, x), sz), scale);
+	m[1][1] = V::mul(V::add(c, V::mul(ky, y)), scale);
+	m[1][2] = V::mul(V::add(V::mul(ky, z), sx), scale);
+
+	m[2][0] = V::mul(V::add(V::mul(kz, x), sy), scale);
+	m[2][1] = V::mul(V::sub(V::mul(kz, y), sx), scale);
+	m[2][2] = V::mul(V::add(c, V::mul(kz, z)), scale);
+
+	m[3][0] = V::load(t.pos_x + first);
+	m[3][1] = V::load(t.pos_y + first);
+	m[3][2] = V::load(t.pos_z + first);
+}
+
+// Transforms begin .. end into out + begin * 16, returns the index of the first
+// transform left for the scalar tail
+template<typename V>
+inline auto build_models(const TransformArrays& t, size_t begin, size_t end, float* out) -> size_t
+{
+	using f = typename V::f;
+
+	const size_t count = end - (end - begin) % V::width;
+	const f zero = V::set1(0.0f);
+	const f one = V::set1(1.0f);
+
+	for (size_t i = begin; i < count; i += V::width)
+	{
+		f m[4][3];
+		model_batch<V>(t, i, m);
+
+		float* dst = out + i * 16;
+		V::store_columns(dst + 0, m[0][0], m[0][1], m[0][2], zero);
+		V::store_columns(dst + 4, m[1][0], m[1][1], m[1][2], zero);
+		V::store_columns(dst + 8, m[2][0], m[2][1], m[2][2], zero);
+		V::store_columns(dst + 12, m[3][0], m[3][1], m[3][2], one);
+	}
+
+	return count;
+}
+
+template<typename V>
+inline auto build_mvps(const TransformArrays& t, size_t size, const float* vp, float* out) -> size_t
+{
+	using f = typename V::f;
+
+	const size_t count = size - size % V::width;
+
+	f b[4][4];
+	for (int col = 0; col < 4; col++)
+		for (int row = 0; row < 4; row++)
+			b[col][row] = V::set1(vp[col * 4 + row]);
+
+	for (size_t i = 0; i < count; i += V::width)
+	{
+		f m[4][3];
+		model_batch<V>(t, i, m);
+
+		float* dst = out + i * 16;
+		for (int col = 0; col < 4; col++)
+		{
+			f r[4];
+			for (int row = 0; row < 4; row++)
+			{
+				r[row] = V::add(V::add(
+					V::mul(b[0][row], m[col][0]),
+					V::mul(b[1][row], m[col][1])),
+					V::mul(b[2][row], m[col][2]));
+				// The model's w row is (0, 0, 0, 1)
+				if (col == 3)
+					r[row] = V::add(r[row], b[3][row]);
+			}
+			V::store_columns(dst + col * 4, r[0], r[1], r[2], r[3]);
+		}
+	}
+
+	return count;
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer handoff of whole snapshots. The producer fills back()
+// while the consumer reads the snapshot it acquired last, and the third slot carries the
+// newest published one between them. The slots trade places through one atomic word,
+// nothing locks, and waiting is done with atomic wait / notify.
+//
+// publish() waits until the consumer took the previous snapshot, so the producer runs at
+// most one snapshot ahead and none is skipped, which keeps headless runs deterministic.
+//
+//     TripleBuffer<Frame> frames([] { return Frame{}; });
+//     producer: fill(frames.back()); if (!frames.publish()) break;
+//     consumer: while (const Frame* frame = frames.acquire()) draw(*frame);
+template<typename T>
+class TripleBuffer
+{
+private:
+	static constexpr uint32_t index_mask = 3;
+	static constexpr uint32_t fresh_bit = 4;  // The middle slot holds a snapshot not acquired yet
+	static constexpr uint32_t closed_bit = 8;
+
+	std::array<T, 3> m_slots;
+	std::atomic<uint32_t> m_middle{ 1 }; // Index of the middle slot and the bits above
+	uint32_t m_back = 0;                 // Producer only
+	uint32_t m_front = 2;                // Consumer only
+
+	static_assert(std::atomic<uint32_t>::is_always_lock_free);
+public:
+	// Every slot is made by its own call, a copy wouldn't keep the capacity make reserved
+	template<typename Make>
+	explicit TripleBuffer(Make make) : m_slots{ make(), make(), make() } {}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	auto back() noexcept -> T& { return m_slots[m_back]; }
+
+	// Hands back() over and gives the producer another slot, false once closed
+	auto publish() noexcept -> bool
+	{
+		uint32_t state = m_middle.load(std::memory_order_acquire);
+		for (;;)
+		{
+			if (state & closed_bit)
+				return false;
+			if (state & fresh_bit)
+			{
+				m_middle.wait(state, std::memory_order_acquire);
+				state = m_middle.load(std::memory_order_acquire);
+				continue;
+			}
+			if (m_middle.compare_exchange_weak(state, m_back | fresh_bit, std::memory_order_acq_rel, std::memory_order_acquire))
+				break;
+		}
+		m_back = state & index_mask;
+		m_middle.notify_all();
+		return true;
+	}
+
+	// Waits for the next snapshot, valid until the following call. Once closed the last
+	// published snapshot is still returned, then nullptr
+	auto acquire() noexcept -> const T*
+	{
+		uint32_t state = m_middle.load(std::memory_order_acquire);
+		for (;;)
+		{
+			if (state & fresh_bit)
+			{
+				if (m_middle.compare_exchange_weak(state, m_front | (state & closed_bit), std::memory_order_acq_rel, std::memory_order_acquire))
+					break;
+				continue;
+			}
+			if (state & closed_bit)
+				return nullptr;
+			m_middle.wait(state, std::memory_order_acquire);
+			state = m_middle.load(std::memory_order_acquire);
+		}
+		m_front = state & index_mask;
+		m_middle.notify_all();
+		return &m_slots[m_front];
+	}
+
+	// Either side, wakes the other one up and makes publish() fail from then on
+	void close() noexcept
+	{
+		m_middle.fetch_or(closed_bit, std::memory_order_release);
+		m_middle.notify_all();
+	}
+};
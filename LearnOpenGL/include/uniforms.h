@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "hash.h"
+
+// Uniform name hashed at compile time, pass a string literal straight to find() or set().
+// Names only known at runtime go through UniformName::runtime().
+struct UniformName
+{
+	uint64_t hash;
+	std::string_view str;
+
+	consteval UniformName(const char* name)
+		: hash(fnv1a(name)), str(name) {}
+
+	static auto runtime(std::string_view name) noexcept -> UniformName { return UniformName(fnv1a(name), name); }
+private:
+	constexpr UniformName(uint64_t name_hash, std::string_view name)
+		: hash(name_hash), str(name) {}
+};
+
+// Resolved uniform, look it up once and keep it around for per draw updates
+struct Uniform
+{
+	int32_t location = -1;
+	uint32_t type = 0; // GLSL type from reflection, checked against the setter in debug builds
+	int32_t count = 0; // Array length, 1 for non arrays
+};
+
+// Typed uploads for every C++ type a uniform can be set from. accepts() lists the GLSL types
+// each one may legally be written to with the matching glProgramUniform* call.
+auto is_opaque_uniform_type(uint32_t type) noexcept -> bool;
+
+template<typename T>
+struct UniformTraits;
+
+#define LEARNOPENGL_UNIFORM_TRAITS(T, NAME, ACCEPTS, UPLOAD) \
+	template<> struct UniformTraits<T> \
+	{ \
+		static constexpr const char* name = NAME; \
+		static constexpr auto accepts(uint32_t type) noexcept -> bool { return ACCEPTS; } \
+		static void upload(uint32_t program, int32_t location, const T& v) noexcept { UPLOAD; } \
+	};
+
+LEARNOPENGL_UNIFORM_TRAITS(float_t, "float", type == GL_FLOAT, glProgramUniform1f(program, location, v))
+LEARNOPENGL_UNIFORM_TRAITS(glm::vec2, "vec2", type == GL_FLOAT_VEC2, glProgramUniform2fv(program, location, 1, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(glm::vec3, "vec3", type == GL_FLOAT_VEC3, glProgramUniform3fv(program, location, 1, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(glm::vec4, "vec4", type == GL_FLOAT_VEC4, glProgramUniform4fv(program, location, 1, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(int32_t, "int", type == GL_INT || type == GL_BOOL || is_opaque_uniform_type(type), glProgramUniform1i(program, location, v))
+LEARNOPENGL_UNIFORM_TRAITS(glm::ivec2, "ivec2", type == GL_INT_VEC2 || type == GL_BOOL_VEC2, glProgramUniform2iv(program, location, 1, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(glm::ivec3, "ivec3", type == GL_INT_VEC3 || type == GL_BOOL_VEC3, glProgramUniform3iv(program, location, 1, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(glm::ivec4, "ivec4", type == GL_INT_VEC4 || type == GL_BOOL_VEC4, glProgramUniform4iv(program, location, 1, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(uint32_t, "uint", type == GL_UNSIGNED_INT || type == GL_BOOL, glProgramUniform1ui(program, location, v))
+LEARNOPENGL_UNIFORM_TRAITS(bool, "bool", type == GL_BOOL, glProgramUniform1i(program, location, v ? 1 : 0))
+LEARNOPENGL_UNIFORM_TRAITS(glm::mat3, "mat3", type == GL_FLOAT_MAT3, glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, glm::value_ptr(v)))
+LEARNOPENGL_UNIFORM_TRAITS(glm::mat4, "mat4", type == GL_FLOAT_MAT4, glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(v)))
+
+#undef LEARNOPENGL_UNIFORM_TRAITS
+
+// Every active default block uniform of a linked program, found through program interface
+// queries right after linking. Setters go through glProgramUniform*, so the program
+// doesn't have to be bound, and never allocate.
+class UniformTable
+{
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		Uniform uniform;
+		std::string name;
+	};
+
+	uint32_t m_program = 0;
+	std::vector<Entry> m_entries; // Sorted by hash
+
+	[[noreturn]] void throw_type_mismatch(const Uniform& uniform, const char* cpp_type) const;
+public:
+	UniformTable() = default;
+	explicit UniformTable(uint32_t program) noexcept : m_program(program) {}
+
+	static auto reflect(uint32_t program) -> UniformTable;
+
+	// Registers a uniform by hand, reflect() calls this for each active uniform
+	void add(std::string_view name, int32_t location, uint32_t type, int32_t count);
+
+	// Throws gl_error if the program has no active uniform with that name
+	auto find(UniformName name) const -> Uniform;
+	auto contains(UniformName name) const noexcept -> bool;
+
+	template<typename T>
+	void set(const Uniform& uniform, const T& value) const
+	{
+#if !defined(NDEBUG)
+		if (!UniformTraits<T>::accepts(uniform.type))
+			throw_type_mismatch(uniform, UniformTraits<T>::name);
+#endif
+		UniformTraits<T>::upload(m_program, uniform.location, value);
+	}
+
+	template<typename T>
+	void set(UniformName name, const T& value) const { set(find(name), value); }
+
+	auto program() const noexcept -> uint32_t { return m_program; }
+	auto size() const noexcept -> size_t { return m_entries.size(); }
+};
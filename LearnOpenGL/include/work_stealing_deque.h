@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded Chase-Lev deque (the C11 formulation of Lê, Pop, Cohen and Zappa Nardelli).
+// The owning thread pushes and pops at the bottom, newest first, while any other thread
+// steals from the top, oldest first. The owner only contends with thieves over the last
+// item. T is copied through an atomic, so it should be a pointer or a small integer
+template<typename T>
+class WorkStealingDeque
+{
+private:
+	static constexpr size_t cache_line = 64;
+
+	std::unique_ptr<std::atomic<T>[]> m_items;
+	int64_t m_mask;
+	alignas(cache_line) std::atomic<int64_t> m_top{ 0 };
+	alignas(cache_line) std::atomic<int64_t> m_bottom{ 0 };
+public:
+	// capacity must be a power of two
+	explicit WorkStealingDeque(size_t capacity)
+		: m_items(new std::atomic<T>[capacity]), m_mask(static_cast<int64_t>(capacity) - 1)
+	{
+		assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	// Owner only, returns false when the deque is full
+	auto push(T item) noexcept -> bool
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const int64_t top = m_top.load(std::memory_order_acquire);
+		if (bottom - top > m_mask)
+			return false;
+
+		// Released through bottom, a thief reading it sees the item and what it points to
+		m_items[bottom & m_mask].store(item, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Owner only, returns false when the deque is empty
+	auto pop(T& item) noexcept -> bool
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = m_items[bottom & m_mask].load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			// The last item, a thief may be taking it at the same time
+			const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	// Any thread, returns false when the deque is empty or another thread won the item
+	auto steal(T& item) noexcept -> bool
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return false;
+
+		item = m_items[top & m_mask].load(std::memory_order_relaxed);
+		return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	// Approximate unless called by the owner with no thieves around
+	auto empty() const noexcept -> bool
+	{
+		return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+	}
+};
@@ -1,13 +1,20 @@
 #version 430 core
+// BINDLESS (see material.glsl) is only requested where the driver has the extension
+#if defined(BINDLESS)
+#extension GL_ARB_bindless_texture : require
+#endif
 
 in vec2 fTexCoord;
+flat in uint fMaterial;
 
 out vec4 color;
 
-layout (binding = 0) uniform sampler2D uTexture0;
-layout (binding = 1) uniform sampler2D uTexture1;
+#include "material.glsl"
 
 void main()
 {
-	color = mix(texture(uTexture0, fTexCoord), texture(uTexture1, fTexCoord), 0.2);
+	// Taken outside the branches, where every fragment of the quad still runs
+	vec2 dx = dFdx(fTexCoord);
+	vec2 dy = dFdy(fTexCoord);
+	color = mix(sampleMaterial(fMaterial, 0u, fTexCoord, dx, dy), sampleMaterial(fMaterial, 1u, fTexCoord, dx, dy), 0.2);
 }
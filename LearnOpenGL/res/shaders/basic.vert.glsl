@@ -1,16 +1,54 @@
 #version 430 core
+// INSTANCED reads matrices and materials per instance from the SSBOs, INDIRECT takes the
+// object from aObject (gpu culled draws) instead of gl_InstanceID
+#pragma keywords INSTANCED INDIRECT
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+// Per instance, the object a surviving instance belongs to in gpu culled draws
+layout (location = 2) in uint aObject;
 
 out vec2 fTexCoord;
+flat out uint fMaterial;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+layout (std430, binding = 0) readonly buffer InstanceData
+{
+	mat4 instanceModels[];
+};
+
+// Row of the material table per instance, or per object in gpu culled draws
+layout (std430, binding = 5) readonly buffer InstanceMaterials
+{
+	uint instanceMaterials[];
+};
+
+// Bound per frame and per draw from ranges of a persistently mapped ring
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 proj;
+};
+
+layout (std140, binding = 1) uniform Object
+{
+	mat4 model;
+	uint material;
+};
 
 void main()
 {
+#if defined(INDIRECT)
+	uint index = aObject;
+#else
+	uint index = uint(gl_InstanceID);
+#endif
+
+#if defined(INSTANCED)
+	gl_Position = proj * view * instanceModels[index] * vec4(aPos, 1.0);
+	fMaterial = instanceMaterials[index];
+#else
 	gl_Position = proj * view * model * vec4(aPos, 1.0);
+	fMaterial = material;
+#endif
 	fTexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y);
 }
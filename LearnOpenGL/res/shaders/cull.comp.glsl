@@ -0,0 +1,124 @@
+#version 430 core
+
+layout (local_size_x = 256) in;
+
+// World space bounding sphere per object, xyz center and w radius
+layout (std430, binding = 1) readonly buffer Bounds
+{
+	vec4 bounds[];
+};
+
+// One DrawElementsIndirectCommand per material, instanceCount reset to 0 every frame
+struct Command
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 2) buffer Commands
+{
+	Command commands[];
+};
+
+// 1 once a material has a survivor, read as the draw count of its multi draw
+layout (std430, binding = 3) buffer DrawCounts
+{
+	uint drawCounts[];
+};
+
+// Surviving object ids, material m's from commands[m].baseInstance on
+layout (std430, binding = 4) writeonly buffer Visible
+{
+	uint visible[];
+};
+
+// Objects the depth pyramid hid this frame
+layout (std430, binding = 7) buffer Occlusion
+{
+	uint occludedCount;
+};
+
+layout (std140, binding = 2) uniform Cull
+{
+	vec4 planes[6]; // Pointing inwards
+	mat4 occlusionViewProj; // The one the pyramid was built with, last frame's
+	uint objectCount;
+	uint materialCount;
+	uint cullEnabled;
+	uint occlusionEnabled;
+	ivec2 depthSize;
+	int pyramidLevels;
+};
+
+// Farthest depth per texel, level 0 is half of depthSize, see hiz.comp.glsl
+layout (binding = 15) uniform sampler2D depthPyramid;
+
+// Whether the sphere is behind last frame's depth everywhere it would cover. The box
+// around it is projected, if it reaches behind the camera or off screen nothing is known
+bool occluded(vec4 sphere)
+{
+	vec2 lo = vec2(1.0);
+	vec2 hi = vec2(-1.0);
+	float nearest = 1.0;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = occlusionViewProj * vec4(corner, 1.0);
+		if (clip.w <= 0.0)
+			return false;
+		vec3 ndc = clip.xyz / clip.w;
+		lo = min(lo, ndc.xy);
+		hi = max(hi, ndc.xy);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+	// Last frame saw nothing past its edges, the camera may have turned towards it since
+	if (nearest <= 0.0 || any(lessThan(lo, vec2(-1.0))) || any(greaterThan(hi, vec2(1.0))))
+		return false;
+
+	ivec2 pmin = min(ivec2(floor((lo * 0.5 + 0.5) * vec2(depthSize))), depthSize - 1);
+	ivec2 pmax = min(ivec2(floor((hi * 0.5 + 0.5) * vec2(depthSize))), depthSize - 1);
+
+	// The smallest level where the rect spans at most 2x2 texels
+	ivec2 extent = pmax - pmin;
+	int level = clamp(findMSB(max(extent.x, extent.y) - 1), 0, pyramidLevels - 1);
+	// Level sizes round down from half of depthSize. Not textureSize, whose lod has to be
+	// the same across a subgroup on some implementations
+	ivec2 last = max((depthSize / 2) >> level, ivec2(1)) - 1;
+	ivec2 tmin = min(pmin >> (level + 1), last);
+	ivec2 tmax = min(pmax >> (level + 1), last);
+
+	float farthest = max(
+		max(texelFetch(depthPyramid, tmin, level).r, texelFetch(depthPyramid, ivec2(tmax.x, tmin.y), level).r),
+		max(texelFetch(depthPyramid, ivec2(tmin.x, tmax.y), level).r, texelFetch(depthPyramid, tmax, level).r));
+	return nearest > farthest;
+}
+
+void main()
+{
+	uint object = gl_GlobalInvocationID.x;
+	if (object >= objectCount)
+		return;
+
+	vec4 sphere = bounds[object];
+	if (cullEnabled != 0u)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w)
+				return;
+		}
+	}
+	if (occlusionEnabled != 0u && occluded(sphere))
+	{
+		atomicAdd(occludedCount, 1u);
+		return;
+	}
+
+	uint material = object % materialCount;
+	uint slot = atomicAdd(commands[material].instanceCount, 1u);
+	visible[commands[material].baseInstance + slot] = object;
+	drawCounts[material] = 1u;
+}
@@ -0,0 +1,31 @@
+#version 430 core
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// The depth copy for level 0, the pyramid itself for the levels after it
+layout (binding = 15) uniform sampler2D source;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+uniform int sourceLevel;
+uniform ivec2 sourceSize;
+
+// Farthest depth of the 2x2 source texels under each texel. Sizes round down, so along an
+// odd edge the last texel takes 3, and nothing is skipped
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(destination);
+	if (any(greaterThanEqual(texel, size)))
+		return;
+
+	ivec2 first = texel * 2;
+	ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize - 1);
+
+	float depth = 0.0;
+	for (int y = first.y; y <= last.y; y++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+			depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+	}
+	imageStore(destination, texel, vec4(depth));
+}
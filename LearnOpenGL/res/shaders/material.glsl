@@ -0,0 +1,44 @@
+// Material table lookups for fragment shaders. BINDLESS samples the handles in the table,
+// and as #extension has to come before any declaration, the including shader requires
+// GL_ARB_bindless_texture with it
+#pragma keywords BINDLESS
+
+// Two entries per material, see TextureResidency: a bindless handle, or array << 24 | layer
+layout (std430, binding = 6) readonly buffer MaterialTable
+{
+	uvec2 materialTextures[];
+};
+
+// Textures of one size and format each, the array index comes from the table
+layout (binding = 0) uniform sampler2DArray uArrays[4];
+
+const uint missing = 0xFFFFFFFFu;
+
+// Magenta / black checker like the loader's placeholder
+vec4 placeholder(vec2 uv)
+{
+	vec2 cell = floor(uv * 2.0);
+	return mod(cell.x + cell.y, 2.0) == 0.0 ? vec4(1.0, 0.0, 1.0, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+vec4 sampleMaterial(uint material, uint slot, vec2 uv, vec2 dx, vec2 dy)
+{
+	uvec2 entry = materialTextures[material * 2u + slot];
+	if (entry.x == missing)
+		return placeholder(uv);
+
+#if defined(BINDLESS)
+	return textureGrad(sampler2D(entry), uv, dx, dy);
+#else
+	// Sampler arrays only take dynamically uniform indices, so each array gets its own branch
+	vec3 coord = vec3(uv, float(entry.x & 0xFFFFFFu));
+	switch (entry.x >> 24)
+	{
+	case 0u: return textureGrad(uArrays[0], coord, dx, dy);
+	case 1u: return textureGrad(uArrays[1], coord, dx, dy);
+	case 2u: return textureGrad(uArrays[2], coord, dx, dy);
+	case 3u: return textureGrad(uArrays[3], coord, dx, dy);
+	}
+	return placeholder(uv);
+#endif
+}
@@ -0,0 +1,88 @@
+#include "alloc_stats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(WINDOWS)
+#include <malloc.h>
+#endif // defined(WINDOWS)
+
+namespace
+{
+	std::atomic<uint64_t> g_allocations{ 0 };
+	std::atomic<uint64_t> g_bytes{ 0 };
+	std::atomic<uint64_t> g_frees{ 0 };
+
+	auto counted_alloc(size_t size, size_t alignment) noexcept -> void*
+	{
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		g_bytes.fetch_add(size, std::memory_order_relaxed);
+
+		size = size == 0 ? 1 : size;
+		if (alignment <= alignof(std::max_align_t))
+			return std::malloc(size);
+#if defined(WINDOWS)
+		return _aligned_malloc(size, alignment);
+#else
+		// aligned_alloc wants a multiple of the alignment
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif // defined(WINDOWS)
+	}
+
+	void counted_free(void* ptr, size_t alignment) noexcept
+	{
+		if (!ptr)
+			return;
+		g_frees.fetch_add(1, std::memory_order_relaxed);
+#if defined(WINDOWS)
+		if (alignment > alignof(std::max_align_t))
+		{
+			_aligned_free(ptr);
+			return;
+		}
+#endif // defined(WINDOWS)
+		(void)alignment;
+		std::free(ptr);
+	}
+
+	auto throwing_alloc(size_t size, size_t alignment) -> void*
+	{
+		void* ptr = counted_alloc(size, alignment);
+		if (!ptr)
+			throw std::bad_alloc();
+		return ptr;
+	}
+}
+
+auto alloc_stats() noexcept -> AllocStats
+{
+	return {
+		g_allocations.load(std::memory_order_relaxed),
+		g_bytes.load(std::memory_order_relaxed),
+		g_frees.load(std::memory_order_relaxed),
+	};
+}
+
+constexpr size_t default_alignment = alignof(std::max_align_t);
+
+void* operator new(size_t size) { return throwing_alloc(size, default_alignment); }
+void* operator new[](size_t size) { return throwing_alloc(size, default_alignment); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, default_alignment); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, default_alignment); }
+void* operator new(size_t size, std::align_val_t alignment) { return throwing_alloc(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return throwing_alloc(size, static_cast<size_t>(alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return counted_alloc(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return counted_alloc(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* ptr) noexcept { counted_free(ptr, default_alignment); }
+void operator delete[](void* ptr) noexcept { counted_free(ptr, default_alignment); }
+void operator delete(void* ptr, size_t) noexcept { counted_free(ptr, default_alignment); }
+void operator delete[](void* ptr, size_t) noexcept { counted_free(ptr, default_alignment); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { counted_free(ptr, default_alignment); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { counted_free(ptr, default_alignment); }
+void operator delete(void* ptr, std::align_val_t alignment) noexcept { counted_free(ptr, static_cast<size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept { counted_free(ptr, static_cast<size_t>(alignment)); }
+void operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept { counted_free(ptr, static_cast<size_t>(alignment)); }
+void operator delete[](void* ptr, size_t, std::align_val_t alignment) noexcept { counted_free(ptr, static_cast<size_t>(alignment)); }
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { counted_free(ptr, static_cast<size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { counted_free(ptr, static_cast<size_t>(alignment)); }
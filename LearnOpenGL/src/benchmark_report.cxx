@@ -0,0 +1,108 @@
+#include "benchmark_report.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <string_view>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+BenchmarkReport::BenchmarkReport(uint32_t frames)
+{
+	m_frame_ms.reserve(frames);
+}
+
+void BenchmarkReport::begin_frame() noexcept
+{
+	m_frame_start = clock::now();
+}
+
+void BenchmarkReport::end_frame(const FrameStats& stats, bool steady_state)
+{
+	m_frame_ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - m_frame_start).count());
+	m_draw_calls += stats.draw_calls;
+	m_triangles += stats.triangles;
+	m_submitted += stats.instances;
+	m_culled += stats.culled;
+	m_occluded += stats.occluded;
+	m_ring_stalls += stats.ring_stalls;
+	m_program_switches += stats.program_switches;
+	m_texture_binds += stats.texture_binds;
+	m_vao_switches += stats.vao_switches;
+	m_binds_avoided += stats.binds_avoided;
+
+	m_allocations += stats.allocations;
+	if (!steady_state)
+		return;
+	m_steady_frames++;
+	if (stats.allocations == 0)
+		return;
+	if (m_allocating_frames++ == 0)
+		spdlog::warn("Frame {} allocated {} times after warm-up", m_frame_ms.size() - 1, stats.allocations);
+	m_steady_allocations += stats.allocations;
+}
+
+static auto json_string(std::string_view str) -> std::string
+{
+	std::string result = "\"";
+	for (const char c : str)
+	{
+		if (c == '"' || c == '\\')
+			result += '\\';
+		result += c;
+	}
+	result += '"';
+	return result;
+}
+
+auto BenchmarkReport::to_json(const Info& info) const -> std::string
+{
+	const size_t frames = m_frame_ms.size();
+	const double per_frame = frames > 0 ? 1.0 / static_cast<double>(frames) : 0.0;
+
+	auto sorted = m_frame_ms;
+	std::sort(sorted.begin(), sorted.end());
+	const auto percentile = [&](double p) {
+		return sorted.empty() ? 0.0 : sorted[static_cast<size_t>(p * (sorted.size() - 1) + 0.5)];
+	};
+	const double total_ms = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+
+	std::string json = "{\n";
+	json += fmt::format("  \"renderer\": {},\n", json_string(info.renderer));
+	json += fmt::format("  \"version\": {},\n", json_string(info.version));
+	json += fmt::format("  \"mode\": {},\n", json_string(info.mode));
+	json += fmt::format("  \"cull\": {},\n", json_string(info.cull));
+	json += fmt::format("  \"instances\": {},\n", info.instances);
+	json += fmt::format("  \"width\": {},\n", info.width);
+	json += fmt::format("  \"height\": {},\n", info.height);
+	json += fmt::format("  \"frames\": {},\n", frames);
+	json += fmt::format("  \"total_ms\": {:.3f},\n", total_ms);
+	json += fmt::format("  \"frame_ms\": {{ \"mean\": {:.4f}, \"min\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }},\n",
+		total_ms * per_frame, percentile(0.0), percentile(0.5), percentile(0.95), percentile(0.99), percentile(1.0));
+	json += fmt::format("  \"fps\": {:.2f},\n", total_ms > 0.0 ? frames * 1000.0 / total_ms : 0.0);
+	json += fmt::format("  \"draw_calls\": {{ \"total\": {}, \"per_frame\": {:.2f} }},\n", m_draw_calls, m_draw_calls * per_frame);
+	json += fmt::format("  \"triangles\": {{ \"total\": {}, \"per_frame\": {:.2f} }},\n", m_triangles, m_triangles * per_frame);
+	json += fmt::format("  \"submitted\": {{ \"total\": {}, \"per_frame\": {:.2f} }},\n", m_submitted, m_submitted * per_frame);
+	json += fmt::format("  \"culled\": {{ \"total\": {}, \"per_frame\": {:.2f} }},\n", m_culled, m_culled * per_frame);
+	json += fmt::format("  \"occluded\": {{ \"total\": {}, \"per_frame\": {:.2f} }},\n", m_occluded, m_occluded * per_frame);
+	json += fmt::format("  \"state_changes_per_frame\": {{ \"program\": {:.2f}, \"texture\": {:.2f}, \"vao\": {:.2f}, \"avoided\": {:.2f} }},\n",
+		m_program_switches * per_frame, m_texture_binds * per_frame, m_vao_switches * per_frame, m_binds_avoided * per_frame);
+	json += fmt::format("  \"ring_stalls\": {},\n", m_ring_stalls);
+	json += fmt::format("  \"allocations\": {{ \"total\": {}, \"steady_state\": {}, \"steady_frames\": {}, \"allocating_frames\": {} }}\n",
+		m_allocations, m_steady_allocations, m_steady_frames, m_allocating_frames);
+	json += "}\n";
+	return json;
+}
+
+auto BenchmarkReport::write(const std::string& path, const Info& info) const -> bool
+{
+	const auto json = to_json(info);
+	std::ofstream out(path, std::ios::trunc);
+	if (!out || !out.write(json.data(), static_cast<std::streamsize>(json.size())))
+	{
+		spdlog::error("Failed to write benchmark report {}", path);
+		return false;
+	}
+	spdlog::info("Wrote benchmark report for {} frames to {}", m_frame_ms.size(), path);
+	return true;
+}
@@ -1,12 +1,25 @@
 #include "callbacks.h"
 
-#include <string>
+#include <atomic>
+#include <cstdint>
 #include <glad/glad.h>
+#include "gl_debug.h"
 
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
+namespace
 {
-	static bool draw_filled = true;
 
+// Bits of s_pending, set by the callbacks and taken by apply_window_events
+constexpr uint32_t toggle_polygon_mode = 1;
+constexpr uint32_t toggle_debug_sync = 2;
+constexpr uint32_t resize = 4;
+
+std::atomic<uint32_t> s_pending{ 0 };
+std::atomic<uint64_t> s_framebuffer_size{ 0 }; // Width in the high half, height in the low
+
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
+{
     if (action == GLFW_PRESS)
     spdlog::info("GLFW key press = {}", key);
 	if (key == GLFW_KEY_ESCAPE)
@@ -15,133 +28,43 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 	else if (key == GLFW_KEY_W)
 	{
-		if (draw_filled)
-		{
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			draw_filled = false;
-		}
-		else
-		{
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			draw_filled = true;
-		}
+		s_pending.fetch_xor(toggle_polygon_mode, std::memory_order_release);
+	}
+	else if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+	{
+		// Drop synchronous debug output once a capture is done, and back
+		s_pending.fetch_xor(toggle_debug_sync, std::memory_order_release);
 	}
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+	s_framebuffer_size.store((uint64_t(uint32_t(width)) << 32) | uint32_t(height), std::memory_order_relaxed);
+	s_pending.fetch_or(resize, std::memory_order_release);
 }
 
-void debug_msg_callback(
-	GLenum source,
-	GLenum type,
-	GLuint id,
-	GLenum severity,
-	GLsizei length,
-	const GLchar *message,
-	const void *userParam)
+void apply_window_events()
 {
-	std::string _source;
-	std::string _type;
-	std::string _severity;
+	static bool draw_filled = true;
 
-	switch (source)
-	{
-	case GL_DEBUG_SOURCE_API:
-		_source = "API";
-		break;
-	case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
-		_source = "WINDOW SYSTEM";
-		break;
-	case GL_DEBUG_SOURCE_SHADER_COMPILER:
-		_source = "SHADER COMPILER";
-		break;
-	case GL_DEBUG_SOURCE_THIRD_PARTY:
-		_source = "THIRD PARTY";
-		break;
-	case GL_DEBUG_SOURCE_APPLICATION:
-		_source = "APPLICATION";
-		break;
-	case GL_DEBUG_SOURCE_OTHER:
-		_source = "UNKNOWN";
-		break;
-	default:
-		_source = "UNKNOWN";
-		break;
-	}
+	const uint32_t pending = s_pending.exchange(0, std::memory_order_acquire);
+	if (pending == 0)
+		return;
 
-	switch (type)
+	if (pending & toggle_polygon_mode)
 	{
-	case GL_DEBUG_TYPE_ERROR:
-		_type = "ERROR";
-		break;
-
-	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-		_type = "DEPRECATED BEHAVIOR";
-		break;
-
-	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-		_type = "UDEFINED BEHAVIOR";
-		break;
-
-	case GL_DEBUG_TYPE_PORTABILITY:
-		_type = "PORTABILITY";
-		break;
-
-	case GL_DEBUG_TYPE_PERFORMANCE:
-		_type = "PERFORMANCE";
-		break;
-
-	case GL_DEBUG_TYPE_OTHER:
-		_type = "OTHER";
-		break;
-
-	case GL_DEBUG_TYPE_MARKER:
-		_type = "MARKER";
-		break;
-
-	default:
-		_type = "UNKNOWN";
-		break;
+		draw_filled = !draw_filled;
+		glPolygonMode(GL_FRONT_AND_BACK, draw_filled ? GL_FILL : GL_LINE);
 	}
-
-	switch (severity)
+	if (pending & toggle_debug_sync)
 	{
-	case GL_DEBUG_SEVERITY_HIGH:
-		_severity = "HIGH";
-		break;
-	case GL_DEBUG_SEVERITY_MEDIUM:
-		_severity = "MEDIUM";
-		break;
-	case GL_DEBUG_SEVERITY_LOW:
-		_severity = "LOW";
-		break;
-	case GL_DEBUG_SEVERITY_NOTIFICATION:
-		_severity = "NOTIFICATION";
-		break;
-	default:
-		_severity = "UNKNOWN";
-		break;
+		const bool synchronous = !GlDebugOutput::synchronous();
+		GlDebugOutput::set_synchronous(synchronous);
+		spdlog::info("Debug output {}", synchronous ? "synchronous" : "asynchronous");
 	}
-
-	const auto msg = fmt::format("{}: {} {} {} \n\t{}\n", id, _source, _severity, _type, message);
-	switch (severity)
+	if (pending & resize)
 	{
-	case GL_DEBUG_SEVERITY_HIGH:
-		spdlog::error(msg);
-		break;
-	case GL_DEBUG_SEVERITY_MEDIUM:
-		spdlog::warn(msg);
-		break;
-	case GL_DEBUG_SEVERITY_LOW:
-		spdlog::warn(msg);
-		break;
-	case GL_DEBUG_SEVERITY_NOTIFICATION:
-		spdlog::info(msg);
-		break;
-	default:
-		spdlog::info(msg);
-		break;
+		const uint64_t size = s_framebuffer_size.load(std::memory_order_relaxed);
+		glViewport(0, 0, static_cast<GLsizei>(size >> 32), static_cast<GLsizei>(size & 0xffffffff));
 	}
 }
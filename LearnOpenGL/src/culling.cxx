@@ -0,0 +1,348 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <cassert>
+
+auto extract_frustum(const glm::mat4& m) -> Frustum
+{
+	// glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum{ {
+		row3 + row0, // Left
+		row3 - row0, // Right
+		row3 + row1, // Bottom
+		row3 - row1, // Top
+		row3 + row2, // Near
+		row3 - row2, // Far
+	} };
+
+	for (auto& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+enum class Containment
+{
+	Outside,
+	Intersecting,
+	Inside,
+};
+
+static auto classify(const Frustum& frustum, const Aabb& box) noexcept -> Containment
+{
+	auto result = Containment::Inside;
+	for (const auto& plane : frustum.planes)
+	{
+		// Corner furthest along the plane normal, and the one furthest against it
+		const glm::vec3 p(
+			plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		const glm::vec3 n(
+			plane.x >= 0.0f ? box.min.x : box.max.x,
+			plane.y >= 0.0f ? box.min.y : box.max.y,
+			plane.z >= 0.0f ? box.min.z : box.max.z);
+
+		if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+			return Containment::Outside;
+		if (glm::dot(glm::vec3(plane), n) + plane.w < 0.0f)
+			result = Containment::Intersecting;
+	}
+	return result;
+}
+
+auto intersects(const Frustum& frustum, const Aabb& box) noexcept -> bool
+{
+	return classify(frustum, box) != Containment::Outside;
+}
+
+static void world_bounds_range(const TransformSoA& t, const Aabb& local, size_t begin, size_t end, Aabb* out)
+{
+	const glm::vec3 local_center = (local.min + local.max) * 0.5f;
+	const glm::vec3 local_half = (local.max - local.min) * 0.5f;
+
+	for (size_t i = begin; i < end; i++)
+	{
+		// Same rotation as glm::rotate, the box is re-fitted around the rotated
+		// extents: half'[r] = sum_c |R[c][r]| * half[c]
+		const float_t c = std::cos(t.angle[i]);
+		const float_t s = std::sin(t.angle[i]);
+		const float_t k = 1.0f - c;
+		const glm::vec3 a(t.axis_x[i], t.axis_y[i], t.axis_z[i]);
+
+		const glm::mat3 r(
+			c + k * a.x * a.x, k * a.x * a.y + s * a.z, k * a.x * a.z - s * a.y,
+			k * a.y * a.x - s * a.z, c + k * a.y * a.y, k * a.y * a.z + s * a.x,
+			k * a.z * a.x + s * a.y, k * a.z * a.y - s * a.x, c + k * a.z * a.z);
+
+		const glm::mat3 abs_r(glm::abs(r[0]), glm::abs(r[1]), glm::abs(r[2]));
+		const glm::vec3 center = glm::vec3(t.pos_x[i], t.pos_y[i], t.pos_z[i]) + r * local_center * t.scale[i];
+		const glm::vec3 half = abs_r * local_half * t.scale[i];
+
+		out[i] = { center - half, center + half };
+	}
+}
+
+void compute_world_bounds(const TransformSoA& t, const Aabb& local, std::vector<Aabb>& out)
+{
+	out.resize(t.size());
+	world_bounds_range(t, local, 0, t.size(), out.data());
+}
+
+void compute_world_bounds(JobSystem& jobs, const TransformSoA& t, const Aabb& local, std::vector<Aabb>& out)
+{
+	out.resize(t.size());
+	jobs.parallel_for(static_cast<uint32_t>(t.size()), parallel_grain, [&](uint32_t begin, uint32_t end) {
+		world_bounds_range(t, local, begin, end, out.data());
+	});
+}
+
+static auto merge(const Aabb& a, const Aabb& b) noexcept -> Aabb
+{
+	return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+void Bvh::build(const std::vector<Aabb>& bounds)
+{
+	const auto count = static_cast<uint32_t>(bounds.size());
+
+	m_nodes.clear();
+	m_nodes.reserve(count > 0 ? 2 * count : 1);
+	m_indices.resize(count);
+	m_centroids.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_indices[i] = i;
+		m_centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+	}
+
+	if (count == 0)
+		return;
+
+	build_node(0, count);
+	refit(bounds);
+	split_subtrees();
+}
+
+// Median split on the longest axis of the centroid bounds, bounds are filled in by refit
+auto Bvh::build_node(uint32_t begin, uint32_t end) -> uint32_t
+{
+	const auto index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back({ {}, begin, end - begin });
+
+	if (end - begin <= max_leaf_size)
+		return index;
+
+	glm::vec3 lo = m_centroids[m_indices[begin]];
+	glm::vec3 hi = lo;
+	for (uint32_t i = begin + 1; i < end; i++)
+	{
+		lo = glm::min(lo, m_centroids[m_indices[i]]);
+		hi = glm::max(hi, m_centroids[m_indices[i]]);
+	}
+
+	const glm::vec3 size = hi - lo;
+	int axis = 0;
+	if (size.y > size[axis]) axis = 1;
+	if (size.z > size[axis]) axis = 2;
+
+	const uint32_t mid = begin + (end - begin) / 2;
+	std::nth_element(m_indices.begin() + begin, m_indices.begin() + mid, m_indices.begin() + end,
+		[&](uint32_t a, uint32_t b) { return m_centroids[a][axis] < m_centroids[b][axis]; });
+
+	build_node(begin, mid);
+	const uint32_t right = build_node(mid, end);
+
+	m_nodes[index].first = right;
+	m_nodes[index].count = 0;
+	return index;
+}
+
+void Bvh::refit(const std::vector<Aabb>& bounds)
+{
+	assert(bounds.size() == m_indices.size());
+	refit_nodes(bounds, 0, static_cast<uint32_t>(m_nodes.size()));
+}
+
+void Bvh::refit(JobSystem& jobs, const std::vector<Aabb>& bounds)
+{
+	assert(bounds.size() == m_indices.size());
+	if (m_subtrees.size() <= 1 || jobs.thread_count() == 1)
+	{
+		refit(bounds);
+		return;
+	}
+
+	// Depth first, a subtree's nodes run from its root to its right most leaf
+	jobs.parallel_for(static_cast<uint32_t>(m_subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t s = begin; s < end; s++)
+		{
+			uint32_t last = m_subtrees[s];
+			while (m_nodes[last].count == 0)
+				last = m_nodes[last].first;
+			refit_nodes(bounds, m_subtrees[s], last + 1);
+		}
+	});
+
+	for (size_t i = m_top_nodes.size(); i-- > 0;)
+	{
+		auto& node = m_nodes[m_top_nodes[i]];
+		node.bounds = merge(m_nodes[m_top_nodes[i] + 1].bounds, m_nodes[node.first].bounds);
+	}
+}
+
+void Bvh::refit_nodes(const std::vector<Aabb>& bounds, uint32_t first, uint32_t end)
+{
+	// Children are stored after their parent so walking backwards visits them first
+	for (size_t n = end; n-- > first;)
+	{
+		auto& node = m_nodes[n];
+		if (node.count > 0)
+		{
+			Aabb box = bounds[m_indices[node.first]];
+			for (uint32_t i = 1; i < node.count; i++)
+				box = merge(box, bounds[m_indices[node.first + i]]);
+			node.bounds = box;
+		}
+		else
+		{
+			node.bounds = merge(m_nodes[n + 1].bounds, m_nodes[node.first].bounds);
+		}
+	}
+}
+
+// Splits the top of the tree into subtrees, enough to go around the threads a few times
+// and balanced by the median split. Depth first order keeps them left to right
+void Bvh::split_subtrees()
+{
+	constexpr size_t max_subtrees = 64;
+	constexpr size_t min_subtree_objects = 512;
+
+	m_subtrees.clear();
+	m_top_nodes.clear();
+	if (m_nodes.empty())
+		return;
+
+	m_subtrees.push_back(0);
+	auto& next = m_next_subtrees;
+	for (;;)
+	{
+		next.clear();
+		for (const uint32_t n : m_subtrees)
+		{
+			if (m_nodes[n].count == 0)
+			{
+				next.push_back(n + 1);
+				next.push_back(m_nodes[n].first);
+			}
+			else
+			{
+				next.push_back(n);
+			}
+		}
+		if (next.size() == m_subtrees.size() || next.size() > max_subtrees || m_indices.size() / next.size() < min_subtree_objects)
+			break;
+		for (const uint32_t n : m_subtrees)
+		{
+			if (m_nodes[n].count == 0)
+				m_top_nodes.push_back(n);
+		}
+		m_subtrees.swap(next);
+	}
+
+	// Each visible list can hold its whole subtree, so culling never grows them. A subtree's
+	// objects are contiguous in m_indices, from its left most leaf to its right most one
+	m_partial.resize(m_subtrees.size());
+	for (size_t s = 0; s < m_subtrees.size(); s++)
+	{
+		uint32_t left = m_subtrees[s];
+		while (m_nodes[left].count == 0)
+			left++;
+		uint32_t right = m_subtrees[s];
+		while (m_nodes[right].count == 0)
+			right = m_nodes[right].first;
+		m_partial[s].reserve(m_nodes[right].first + m_nodes[right].count - m_nodes[left].first);
+	}
+}
+
+void Bvh::cull(const Frustum& frustum, const std::vector<Aabb>& bounds, std::vector<uint32_t>& visible) const
+{
+	if (m_nodes.empty())
+		return;
+	cull_subtree(frustum, bounds, 0, visible);
+}
+
+void Bvh::cull(JobSystem& jobs, const Frustum& frustum, const std::vector<Aabb>& bounds, std::vector<uint32_t>& visible) const
+{
+	if (m_subtrees.size() <= 1 || jobs.thread_count() == 1)
+	{
+		cull(frustum, bounds, visible);
+		return;
+	}
+
+	// A subtree outside or inside the frustum is outside or inside whatever its ancestors were
+	jobs.parallel_for(static_cast<uint32_t>(m_subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t s = begin; s < end; s++)
+		{
+			m_partial[s].clear();
+			cull_subtree(frustum, bounds, m_subtrees[s], m_partial[s]);
+		}
+	});
+
+	for (const auto& partial : m_partial)
+		visible.insert(visible.end(), partial.begin(), partial.end());
+}
+
+void Bvh::cull_subtree(const Frustum& frustum, const std::vector<Aabb>& bounds, uint32_t root, std::vector<uint32_t>& visible) const
+{
+	// The median split keeps the depth around log2(n / max_leaf_size)
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = root;
+
+	while (top > 0)
+	{
+		const uint32_t n = stack[--top];
+		const auto& node = m_nodes[n];
+
+		const auto containment = classify(frustum, node.bounds);
+		if (containment == Containment::Outside)
+			continue;
+
+		if (containment == Containment::Inside)
+		{
+			// A subtree's objects are contiguous in m_indices, between its left and right most leaves
+			uint32_t left = n;
+			while (m_nodes[left].count == 0)
+				left = left + 1;
+			uint32_t right = n;
+			while (m_nodes[right].count == 0)
+				right = m_nodes[right].first;
+
+			visible.insert(visible.end(),
+				m_indices.begin() + m_nodes[left].first,
+				m_indices.begin() + m_nodes[right].first + m_nodes[right].count);
+		}
+		else if (node.count > 0)
+		{
+			for (uint32_t i = 0; i < node.count; i++)
+			{
+				const uint32_t object = m_indices[node.first + i];
+				if (intersects(frustum, bounds[object]))
+					visible.push_back(object);
+			}
+		}
+		else
+		{
+			stack[top++] = node.first;
+			stack[top++] = n + 1;
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#include "depth_pyramid.h"
+
+#include <algorithm>
+#include <bit>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include "gl_error.h"
+#include "gl_state.h"
+
+constexpr uint32_t workgroup_size = 8;
+
+// Internal format of a framebuffer's depth buffer, GL_NONE without one
+static auto depth_format(uint32_t framebuffer) -> GLenum
+{
+	const auto parameter = [framebuffer](GLenum attachment, GLenum name) {
+		GLint type = GL_NONE;
+		glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachment, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+		GLint value = 0;
+		if (type != GL_NONE)
+			glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachment, name, &value);
+		return value;
+	};
+
+	// The window's buffers have names of their own, an FBO's depth attachment has the stencil bits too
+	const GLenum depth = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+	const GLenum stencil = framebuffer == 0 ? GL_STENCIL : GL_DEPTH_ATTACHMENT;
+	const GLint depth_bits = parameter(depth, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE);
+	const bool floating = parameter(depth, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE) == GL_FLOAT;
+	const bool stenciled = parameter(stencil, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE) > 0;
+
+	if (depth_bits == 0)
+		return GL_NONE;
+	if (floating)
+		return stenciled ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+	if (stenciled)
+		return GL_DEPTH24_STENCIL8;
+	if (depth_bits == 16)
+		return GL_DEPTH_COMPONENT16;
+	return depth_bits == 32 ? GL_DEPTH_COMPONENT32 : GL_DEPTH_COMPONENT24;
+}
+
+DepthPyramid::DepthPyramid(const char* hiz_src)
+	: m_program(hiz_src)
+{
+	m_source_level = m_program.uniform("sourceLevel");
+	m_source_size = m_program.uniform("sourceSize");
+}
+
+void DepthPyramid::resize(uint32_t framebuffer, int32_t width, int32_t height)
+{
+	m_depth_format = depth_format(framebuffer);
+	if (m_depth_format == GL_NONE)
+		throw gl_error("The framebuffer has no depth buffer to build a depth pyramid from");
+
+	m_depth = Texture::create(GL_TEXTURE_2D);
+	m_depth.storage_2d(1, m_depth_format, width, height);
+	m_depth.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	m_depth.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	const bool stenciled = m_depth_format == GL_DEPTH24_STENCIL8 || m_depth_format == GL_DEPTH32F_STENCIL8;
+	m_depth_target = Framebuffer::create();
+	m_depth_target.attach(stenciled ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, m_depth);
+	if (m_depth_target.status() != GL_FRAMEBUFFER_COMPLETE)
+		throw gl_error(fmt::format("Depth pyramid copy target incomplete: 0x{:x}", m_depth_target.status()));
+
+	// Levels are sized like mips, rounding down. An odd row or column is folded into the
+	// texel next to it, see hiz.comp.glsl
+	const int32_t base_width = std::max(width / 2, 1);
+	const int32_t base_height = std::max(height / 2, 1);
+	m_levels = static_cast<uint32_t>(std::bit_width(static_cast<uint32_t>(std::max(base_width, base_height))));
+	m_pyramid = Texture::create(GL_TEXTURE_2D);
+	m_pyramid.storage_2d(static_cast<int32_t>(m_levels), GL_R32F, base_width, base_height);
+	m_pyramid.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	m_pyramid.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	m_width = width;
+	m_height = height;
+	m_valid = false;
+	spdlog::info("Depth pyramid {}x{} with {} levels", base_width, base_height, m_levels);
+}
+
+void DepthPyramid::build(uint32_t framebuffer, const glm::mat4& view_proj)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const int32_t width = viewport[2];
+	const int32_t height = viewport[3];
+	if (width < 2 || height < 2)
+	{
+		m_valid = false;
+		return;
+	}
+	if (width != m_width || height != m_height)
+		resize(framebuffer, width, height);
+
+	glBlitNamedFramebuffer(framebuffer, m_depth_target.id(),
+		viewport[0], viewport[1], viewport[0] + width, viewport[1] + height, 0, 0, width, height,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	// One dispatch per level, each reading the one before it (the depth copy for level 0)
+	m_program.use();
+	glm::ivec2 source_size(width, height);
+	for (uint32_t level = 0; level < m_levels; level++)
+	{
+		gl_state.bind_texture_unit(texture_unit, level == 0 ? m_depth.id() : m_pyramid.id());
+		m_program.set(m_source_level, static_cast<int32_t>(level == 0 ? 0 : level - 1));
+		m_program.set(m_source_size, source_size);
+
+		const glm::ivec2 size = glm::max(source_size / 2, glm::ivec2(1));
+		glBindImageTexture(0, m_pyramid.id(), static_cast<GLint>(level), GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((size.x + workgroup_size - 1) / workgroup_size, (size.y + workgroup_size - 1) / workgroup_size, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		source_size = size;
+	}
+
+	m_view_proj = view_proj;
+	m_valid = true;
+}
+
+void DepthPyramid::bind() const noexcept
+{
+	gl_state.bind_texture_unit(texture_unit, m_pyramid.id());
+}
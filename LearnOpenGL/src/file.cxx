@@ -1,35 +1,118 @@
 #include "file.h"
 
-#include <fstream>
-#include <sstream>
-#include <spdlog/spdlog.h>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
 
-std::string read_file(const char* file_path)
+namespace fs = std::filesystem;
+
+namespace
+{
+
+struct FileCloser
+{
+	void operator()(std::FILE* file) const noexcept { std::fclose(file); }
+};
+using FileHandle = std::unique_ptr<std::FILE, FileCloser>;
+
+auto last_error() -> std::error_code
+{
+	return { errno != 0 ? errno : EIO, std::generic_category() };
+}
+
+}
+
+auto map_file(const fs::path& path, std::error_code& ec) -> FileView
 {
-	std::ifstream file(file_path);
-	std::stringstream buffer;
-	if (file.is_open())
+	const auto size = fs::file_size(path, ec);
+	if (ec)
+		return {};
+	if (size == 0)
+		return {};
+
+	if (size >= map_threshold)
 	{
-		std::string line;
-		while (std::getline(file, line))
-		{
-			buffer << line << '\n';
-		}
-		file.close();
+		MappedFile mapping;
+		if (mapping.open(path.string().c_str()))
+			return FileView(std::move(mapping));
 	}
-	else {
-		spdlog::error("Failed to open file {}", file_path);
-		exit(EXIT_FAILURE);
+
+	// Small, or the mapping failed (e.g. a pipe or a special file)
+	auto buffer = read_file(path, ec);
+	if (ec)
+		return {};
+	return FileView(std::move(buffer));
+}
+
+auto read_file(const fs::path& path, std::error_code& ec) -> std::string
+{
+	const auto size = fs::file_size(path, ec);
+	if (ec)
+		return {};
+
+	errno = 0;
+	FileHandle file(std::fopen(path.string().c_str(), "rb"));
+	if (!file)
+	{
+		ec = last_error();
+		return {};
 	}
 
-	return buffer.str();
+	std::string buffer(static_cast<size_t>(size), '\0');
+	const size_t read = std::fread(buffer.data(), 1, buffer.size(), file.get());
+	if (read < buffer.size())
+	{
+		if (std::ferror(file.get()))
+		{
+			ec = last_error();
+			return {};
+		}
+		// Shrank since the size was taken
+		buffer.resize(read);
+	}
+	ec.clear();
+	return buffer;
 }
 
-void write_file(const char* file_name, const char* content)
+auto write_file(const fs::path& path, std::string_view content, std::error_code& ec) -> bool
 {
-	std::ofstream file(file_name, std::ofstream::out | std::ofstream::trunc);
+	// Rewriting identical bytes would only wake up file watchers
+	std::error_code existing_ec;
+	if (fs::file_size(path, existing_ec) == content.size() && !existing_ec)
+	{
+		const auto existing = map_file(path, existing_ec);
+		if (!existing_ec && existing.view() == content)
+		{
+			ec.clear();
+			return true;
+		}
+	}
 
-	file << content;
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		errno = 0;
+		FileHandle file(std::fopen(temp_path.string().c_str(), "wb"));
+		if (!file)
+		{
+			ec = last_error();
+			return false;
+		}
 
-	file.close();
+		if (std::fwrite(content.data(), 1, content.size(), file.get()) != content.size() || std::fflush(file.get()) != 0)
+		{
+			ec = last_error();
+			file.reset();
+			fs::remove(temp_path, existing_ec);
+			return false;
+		}
+	}
+
+	fs::rename(temp_path, path, ec);
+	if (ec)
+	{
+		fs::remove(temp_path, existing_ec);
+		return false;
+	}
+	return true;
 }
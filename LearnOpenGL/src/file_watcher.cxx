@@ -0,0 +1,117 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#if defined(__linux__)
+
+FileWatcher::FileWatcher(const fs::path& directory)
+	: m_directory(directory)
+{
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_fd < 0)
+	{
+		spdlog::warn("inotify unavailable, not watching {}: {}", directory.string(), std::strerror(errno));
+		return;
+	}
+
+	// Editors that save through a temp file and rename show up as IN_MOVED_TO
+	if (inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+	{
+		spdlog::warn("Failed to watch {}: {}", directory.string(), std::strerror(errno));
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+FileWatcher::~FileWatcher() noexcept
+{
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+auto FileWatcher::poll() -> std::vector<fs::path>
+{
+	std::vector<fs::path> changed;
+	if (m_fd < 0)
+		return changed;
+
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		const ssize_t length = read(m_fd, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			if (event->len > 0 && !(event->mask & IN_ISDIR))
+			{
+				auto path = m_directory / event->name;
+				if (std::find(changed.begin(), changed.end(), path) == changed.end())
+					changed.push_back(std::move(path));
+			}
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+		}
+	}
+	return changed;
+}
+
+#else
+
+constexpr auto scan_interval = std::chrono::milliseconds(250);
+
+FileWatcher::FileWatcher(const fs::path& directory)
+	: m_directory(directory)
+{
+	scan(nullptr);
+}
+
+FileWatcher::~FileWatcher() noexcept = default;
+
+void FileWatcher::scan(std::vector<fs::path>* changed)
+{
+	std::error_code ec;
+	for (const auto& item : fs::directory_iterator(m_directory, ec))
+	{
+		if (!item.is_regular_file(ec))
+			continue;
+
+		const auto time = item.last_write_time(ec);
+		if (ec)
+			continue;
+
+		auto [it, inserted] = m_times.try_emplace(item.path(), time);
+		if (!inserted && it->second != time)
+		{
+			it->second = time;
+			if (changed)
+				changed->push_back(item.path());
+		}
+		else if (inserted && changed)
+		{
+			changed->push_back(item.path());
+		}
+	}
+	m_next_scan = std::chrono::steady_clock::now() + scan_interval;
+}
+
+auto FileWatcher::poll() -> std::vector<fs::path>
+{
+	std::vector<fs::path> changed;
+	if (std::chrono::steady_clock::now() >= m_next_scan)
+		scan(&changed);
+	return changed;
+}
+
+#endif
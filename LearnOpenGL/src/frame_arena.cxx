@@ -0,0 +1,43 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <bit>
+#include <spdlog/spdlog.h>
+
+FrameArena::FrameArena(size_t capacity)
+	: m_block(new std::byte[capacity]), m_capacity(capacity)
+{
+}
+
+auto FrameArena::do_allocate(size_t bytes, size_t alignment) -> void*
+{
+	const auto base = reinterpret_cast<uintptr_t>(m_block.get());
+	const uintptr_t aligned = (base + m_used + alignment - 1) & ~(uintptr_t(alignment) - 1);
+	const size_t end = aligned - base + bytes;
+	if (end <= m_capacity)
+	{
+		m_used = end;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	// Spilled allocations are rare, worst case alignment padding keeps the math simple
+	auto& spill = m_spills.emplace_back(new std::byte[bytes + alignment]);
+	m_spilled_bytes += bytes + alignment;
+	const auto spill_base = reinterpret_cast<uintptr_t>(spill.get());
+	return reinterpret_cast<void*>((spill_base + alignment - 1) & ~(uintptr_t(alignment) - 1));
+}
+
+void FrameArena::reset()
+{
+	m_peak = std::max(m_peak, used());
+	if (!m_spills.empty())
+	{
+		// Sized for the whole frame, the next one like it fits without spilling
+		m_capacity = std::bit_ceil(used());
+		m_block.reset(new std::byte[m_capacity]);
+		m_spills.clear();
+		m_spilled_bytes = 0;
+		spdlog::info("Frame arena grew to {} KiB", m_capacity / 1024);
+	}
+	m_used = 0;
+}
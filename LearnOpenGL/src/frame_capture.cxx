@@ -0,0 +1,227 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include "gl_error.h"
+#include "gl_state.h"
+
+FrameCapture::FrameCapture(JobSystem& jobs, const Settings& settings)
+	: m_jobs(jobs), m_settings(settings)
+{
+	m_settings.every = std::max(m_settings.every, 1u);
+	m_settings.ring_size = std::max(m_settings.ring_size, 1u);
+	m_slots.reset(new Slot[m_settings.ring_size]);
+	for (uint32_t i = 0; i < m_settings.ring_size; i++)
+		m_slots[i].owner = this;
+}
+
+FrameCapture::~FrameCapture()
+{
+	for (uint32_t i = 0; i < m_settings.ring_size; i++)
+	{
+		auto& slot = m_slots[i];
+		wait(slot);
+		if (slot.pixels)
+			slot.buffer.unmap();
+	}
+
+	const auto stats = this->stats();
+	if (stats.captured == 0 && stats.dropped == 0)
+		return;
+	spdlog::info("Captured {} frames to {} ({} written, {} dropped, {} failed, {:.1f} MiB), {:.2f} ms per frame on the workers",
+		stats.captured, m_settings.directory, stats.written, stats.dropped, stats.failed, stats.bytes / (1024.0 * 1024.0),
+		stats.written > 0 ? stats.encode_ms / stats.written : 0.0);
+}
+
+void FrameCapture::encode(Slot& slot)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const bool png = m_settings.format == Format::Png;
+
+	// Formatted into the stack, nothing here allocates once the encoder has its buffers
+	char path[512];
+	char temp_path[520];
+	const auto name = fmt::format_to_n(path, sizeof(path) - 1, "{}/frame_{:06}.{}", m_settings.directory, slot.frame, png ? "png" : "rgba");
+	*name.out = '\0';
+	const auto temp = fmt::format_to_n(temp_path, sizeof(temp_path) - 1, "{}.tmp", path);
+	*temp.out = '\0';
+
+	// GL reads bottom up, files are top down: start at the last row and step backwards.
+	// Alpha is whatever blending left behind, both formats write the frame opaque
+	const size_t stride = size_t(slot.width) * 4;
+	const uint8_t* top = slot.pixels + stride * (slot.height - 1);
+
+	size_t bytes = 0;
+	std::FILE* file = std::fopen(temp_path, "wb");
+	bool ok = file != nullptr;
+	if (ok && png)
+	{
+		const auto encoded = slot.encoder.encode(top, slot.width, slot.height, -static_cast<ptrdiff_t>(stride), true);
+		ok = std::fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+		bytes = encoded.size();
+	}
+	else if (ok)
+	{
+		for (int32_t y = 0; y < slot.height && ok; y++)
+		{
+			std::memcpy(slot.row.get(), top - y * stride, stride);
+			for (size_t x = 3; x < stride; x += 4)
+				slot.row[x] = 0xff;
+			ok = std::fwrite(slot.row.get(), 1, stride, file) == stride;
+		}
+		bytes = stride * slot.height;
+	}
+	if (file)
+		ok = std::fclose(file) == 0 && ok;
+
+	// Renamed over the last run's frame, so a reader never sees half a file
+	if (ok)
+	{
+		std::remove(path);
+		ok = std::rename(temp_path, path) == 0;
+	}
+	if (ok)
+	{
+		m_written.fetch_add(1, std::memory_order_relaxed);
+		m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+	else
+	{
+		std::remove(temp_path);
+		if (m_failed.fetch_add(1, std::memory_order_relaxed) == 0)
+			spdlog::error("Failed to write capture {}", path);
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	m_encode_ns.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+	slot.state.store(SlotState::Free, std::memory_order_release);
+}
+
+void FrameCapture::resize(Slot& slot, int32_t width, int32_t height)
+{
+	// Grows with the window, and stays mapped for the worker to read from
+	const size_t size = size_t(width) * height * 4;
+	if (slot.pixels)
+		slot.buffer.unmap();
+	constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	slot.buffer = Buffer::create(size, nullptr, flags);
+	slot.pixels = static_cast<const uint8_t*>(slot.buffer.map_range(0, size, flags));
+	if (!slot.pixels)
+		throw gl_error(fmt::format("Failed to map a {} byte capture buffer", size));
+	slot.capacity = size;
+
+	// The worker's buffers too, sized here rather than on the slot's first encode
+	if (m_settings.format == Format::Png)
+	{
+		slot.encoder.reserve(width, height);
+	}
+	else if (slot.row_capacity < size_t(width) * 4)
+	{
+		slot.row_capacity = size_t(width) * 4;
+		slot.row.reset(new uint8_t[slot.row_capacity]);
+	}
+}
+
+void FrameCapture::dispatch(Slot& slot)
+{
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	slot.state.store(SlotState::Encoding, std::memory_order_relaxed);
+
+	const JobSystem::Function encode_job = [](void* data, uint32_t, uint32_t) {
+		auto& slot = *static_cast<Slot*>(data);
+		slot.owner->encode(slot);
+	};
+	m_jobs.run(encode_job, &slot, 0, 1, &slot.encoded);
+}
+
+void FrameCapture::wait(Slot& slot)
+{
+	if (slot.state.load(std::memory_order_acquire) == SlotState::Reading)
+	{
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+		dispatch(slot);
+	}
+	m_jobs.wait(slot.encoded);
+}
+
+void FrameCapture::update()
+{
+	for (uint32_t i = 0; i < m_settings.ring_size; i++)
+	{
+		auto& slot = m_slots[i];
+		if (slot.state.load(std::memory_order_relaxed) != SlotState::Reading)
+			continue;
+
+		const GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			dispatch(slot);
+	}
+}
+
+void FrameCapture::capture()
+{
+	const uint32_t frame = m_frame++;
+	if (frame % m_settings.every != 0)
+		return;
+
+	auto& slot = m_slots[m_next];
+	if (slot.state.load(std::memory_order_acquire) != SlotState::Free)
+	{
+		if (!m_settings.wait_when_busy)
+		{
+			m_dropped++;
+			return;
+		}
+		wait(slot);
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const size_t size = size_t(viewport[2]) * viewport[3] * 4;
+	if (size == 0)
+		return;
+
+	// A new size resizes every free slot at once, so the first capture (or the first after
+	// the window grew) allocates for the whole ring rather than each slot on its first use
+	if (size > slot.capacity)
+	{
+		for (uint32_t i = 0; i < m_settings.ring_size; i++)
+		{
+			auto& other = m_slots[i];
+			if (other.capacity < size && other.state.load(std::memory_order_acquire) == SlotState::Free)
+				resize(other, viewport[2], viewport[3]);
+		}
+	}
+
+	// Into the buffer, so this only queues the copy
+	gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer.id());
+	glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3], GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = viewport[2];
+	slot.height = viewport[3];
+	slot.frame = frame;
+	slot.state.store(SlotState::Reading, std::memory_order_relaxed);
+	m_next = (m_next + 1) % m_settings.ring_size;
+	m_captured++;
+}
+
+auto FrameCapture::stats() const noexcept -> Stats
+{
+	Stats stats;
+	stats.captured = m_captured;
+	stats.dropped = m_dropped;
+	stats.written = m_written.load(std::memory_order_relaxed);
+	stats.failed = m_failed.load(std::memory_order_relaxed);
+	stats.bytes = m_bytes.load(std::memory_order_relaxed);
+	stats.encode_ms = m_encode_ns.load(std::memory_order_relaxed) / 1e6;
+	return stats;
+}
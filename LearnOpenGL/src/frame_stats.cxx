@@ -0,0 +1,56 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+FrameStatsReporter::FrameStatsReporter(const char* label, double interval_seconds)
+	: m_label(label), m_interval(interval_seconds)
+{
+	m_frame_start = clock::now();
+	m_report_start = m_frame_start;
+}
+
+void FrameStatsReporter::begin_frame() noexcept
+{
+	m_frame_start = clock::now();
+}
+
+void FrameStatsReporter::end_frame(const FrameStats& stats)
+{
+	const auto now = clock::now();
+	const double cpu_ms = std::chrono::duration<double, std::milli>(now - m_frame_start).count();
+
+	m_frames++;
+	m_cpu_total_ms += cpu_ms;
+	m_cpu_max_ms = std::max(m_cpu_max_ms, cpu_ms);
+	m_ring_stalls += stats.ring_stalls;
+	m_allocations += stats.allocations;
+	m_last = stats;
+
+	const double elapsed = std::chrono::duration<double>(now - m_report_start).count();
+	if (elapsed < m_interval)
+		return;
+
+	spdlog::info("[{}] {} submitted, {} culled, {} occluded, {} draw calls/frame ({} program, {} texture, {} vao changes, {} binds skipped), {} ring stalls, {} allocations, cpu frame avg {:.3f} ms max {:.3f} ms, {:.1f} fps",
+		m_label,
+		m_last.instances,
+		m_last.culled,
+		m_last.occluded,
+		m_last.draw_calls,
+		m_last.program_switches,
+		m_last.texture_binds,
+		m_last.vao_switches,
+		m_last.binds_avoided,
+		m_ring_stalls,
+		m_allocations,
+		m_cpu_total_ms / m_frames,
+		m_cpu_max_ms,
+		m_frames / elapsed);
+
+	m_frames = 0;
+	m_cpu_total_ms = 0.0;
+	m_cpu_max_ms = 0.0;
+	m_ring_stalls = 0;
+	m_allocations = 0;
+	m_report_start = now;
+}
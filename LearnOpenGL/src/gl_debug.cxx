@@ -0,0 +1,191 @@
+#include "gl_debug.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+static auto seconds_now() -> double
+{
+	using clock = std::chrono::steady_clock;
+	return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+GlDebugOutput::GlDebugOutput(const Settings& settings)
+	: m_settings(settings), m_queue(settings.queue_capacity), m_counters(std::make_unique<std::array<Counter, counter_slots>>())
+{
+	int32_t flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+	{
+		spdlog::info("Debug output disabled");
+		return;
+	}
+
+	// Formatting and writing happen on spdlog's worker, a full queue overwrites the oldest message
+	m_logger = spdlog::get("gl");
+	if (!m_logger)
+	{
+		if (!spdlog::thread_pool())
+			spdlog::init_thread_pool(8192, 1);
+		m_logger = std::make_shared<spdlog::async_logger>("gl", std::make_shared<spdlog::sinks::stdout_color_sink_mt>(),
+			spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
+		spdlog::register_logger(m_logger);
+	}
+
+	m_enabled = true;
+	m_last_summary = seconds_now();
+
+	glEnable(GL_DEBUG_OUTPUT);
+	set_synchronous(m_settings.synchronous);
+	glDebugMessageCallback(callback, this);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+
+	spdlog::info("Debug output enabled, {}, at most {} repeats per message every {} s",
+		m_settings.synchronous ? "synchronous" : "asynchronous", m_settings.repeats_per_interval, m_settings.summary_interval);
+}
+
+GlDebugOutput::~GlDebugOutput() noexcept
+{
+	if (!m_enabled)
+		return;
+
+	glDebugMessageCallback(nullptr, nullptr);
+	update();
+	log_summary();
+	spdlog::drop("gl");
+}
+
+void APIENTRY GlDebugOutput::callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar* message, const void* user)
+{
+	static_cast<GlDebugOutput*>(const_cast<void*>(user))->push(source, type, id, severity, length, message);
+}
+
+auto GlDebugOutput::counter(uint64_t key) noexcept -> Counter*
+{
+	auto& counters = *m_counters;
+	size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (counter_slots - 1);
+	for (size_t probe = 0; probe < counter_slots; probe++, slot = (slot + 1) & (counter_slots - 1))
+	{
+		auto& counter = counters[slot];
+		uint64_t current = counter.key.load(std::memory_order_acquire);
+		if (current == key)
+			return &counter;
+		if (current == 0)
+		{
+			if (counter.key.compare_exchange_strong(current, key, std::memory_order_acq_rel) || current == key)
+				return &counter;
+		}
+	}
+	return nullptr;
+}
+
+// May run on a driver thread once the output is asynchronous, so nothing here locks or allocates
+void GlDebugOutput::push(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message) noexcept
+{
+	// Source and type are both 16 bit enums, so the key is never 0
+	const uint64_t key = (uint64_t(source & 0xFFFF) << 48) | (uint64_t(type & 0xFFFF) << 32) | id;
+	if (auto* repeats = counter(key))
+	{
+		repeats->severity.store(severity, std::memory_order_relaxed);
+		if (repeats->interval_count.fetch_add(1, std::memory_order_relaxed) >= m_settings.repeats_per_interval)
+			return;
+	}
+	else
+	{
+		m_untracked.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Message entry;
+	entry.source = source;
+	entry.type = type;
+	entry.severity = severity;
+	entry.id = id;
+	const size_t size = length >= 0 ? static_cast<size_t>(length) : std::strlen(message);
+	entry.length = static_cast<uint32_t>(std::min(size, sizeof(entry.text)));
+	std::memcpy(entry.text, message, entry.length);
+
+	if (!m_queue.try_push(entry))
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+static auto severity_level(GLenum severity) -> spdlog::level::level_enum
+{
+	switch (severity)
+	{
+	case GL_DEBUG_SEVERITY_HIGH:
+		return spdlog::level::err;
+	case GL_DEBUG_SEVERITY_MEDIUM:
+	case GL_DEBUG_SEVERITY_LOW:
+		return spdlog::level::warn;
+	default:
+		return spdlog::level::info;
+	}
+}
+
+void GlDebugOutput::update()
+{
+	if (!m_enabled)
+		return;
+
+	Message entry;
+	while (m_queue.try_pop(entry))
+	{
+		// Drivers often end messages with a newline
+		std::string_view text(entry.text, entry.length);
+		while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+			text.remove_suffix(1);
+
+		m_logger->log(severity_level(entry.severity), "{}: {} {} {}\n\t{}", entry.id,
+			debug_source_name(entry.source), debug_severity_name(entry.severity), debug_type_name(entry.type), text);
+	}
+
+	if (seconds_now() - m_last_summary >= m_settings.summary_interval)
+		log_summary();
+}
+
+void GlDebugOutput::log_summary()
+{
+	const double now = seconds_now();
+	const double elapsed = now - m_last_summary;
+	m_last_summary = now;
+
+	for (auto& counter : *m_counters)
+	{
+		const uint64_t key = counter.key.load(std::memory_order_acquire);
+		if (key == 0)
+			continue;
+
+		const uint32_t count = counter.interval_count.exchange(0, std::memory_order_relaxed);
+		const uint64_t total = counter.total.fetch_add(count, std::memory_order_relaxed) + count;
+		if (count <= m_settings.repeats_per_interval)
+			continue;
+
+		const auto source = static_cast<GLenum>(key >> 48);
+		const auto type = static_cast<GLenum>((key >> 32) & 0xFFFF);
+		const auto severity = counter.severity.load(std::memory_order_relaxed);
+		m_logger->log(severity_level(severity), "{}: {} {} {} repeated {} times in {:.1f} s, {} suppressed ({} total)",
+			static_cast<GLuint>(key), debug_source_name(source), debug_severity_name(severity), debug_type_name(type),
+			count, elapsed, count - m_settings.repeats_per_interval, total);
+	}
+
+	const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+	const uint64_t untracked = m_untracked.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0 || untracked > 0)
+		m_logger->warn("{} debug messages dropped on a full queue, {} past the counter table", dropped, untracked);
+}
+
+void GlDebugOutput::set_synchronous(bool synchronous)
+{
+	if (synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
+
+auto GlDebugOutput::synchronous() -> bool
+{
+	return glIsEnabled(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
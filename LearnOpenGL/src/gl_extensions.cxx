@@ -0,0 +1,49 @@
+#include "gl_extensions.h"
+
+#include <cstdint>
+
+GlExtensions gl_extensions;
+
+auto has_gl_extension(std::string_view name) -> bool
+{
+	int32_t count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int32_t i = 0; i < count; i++)
+	{
+		const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+		if (extension && name == extension)
+			return true;
+	}
+	return false;
+}
+
+void load_gl_extensions(GLADloadproc load)
+{
+	gl_extensions = {};
+
+	using MaxShaderCompilerThreads = void (APIENTRY*)(GLuint);
+	if (has_gl_extension("GL_KHR_parallel_shader_compile"))
+		gl_extensions.max_shader_compiler_threads = reinterpret_cast<MaxShaderCompilerThreads>(load("glMaxShaderCompilerThreadsKHR"));
+	else if (has_gl_extension("GL_ARB_parallel_shader_compile"))
+		gl_extensions.max_shader_compiler_threads = reinterpret_cast<MaxShaderCompilerThreads>(load("glMaxShaderCompilerThreadsARB"));
+	gl_extensions.parallel_shader_compile = gl_extensions.max_shader_compiler_threads != nullptr;
+	// Once for the context, 0xffffffff lets the driver pick how many compiler threads it uses
+	if (gl_extensions.parallel_shader_compile)
+		gl_extensions.max_shader_compiler_threads(0xffffffff);
+
+	using MultiDrawElementsIndirectCount = void (APIENTRY*)(GLenum, GLenum, const void*, GLintptr, GLsizei, GLsizei);
+	if (has_gl_extension("GL_ARB_indirect_parameters"))
+		gl_extensions.multi_draw_elements_indirect_count = reinterpret_cast<MultiDrawElementsIndirectCount>(load("glMultiDrawElementsIndirectCountARB"));
+	gl_extensions.indirect_parameters = gl_extensions.multi_draw_elements_indirect_count != nullptr;
+
+	using GetTextureSamplerHandle = GLuint64 (APIENTRY*)(GLuint, GLuint);
+	using TextureHandleResidency = void (APIENTRY*)(GLuint64);
+	if (has_gl_extension("GL_ARB_bindless_texture"))
+	{
+		gl_extensions.get_texture_sampler_handle = reinterpret_cast<GetTextureSamplerHandle>(load("glGetTextureSamplerHandleARB"));
+		gl_extensions.make_texture_handle_resident = reinterpret_cast<TextureHandleResidency>(load("glMakeTextureHandleResidentARB"));
+		gl_extensions.make_texture_handle_non_resident = reinterpret_cast<TextureHandleResidency>(load("glMakeTextureHandleNonResidentARB"));
+	}
+	gl_extensions.bindless_texture = gl_extensions.get_texture_sampler_handle && gl_extensions.make_texture_handle_resident
+		&& gl_extensions.make_texture_handle_non_resident;
+}
@@ -0,0 +1,82 @@
+#include "gl_objects.h"
+
+#include "gl_state.h"
+
+void BufferTraits::destroy(uint32_t id) noexcept
+{
+	gl_state.forget_buffer(id);
+	glDeleteBuffers(1, &id);
+}
+
+void VertexArrayTraits::destroy(uint32_t id) noexcept
+{
+	gl_state.forget_vertex_array(id);
+	glDeleteVertexArrays(1, &id);
+}
+
+void TextureTraits::destroy(uint32_t id) noexcept
+{
+	gl_state.forget_texture(id);
+	glDeleteTextures(1, &id);
+}
+
+void SamplerTraits::destroy(uint32_t id) noexcept
+{
+	gl_state.forget_sampler(id);
+	glDeleteSamplers(1, &id);
+}
+
+void FramebufferTraits::destroy(uint32_t id) noexcept
+{
+	gl_state.forget_framebuffer(id);
+	glDeleteFramebuffers(1, &id);
+}
+
+void RenderbufferTraits::destroy(uint32_t id) noexcept
+{
+	glDeleteRenderbuffers(1, &id);
+}
+
+auto Buffer::create(size_t size, const void* data, GLbitfield flags) -> Buffer
+{
+	uint32_t id = 0;
+	glCreateBuffers(1, &id);
+	glNamedBufferStorage(id, static_cast<GLsizeiptr>(size), data, flags);
+	return Buffer(id);
+}
+
+auto VertexArray::create() -> VertexArray
+{
+	uint32_t id = 0;
+	glCreateVertexArrays(1, &id);
+	return VertexArray(id);
+}
+
+auto Texture::create(GLenum target) -> Texture
+{
+	uint32_t id = 0;
+	glCreateTextures(target, 1, &id);
+	return Texture(id);
+}
+
+auto Sampler::create() -> Sampler
+{
+	uint32_t id = 0;
+	glCreateSamplers(1, &id);
+	return Sampler(id);
+}
+
+auto Renderbuffer::create(GLenum internal_format, int32_t width, int32_t height) -> Renderbuffer
+{
+	uint32_t id = 0;
+	glCreateRenderbuffers(1, &id);
+	glNamedRenderbufferStorage(id, internal_format, width, height);
+	return Renderbuffer(id);
+}
+
+auto Framebuffer::create() -> Framebuffer
+{
+	uint32_t id = 0;
+	glCreateFramebuffers(1, &id);
+	return Framebuffer(id);
+}
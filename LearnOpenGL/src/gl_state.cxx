@@ -0,0 +1,149 @@
+#include "gl_state.h"
+
+#include <algorithm>
+
+GlStateCache gl_state;
+
+GlStateCache::GlStateCache() noexcept
+{
+	invalidate();
+}
+
+auto GlStateCache::update(uint32_t& bound, uint32_t id) noexcept -> bool
+{
+	if (bound == id)
+	{
+		m_stats.avoided++;
+		return false;
+	}
+	bound = id;
+	m_stats.binds++;
+	return true;
+}
+
+auto GlStateCache::use_program(uint32_t program) noexcept -> bool
+{
+	if (!update(m_program, program))
+		return false;
+	glUseProgram(program);
+	return true;
+}
+
+auto GlStateCache::bind_vertex_array(uint32_t vertex_array) noexcept -> bool
+{
+	if (!update(m_vertex_array, vertex_array))
+		return false;
+	glBindVertexArray(vertex_array);
+	return true;
+}
+
+auto GlStateCache::bind_texture_unit(uint32_t unit, uint32_t texture) noexcept -> bool
+{
+	if (unit >= max_texture_units)
+	{
+		glBindTextureUnit(unit, texture);
+		m_stats.binds++;
+		return true;
+	}
+	if (!update(m_textures[unit], texture))
+		return false;
+	glBindTextureUnit(unit, texture);
+	return true;
+}
+
+auto GlStateCache::bind_sampler(uint32_t unit, uint32_t sampler) noexcept -> bool
+{
+	if (unit >= max_texture_units)
+	{
+		glBindSampler(unit, sampler);
+		m_stats.binds++;
+		return true;
+	}
+	if (!update(m_samplers[unit], sampler))
+		return false;
+	glBindSampler(unit, sampler);
+	return true;
+}
+
+auto GlStateCache::bind_framebuffer(GLenum target, uint32_t framebuffer) noexcept -> bool
+{
+	if (target == GL_FRAMEBUFFER)
+	{
+		if (m_draw_framebuffer == framebuffer && m_read_framebuffer == framebuffer)
+		{
+			m_stats.avoided++;
+			return false;
+		}
+		m_draw_framebuffer = framebuffer;
+		m_read_framebuffer = framebuffer;
+		m_stats.binds++;
+	}
+	else if (!update(target == GL_READ_FRAMEBUFFER ? m_read_framebuffer : m_draw_framebuffer, framebuffer))
+	{
+		return false;
+	}
+	glBindFramebuffer(target, framebuffer);
+	return true;
+}
+
+auto GlStateCache::bind_buffer(GLenum target, uint32_t buffer) noexcept -> bool
+{
+	const auto it = std::find(buffer_targets.begin(), buffer_targets.end(), target);
+	if (it == buffer_targets.end())
+	{
+		glBindBuffer(target, buffer);
+		m_stats.binds++;
+		return true;
+	}
+	if (!update(m_buffers[static_cast<size_t>(it - buffer_targets.begin())], buffer))
+		return false;
+	glBindBuffer(target, buffer);
+	return true;
+}
+
+void GlStateCache::forget_program(uint32_t program) noexcept
+{
+	// A program in use is only flagged for deletion, rebinding whatever comes next is enough
+	if (m_program == program)
+		m_program = unknown;
+}
+
+void GlStateCache::forget_vertex_array(uint32_t vertex_array) noexcept
+{
+	if (m_vertex_array == vertex_array)
+		m_vertex_array = 0;
+}
+
+void GlStateCache::forget_texture(uint32_t texture) noexcept
+{
+	std::replace(m_textures.begin(), m_textures.end(), texture, 0u);
+}
+
+void GlStateCache::forget_sampler(uint32_t sampler) noexcept
+{
+	std::replace(m_samplers.begin(), m_samplers.end(), sampler, 0u);
+}
+
+void GlStateCache::forget_framebuffer(uint32_t framebuffer) noexcept
+{
+	if (m_draw_framebuffer == framebuffer)
+		m_draw_framebuffer = 0;
+	if (m_read_framebuffer == framebuffer)
+		m_read_framebuffer = 0;
+}
+
+void GlStateCache::forget_buffer(uint32_t buffer) noexcept
+{
+	std::replace(m_buffers.begin(), m_buffers.end(), buffer, 0u);
+}
+
+void GlStateCache::invalidate() noexcept
+{
+	m_program = unknown;
+	m_vertex_array = unknown;
+	m_draw_framebuffer = unknown;
+	m_read_framebuffer = unknown;
+	m_textures.fill(unknown);
+	m_samplers.fill(unknown);
+	m_buffers.fill(unknown);
+}
@@ -0,0 +1,149 @@
+#include "gpu_culler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <fmt/core.h>
+#include "gl_error.h"
+
+GpuCuller::GpuCuller(const char* cull_src, const TransformSoA& transforms, const std::vector<Aabb>& bounds,
+	uint32_t material_count, uint32_t index_count)
+	: m_program(cull_src),
+	m_object_count(static_cast<uint32_t>(transforms.size())),
+	m_material_count(std::max(material_count, 1u)),
+	m_visible_count(m_object_count)
+{
+	assert(bounds.size() == transforms.size());
+
+	std::vector<float_t> models(size_t(m_object_count) * 16);
+	build_model_matrices(transforms, models.data());
+	m_models = Buffer::create(sizeof(float_t) * models.size(), models.data());
+
+	// Spheres take half the memory of boxes and one dot product per plane
+	std::vector<glm::vec4> spheres;
+	spheres.reserve(bounds.size());
+	for (const auto& box : bounds)
+		spheres.emplace_back((box.min + box.max) * 0.5f, glm::length(box.max - box.min) * 0.5f);
+	m_bounds = Buffer::create(sizeof(glm::vec4) * spheres.size(), spheres.data());
+
+	// Every material gets room for all of its objects, so the pass never runs out of slots
+	const uint32_t per_material = (m_object_count + m_material_count - 1) / m_material_count;
+	m_visible = Buffer::create(sizeof(uint32_t) * per_material * m_material_count);
+
+	std::vector<Command> commands(m_material_count);
+	for (uint32_t m = 0; m < m_material_count; m++)
+		commands[m] = { index_count, 0, 0, 0, m * per_material };
+	const size_t command_bytes = sizeof(Command) * m_material_count;
+	m_reset_commands = Buffer::create(command_bytes, commands.data());
+	m_commands = Buffer::create(command_bytes);
+	m_draw_counts = Buffer::create(sizeof(uint32_t) * m_material_count);
+	m_occluded = Buffer::create(sizeof(uint32_t));
+
+	constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const size_t readback_bytes = (command_bytes + sizeof(uint32_t)) * readback_frames;
+	m_readback = Buffer::create(readback_bytes, nullptr, flags);
+	m_readback_data = static_cast<const Command*>(m_readback.map_range(0, readback_bytes, flags));
+	if (!m_readback_data)
+		throw gl_error(fmt::format("Failed to map a {} byte readback buffer", readback_bytes));
+}
+
+GpuCuller::~GpuCuller() noexcept
+{
+	for (auto fence : m_fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+
+	if (m_readback_data)
+		m_readback.unmap();
+}
+
+void GpuCuller::attach(const VertexArray& vao, uint32_t attrib, uint32_t binding) const noexcept
+{
+	vao.vertex_buffer(binding, m_visible, 0, sizeof(uint32_t));
+	vao.attrib_i_format(attrib, binding, 1, GL_UNSIGNED_INT, 0);
+	// baseInstance offsets per instance attributes, so each command starts at its material's ids
+	vao.binding_divisor(binding, 1);
+}
+
+void GpuCuller::cull(StreamBuffer& ring, const Frustum& frustum, bool cull_enabled, const DepthPyramid* occlusion)
+{
+	m_frame = (m_frame + 1) % readback_frames;
+	const size_t command_bytes = sizeof(Command) * m_material_count;
+
+	// The slot is about to be reused, its counts are only taken if the gpu is done with it
+	auto& fence = m_fences[m_frame];
+	if (fence)
+	{
+		const GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			const Command* commands = m_readback_data + size_t(m_frame) * m_material_count;
+			uint32_t visible = 0;
+			for (uint32_t m = 0; m < m_material_count; m++)
+				visible += commands[m].instance_count;
+			m_visible_count = visible;
+			const auto* occluded = reinterpret_cast<const uint32_t*>(m_readback_data + size_t(readback_frames) * m_material_count);
+			m_occluded_count = occluded[m_frame];
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	glCopyNamedBufferSubData(m_reset_commands.id(), m_commands.id(), 0, 0, static_cast<GLsizeiptr>(command_bytes));
+	const uint32_t zero = 0;
+	glClearNamedBufferData(m_draw_counts.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glClearNamedBufferData(m_occluded.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	CullBlock block{};
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), block.planes);
+	block.object_count = m_object_count;
+	block.material_count = m_material_count;
+	block.cull_enabled = cull_enabled ? 1 : 0;
+	if (cull_enabled && occlusion && occlusion->valid())
+	{
+		block.occlusion_view_proj = occlusion->view_proj();
+		block.occlusion_enabled = 1;
+		block.depth_size = occlusion->size();
+		block.pyramid_levels = static_cast<int32_t>(occlusion->levels());
+		occlusion->bind();
+	}
+	ring.bind(GL_UNIFORM_BUFFER, 2, ring.push(block));
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_bounds.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commands.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_draw_counts.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_visible.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, m_occluded.id());
+
+	m_program.use();
+	glDispatchCompute((m_object_count + workgroup_size - 1) / workgroup_size, 1, 1);
+
+	// Read next as draw arguments, a vertex attribute and the source of the readback copy
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_models.id());
+}
+
+void GpuCuller::end_frame()
+{
+	const size_t command_bytes = sizeof(Command) * m_material_count;
+	glCopyNamedBufferSubData(m_commands.id(), m_readback.id(), 0,
+		static_cast<GLintptr>(command_bytes * m_frame), static_cast<GLsizeiptr>(command_bytes));
+	const size_t occluded_offset = command_bytes * readback_frames + sizeof(uint32_t) * m_frame;
+	glCopyNamedBufferSubData(m_occluded.id(), m_readback.id(), 0,
+		static_cast<GLintptr>(occluded_offset), sizeof(uint32_t));
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+auto GpuCuller::indirect(uint32_t material) const noexcept -> RenderQueue::Indirect
+{
+	RenderQueue::Indirect indirect;
+	indirect.buffer = m_commands.id();
+	indirect.offset = sizeof(Command) * material;
+	indirect.draw_count = 1;
+	indirect.parameter_buffer = m_draw_counts.id();
+	indirect.parameter_offset = sizeof(uint32_t) * material;
+	return indirect;
+}
@@ -0,0 +1,191 @@
+#include "headless_context.h"
+
+#include <string_view>
+#include <glad/glad.h>
+#include <fmt/core.h>
+#include "gl_error.h"
+#include "gl_state.h"
+
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// Extension strings are space separated, a plain strstr would match prefixes
+static auto has_egl_extension(const char* extensions, std::string_view name) -> bool
+{
+	if (!extensions)
+		return false;
+
+	std::string_view list = extensions;
+	while (!list.empty())
+	{
+		const size_t end = list.find(' ');
+		if (list.substr(0, end) == name)
+			return true;
+		if (end == std::string_view::npos)
+			break;
+		list.remove_prefix(end + 1);
+	}
+	return false;
+}
+
+static auto egl_error_message(const char* what) -> std::string
+{
+	return fmt::format("{} (EGL error 0x{:x})", what, eglGetError());
+}
+
+HeadlessContext::HeadlessContext(int32_t width, int32_t height, bool debug)
+	: m_width(width), m_height(height)
+{
+	// Mesa's surfaceless platform needs neither X11/Wayland nor a DRM device
+	EGLDisplay display = EGL_NO_DISPLAY;
+	const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (has_egl_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+	{
+		const auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display)
+			display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+		throw gl_error(egl_error_message("Failed to initialize an EGL display"));
+	m_display = display;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+		throw gl_error(egl_error_message("EGL display has no desktop OpenGL"));
+
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+		throw gl_error(egl_error_message("No EGL config for desktop OpenGL"));
+
+	// Same version as the windowed path asks for, llvmpipe stops at 4.5
+	EGLContext context = EGL_NO_CONTEXT;
+	for (const EGLint minor : { 6, 5 })
+	{
+		const EGLint context_attributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, minor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+		if (context != EGL_NO_CONTEXT)
+			break;
+	}
+	if (context == EGL_NO_CONTEXT)
+		throw gl_error(egl_error_message("Failed to create a GL 4.5 core context"));
+	m_context = context;
+
+	// Everything is drawn into the FBO, the surface only exists to make the context current
+	EGLSurface surface = EGL_NO_SURFACE;
+	if (!has_egl_extension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+	{
+		const EGLint surface_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, surface_attributes);
+		if (surface == EGL_NO_SURFACE)
+			throw gl_error(egl_error_message("Failed to create an EGL pbuffer"));
+		m_surface = surface;
+	}
+
+	if (!eglMakeCurrent(display, surface, surface, context))
+		throw gl_error(egl_error_message("Failed to make the headless context current"));
+}
+
+HeadlessContext::~HeadlessContext() noexcept
+{
+	if (!m_display)
+		return;
+
+	if (m_context)
+	{
+		// Still current, the GL objects go before the context does
+		m_framebuffer.reset();
+		m_color.reset();
+		m_depth.reset();
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(m_display, m_context);
+	}
+	if (m_surface)
+		eglDestroySurface(m_display, m_surface);
+	eglTerminate(m_display);
+}
+
+auto HeadlessContext::get_proc_address(const char* name) -> void*
+{
+	return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+void HeadlessContext::make_current()
+{
+	if (!eglMakeCurrent(m_display, m_surface, m_surface, m_context))
+		throw gl_error(egl_error_message("Failed to make the headless context current"));
+}
+
+void HeadlessContext::release()
+{
+	eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+#else
+
+HeadlessContext::HeadlessContext(int32_t width, int32_t height, bool)
+	: m_width(width), m_height(height)
+{
+	throw gl_error("Headless mode needs EGL, this build was configured without it");
+}
+
+HeadlessContext::~HeadlessContext() noexcept
+{
+}
+
+auto HeadlessContext::get_proc_address(const char*) -> void*
+{
+	return nullptr;
+}
+
+void HeadlessContext::make_current()
+{
+}
+
+void HeadlessContext::release()
+{
+}
+
+#endif // defined(HEADLESS_EGL)
+
+void HeadlessContext::create_framebuffer()
+{
+	m_color = Renderbuffer::create(GL_RGBA8, m_width, m_height);
+	m_depth = Renderbuffer::create(GL_DEPTH_COMPONENT24, m_width, m_height);
+
+	m_framebuffer = Framebuffer::create();
+	m_framebuffer.attach(GL_COLOR_ATTACHMENT0, m_color);
+	m_framebuffer.attach(GL_DEPTH_ATTACHMENT, m_depth);
+
+	const GLenum status = m_framebuffer.status();
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+		throw gl_error(fmt::format("Headless framebuffer incomplete (0x{:x})", status));
+
+	gl_state.bind_framebuffer(GL_FRAMEBUFFER, m_framebuffer.id());
+	glViewport(0, 0, m_width, m_height);
+}
+
+void HeadlessContext::present()
+{
+	// What a swap would do, without the vsync wait. The stream buffer fences keep the
+	// cpu from running more than its frames in flight ahead
+	glFlush();
+}
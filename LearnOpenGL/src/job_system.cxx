@@ -0,0 +1,217 @@
+#include "job_system.h"
+
+#include <cassert>
+#include <stdexcept>
+#include "profiler.h"
+
+namespace
+{
+
+std::atomic<uint64_t> s_next_system_id{ 1 };
+
+// The state this thread has in the system it used last, found again without a lock
+thread_local uint64_t t_system_id = 0;
+thread_local void* t_state = nullptr;
+
+// Failed sweeps before an idle worker goes to sleep
+constexpr uint32_t idle_spins = 64;
+
+}
+
+JobSystem::JobSystem(const Settings& settings)
+	: m_id(s_next_system_id.fetch_add(1, std::memory_order_relaxed))
+{
+	uint32_t threads = settings.thread_count;
+	if (threads == 0)
+		threads = std::max(2u, std::thread::hardware_concurrency());
+	threads = std::min<uint32_t>(threads, max_threads / 2);
+
+	m_workers.reserve(threads - 1);
+	for (uint32_t i = 1; i < threads; i++)
+		m_workers.emplace_back(&JobSystem::worker_main, this);
+}
+
+JobSystem::~JobSystem()
+{
+	m_stopping.store(true, std::memory_order_release);
+	wake(true);
+	for (auto& worker : m_workers)
+		worker.join();
+
+	// Queued after the workers left, or missed by a steal that lost a race
+	auto& thread = this_thread();
+	while (try_run_one(thread))
+	{
+	}
+}
+
+auto JobSystem::this_thread() -> ThreadState&
+{
+	if (t_system_id != m_id)
+	{
+		t_state = &register_thread();
+		t_system_id = m_id;
+	}
+	return *static_cast<ThreadState*>(t_state);
+}
+
+auto JobSystem::register_thread() -> ThreadState&
+{
+	std::lock_guard lock(m_register_mutex);
+
+	// Seen before, the thread used another system in between
+	const auto id = std::this_thread::get_id();
+	const uint32_t count = m_thread_count.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (m_threads[i]->id == id)
+			return *m_threads[i];
+	}
+
+	if (count == max_threads)
+		throw std::length_error("More threads queuing jobs than JobSystem::max_threads");
+
+	// Published by the count, thieves only look at entries below it
+	m_threads[count] = std::make_unique<ThreadState>();
+	m_threads[count]->id = id;
+	m_threads[count]->victim = count;
+	m_thread_count.store(count + 1, std::memory_order_release);
+	return *m_threads[count];
+}
+
+void JobSystem::push(ThreadState& thread, Function function, void* data, uint32_t begin, uint32_t end, JobCounter* counter)
+{
+	// Every slot in the pool queued, help until the oldest has run
+	Job& job = thread.pool[thread.next_job];
+	while (job.queued.load(std::memory_order_acquire))
+	{
+		if (!try_run_one(thread))
+			std::this_thread::yield();
+	}
+	thread.next_job = (thread.next_job + 1) % jobs_per_thread;
+
+	job.function = function;
+	job.data = data;
+	job.begin = begin;
+	job.end = end;
+	job.counter = counter;
+	job.queued.store(true, std::memory_order_relaxed);
+
+	// Counted before anyone can run it, so the counter never passes zero early
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	// The pool and the deque are the same size, a free slot means room in the deque
+	[[maybe_unused]] const bool pushed = thread.deque.push(&job);
+	assert(pushed);
+}
+
+void JobSystem::wake(bool all) noexcept
+{
+	m_epoch.fetch_add(1, std::memory_order_release);
+	if (all)
+		m_epoch.notify_all();
+	else
+		m_epoch.notify_one();
+}
+
+auto JobSystem::try_run_one(ThreadState& thread) -> bool
+{
+	Job* job = nullptr;
+	if (thread.deque.pop(job))
+	{
+		execute(thread, *job);
+		return true;
+	}
+
+	const uint32_t count = m_thread_count.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t victim = (thread.victim + i) % count;
+		ThreadState* other = m_threads[victim].get();
+		if (other == &thread)
+			continue;
+
+		if (other->deque.steal(job))
+		{
+			// Where work was found there is likely more
+			thread.victim = victim;
+			thread.stolen.fetch_add(1, std::memory_order_relaxed);
+			execute(thread, *job);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(ThreadState& thread, Job& job)
+{
+	// Copied out, the slot can be reused as soon as it's released
+	const Function function = job.function;
+	void* data = job.data;
+	const uint32_t begin = job.begin;
+	const uint32_t end = job.end;
+	JobCounter* counter = job.counter;
+	job.queued.store(false, std::memory_order_release);
+
+	function(data, begin, end);
+	thread.executed.fetch_add(1, std::memory_order_relaxed);
+
+	// Last touch, a waiter may destroy the counter right after
+	if (counter)
+		counter->m_pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::worker_main()
+{
+	set_profiler_thread_name("job worker");
+	auto& thread = this_thread();
+
+	for (;;)
+	{
+		// Read before looking for work, a job queued after the sweep changes it and the wait returns
+		const uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+
+		bool found = false;
+		for (uint32_t spin = 0; spin < idle_spins && !found; spin++)
+		{
+			found = try_run_one(thread);
+			if (!found)
+				std::this_thread::yield();
+		}
+		if (found)
+			continue;
+
+		if (m_stopping.load(std::memory_order_acquire))
+			return;
+		m_epoch.wait(epoch, std::memory_order_acquire);
+	}
+}
+
+void JobSystem::run(Function function, void* data, uint32_t begin, uint32_t end, JobCounter* counter)
+{
+	push(this_thread(), function, data, begin, end, counter);
+	wake(false);
+}
+
+void JobSystem::wait(const JobCounter& counter)
+{
+	auto& thread = this_thread();
+	while (!counter.done())
+	{
+		if (!try_run_one(thread))
+			std::this_thread::yield();
+	}
+}
+
+auto JobSystem::stats() const noexcept -> Stats
+{
+	Stats stats;
+	const uint32_t count = m_thread_count.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		stats.executed += m_threads[i]->executed.load(std::memory_order_relaxed);
+		stats.stolen += m_threads[i]->stolen.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
@@ -1,4 +1,14 @@
 #include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 #include <cstdint>
 #include <cassert>
 
@@ -6,16 +16,42 @@
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 #include <fmt/core.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "platfrom.h"
 #include "callbacks.h"
-#include "file.h"
 #include "shader_program.h"
+#include "shader_preprocessor.h"
+#include "options.h"
+#include "scene.h"
+#include "frame_stats.h"
+#include "transform.h"
+#include "culling.h"
+#include "mesh.h"
+#include "mesh_import.h"
+#include "texture_loader.h"
+#include "program_cache.h"
+#include "stream_buffer.h"
+#include "gl_extensions.h"
+#include "shader_reloader.h"
+#include "shader_variants.h"
+#include "profiler.h"
+#include "headless_context.h"
+#include "benchmark_report.h"
+#include "gl_debug.h"
+#include "render_queue.h"
+#include "gl_objects.h"
+#include "gl_state.h"
+#include "depth_pyramid.h"
+#include "gpu_culler.h"
+#include "texture_residency.h"
+#include "triple_buffer.h"
+#include "job_system.h"
+#include "alloc_stats.h"
+#include "frame_arena.h"
+#include "frame_capture.h"
 
 extern "C"
 {
@@ -69,228 +105,665 @@ constexpr float_t vertices[] {
     -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
 };
 
-constexpr glm::vec3 cubePositions[]{
-        glm::vec3( 0.0f,  0.0f,  0.0f),
-        glm::vec3( 2.0f,  5.0f, -15.0f),
-        glm::vec3(-1.5f, -2.2f, -2.5f),
-        glm::vec3(-3.8f, -2.0f, -12.3f),
-        glm::vec3( 2.4f, -0.4f, -3.5f),
-        glm::vec3(-1.7f,  3.0f, -7.5f),
-        glm::vec3( 1.3f, -2.0f, -2.5f),
-        glm::vec3( 1.5f,  2.0f, -2.5f),
-        glm::vec3( 1.5f,  0.2f, -1.5f),
-        glm::vec3(-1.3f,  1.0f, -1.5f)
-    };
-
-int main()
+int main(int argc, char** argv)
 {
-	if (!glfwInit())
-	{
-		spdlog::error("Failed to init glfw");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
+	const auto options = parse_options(argc, argv);
 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// Headless runs never touch glfw, there may be no display to connect to
+	std::optional<HeadlessContext> headless;
+	GLFWwindow* window = nullptr;
+	GLADloadproc get_proc_address = nullptr;
 #if !defined(NDEBUG)
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+	const bool debug_context = options.gl_debug != GlDebugMode::Off;
+#else
+	const bool debug_context = false;
 #endif // !defined(NDEBUG)
 
-	auto window = glfwCreateWindow(WIDTH, HEIGHT, "LearnOpenGL", nullptr, nullptr);
-	if (!window)
+	if (options.headless_frames > 0)
 	{
-		spdlog::error("Failed to create glfw window");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
+		try {
+			headless.emplace(WIDTH, HEIGHT, debug_context);
+		}
+		catch (gl_error& ecx)
+		{
+			spdlog::error("Headless: {}", ecx.what());
+			exit(EXIT_FAILURE);
+		}
+		get_proc_address = HeadlessContext::get_proc_address;
 	}
-	glfwMakeContextCurrent(window);
-	glfwSwapInterval(1); // V-sync
+	else
+	{
+		if (!glfwInit())
+		{
+			spdlog::error("Failed to init glfw");
+			glfwTerminate();
+			exit(EXIT_FAILURE);
+		}
+
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debug_context ? GL_TRUE : GL_FALSE);
 
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		window = glfwCreateWindow(WIDTH, HEIGHT, "LearnOpenGL", nullptr, nullptr);
+		if (!window)
+		{
+			spdlog::error("Failed to create glfw window");
+			glfwTerminate();
+			exit(EXIT_FAILURE);
+		}
+		glfwMakeContextCurrent(window);
+		glfwSwapInterval(1); // V-sync
+		get_proc_address = (GLADloadproc)glfwGetProcAddress;
+	}
+
+	if (!gladLoadGLLoader(get_proc_address))
 	{
 		spdlog::error("Failed to load opengl functions");
 		glfwTerminate();
 		exit(EXIT_FAILURE);
 	}
+	load_gl_extensions(get_proc_address);
 
 	glEnable(GL_DEPTH_TEST);
 
-	glfwSetKeyCallback(window, key_callback);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-	spdlog::info("{}", glGetString(GL_RENDERER));
-	spdlog::info("Version: {}", glGetString(GL_VERSION));
-
-	// Init debug
-	int32_t flags = 0;
-	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
-	if (flags & GL_CONTEXT_FLAG_DEBUG_BIT)
+	if (headless)
 	{
-		glEnable(GL_DEBUG_OUTPUT);
-		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-		glDebugMessageCallback(debug_msg_callback, nullptr);
-		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
-		puts("Debug output enabled\n\n");
+		try {
+			headless->create_framebuffer();
+		}
+		catch (gl_error& ecx)
+		{
+			spdlog::error("Headless: {}", ecx.what());
+			exit(EXIT_FAILURE);
+		}
 	}
 	else
 	{
-		puts("Debug output disabled\n\n");
+		glfwSetKeyCallback(window, key_callback);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	}
 
-	uint32_t vbo, vao;
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
-
-	glBindVertexArray(vao);
+	// The context is current on one thread at a time, released before another takes it
+	const auto make_context_current = [&](bool current) {
+		if (headless)
+			current ? headless->make_current() : headless->release();
+		else
+			glfwMakeContextCurrent(current ? window : nullptr);
+	};
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferStorage(GL_ARRAY_BUFFER, sizeof(vertices), vertices, 0);
+	spdlog::info("{}", (const char*)glGetString(GL_RENDERER));
+	spdlog::info("Version: {}", (const char*)glGetString(GL_VERSION));
 
-	// Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float_t) * 5, (void*)0);
-	glEnableVertexAttribArray(0);
+	// Messages are queued by the callback and logged from update() through an async logger
+	std::optional<GlDebugOutput> debug_output;
+	if (options.gl_debug != GlDebugMode::Off)
+	{
+		GlDebugOutput::Settings debug_settings;
+		debug_settings.synchronous = options.gl_debug == GlDebugMode::Sync;
+		debug_output.emplace(debug_settings);
+	}
 
-	// Texure coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float_t) * 5, (void*)(sizeof(float_t) * 3));
-    glEnableVertexAttribArray(1);
+	// One thread per core, shared by asset loading and the per frame bounds, cull and transform work
+	JobSystem jobs({ options.job_threads });
 
-	uint32_t texture0, texture1;
-	int32_t width, height, nrChannels;
-	uint8_t* data;
+	// Weld the flat vertex array, reorder it for the vertex cache and quantize it
+	constexpr size_t vertex_stride = 5;
+	constexpr size_t vertex_count = sizeof(vertices) / (sizeof(float_t) * vertex_stride);
+	const auto welded = build_indexed_mesh(vertices, vertex_count, vertex_stride);
+	auto optimized = welded;
+	optimize_vertex_cache(optimized);
+	const auto quantized = quantize_mesh(optimized);
+	log_mesh_report("cube", vertex_count, sizeof(float_t) * vertex_stride, welded, optimized, quantized);
 
-	// texture0
-	glGenTextures(1, &texture0);
-	//glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture0);
+	auto mesh = upload_mesh(quantized);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// The cube spans -0.5 .. 0.5 on every axis, imported models are fitted into the same box
+	Aabb mesh_bounds{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+	if (!options.model_path.empty())
+	{
+		// The cube stays when the model can't be loaded
+		if (auto model = load_model(jobs, options.model_path))
+		{
+			mesh = std::move(model->mesh);
+			mesh_bounds = model->bounds;
+		}
+	}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// Includes are pasted in, a file shared by several shaders is read once
+	ShaderPreprocessor preprocessor;
+	const auto load_shader = [&preprocessor](const char* path) -> std::string {
+		auto source = preprocessor.load(path);
+		if (!source)
+			exit(EXIT_FAILURE);
+		return std::move(source->text);
+	};
+
+	const auto positions = make_cube_positions(options.instance_count);
+	const auto instance_count = static_cast<uint32_t>(positions.size());
+
+	TransformSoA transforms;
+	transforms.reserve(instance_count);
+	for (uint32_t i = 0; i < instance_count; i++)
+	{
+		transforms.push_back(positions[i], glm::vec3(1.0f, 0.3f, 0.5f), glm::radians(20.0f * i));
+	}
 
-	stbi_set_flip_vertically_on_load(true);
+	spdlog::info("Render mode: {}, {} instances, {} transform kernel, culling {}, {} materials, draws {}, {} job threads",
+		render_mode_name(options.mode), instance_count, simd_level_name(best_simd_level()), cull_mode_name(options.cull),
+		options.material_count, options.sort_draws ? "sorted" : "in submission order", jobs.thread_count());
 
-	data = stbi_load("res/textures/wood_container.jpg", &width, &height, &nrChannels, 0);
-	if (!data)
+	std::vector<Aabb> bounds;
+	Bvh bvh;
+	if (options.mode == RenderMode::Gpu)
 	{
-		spdlog::error("Failed to load image");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
+		// Uploaded once, the gpu tests them every frame and the cpu never looks at them again
+		compute_world_bounds(jobs, transforms, mesh_bounds, bounds);
 	}
-	else
+	else if (options.cull != CullMode::Off)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		compute_world_bounds(jobs, transforms, mesh_bounds, bounds);
+		bvh.build(bounds);
 	}
-	stbi_image_free(data);
 
-	// texture1
-	glGenTextures(1, &texture1);
-	//glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, texture1);
+	int exit_code = 0;
+	try { 
+		// Decoding happens on worker threads, the placeholder is bound until each texture is resident
+		TextureLoader loader(jobs, {});
+		const auto texture0 = loader.load("res/textures/wood_container.jpg");
+		const auto texture1 = loader.load("res/textures/awesomeface.png");
+		for (uint32_t i = 0; i < options.stream_test; i++)
+		{
+			loader.load(i % 2 == 0 ? "res/textures/wood_container.jpg" : "res/textures/awesomeface.png");
+		}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// Every extra material gets its own pair of texture objects, object i uses material i % count
+		std::vector<std::array<TextureLoader::Handle, 2>> materials{ { texture0, texture1 } };
+		for (uint32_t m = 1; m < options.material_count; m++)
+		{
+			const auto wood = loader.load("res/textures/wood_container.jpg");
+			const auto face = loader.load("res/textures/awesomeface.png");
+			materials.push_back(m % 2 == 0 ? std::array{ wood, face } : std::array{ face, wood });
+		}
+		const auto material_count = static_cast<uint32_t>(materials.size());
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		std::optional<ProgramCache> program_cache;
+		if (options.shader_cache != ShaderCacheMode::Off)
+		{
+			const ProgramCache::Settings cache_settings;
+			if (options.shader_cache == ShaderCacheMode::Clear)
+			{
+				std::error_code ec;
+				std::filesystem::remove_all(cache_settings.directory, ec);
+			}
+			program_cache.emplace(cache_settings);
+		}
 
-	data = stbi_load("res/textures/awesomeface.png", &width, &height, &nrChannels, 0);
-	if (!data)
-	{
-		spdlog::error("Failed to load image");
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-	else
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	stbi_image_free(data);
+		// Pull the camera back and the far plane out so larger scenes stay in view
+		const float_t extent = scene_extent(instance_count);
+		const float_t radius = orbit_radius(instance_count);
 
-	const auto vert_src = read_file("res/shaders/basic.vert.glsl");
-	const auto frag_src = read_file("res/shaders/basic.frag.glsl");
+		const float_t far_plane = std::max(100.0f, radius + extent * 2.0f);
+		const auto proj = glm::perspective(glm::radians(45.0f), (float_t)WIDTH / (float_t)HEIGHT, 0.1f, far_plane);
 
+		// std140 layouts of the Frame and Object blocks in basic.vert.glsl
+		struct FrameBlock
+		{
+			glm::mat4 view;
+			glm::mat4 proj;
+		};
+		struct ObjectBlock
+		{
+			glm::mat4 model;
+			uint32_t material;
+			uint32_t padding[3]{};
+		};
+
+		// Each frame takes the Frame block plus either packed instance matrices and materials
+		// and an unused Object block, or one aligned Object block per legacy draw
+		const size_t alignment = StreamBuffer::binding_alignment();
+		const auto aligned = [alignment](size_t size) { return (size + alignment - 1) / alignment * alignment; };
+		size_t object_bytes = aligned(sizeof(ObjectBlock)) * instance_count;
+		if (options.mode == RenderMode::Instanced)
+			object_bytes = aligned(sizeof(glm::mat4) * instance_count) + aligned(sizeof(uint32_t) * instance_count) + aligned(sizeof(ObjectBlock));
+		else if (options.mode == RenderMode::Gpu)
+			object_bytes = aligned(sizeof(GpuCuller::CullBlock)) + aligned(sizeof(ObjectBlock));
+		StreamBuffer ring(aligned(sizeof(FrameBlock)) + object_bytes);
+
+		// Materials are rows of a table the shaders index, so every object goes in one batch
+		std::optional<GpuCuller> gpu_culler;
+		std::optional<DepthPyramid> depth_pyramid;
+		Buffer object_materials;
+		if (options.mode == RenderMode::Gpu)
+		{
+			const auto cull_src = load_shader("res/shaders/cull.comp.glsl");
+			gpu_culler.emplace(cull_src.c_str(), transforms, bounds, 1, mesh.index_count);
+			gpu_culler->attach(mesh.vao, 2, 1);
+			spdlog::info("Gpu culling {} objects into one indirect command, draw count from {}",
+				instance_count, gl_extensions.indirect_parameters ? "the gpu (GL_ARB_indirect_parameters)" : "the cpu");
 
-	try { 
-		ShaderProgram program(vert_src.c_str(), frag_src.c_str());
+			if (options.occlusion && options.cull != CullMode::Off)
+			{
+				const auto hiz_src = load_shader("res/shaders/hiz.comp.glsl");
+				depth_pyramid.emplace(hiz_src.c_str());
+			}
+
+			std::vector<uint32_t> object_material(instance_count);
+			for (uint32_t i = 0; i < instance_count; i++)
+				object_material[i] = i % material_count;
+			object_materials = Buffer::create(sizeof(uint32_t) * instance_count, object_material.data());
+		}
+
+		// One sampler on every array unit, it overrides the parameters of every texture
+		auto sampler = Sampler::create();
+		sampler.parameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+		sampler.parameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+		sampler.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		sampler.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		for (uint32_t unit = 0; unit < TextureResidency::max_arrays; unit++)
+			gl_state.bind_sampler(unit, sampler.id());
+
+		// Loaded textures become layers of shared arrays (or bindless handles), picked per object by material
+		TextureResidency residency(sampler, options.bindless);
+		for (const auto& material : materials)
+			residency.add_material({ material[0], material[1] });
+		spdlog::info("{} materials through {}", material_count, residency.bindless() ? "bindless handles" : "texture arrays");
+
+		// The mode and the material path pick compile time keywords of basic.*.glsl instead of uniforms
+		const auto shader_start = std::chrono::steady_clock::now();
+		ShaderVariants variants(preprocessor, "res/shaders/basic.vert.glsl", "res/shaders/basic.frag.glsl", program_cache ? &*program_cache : nullptr);
+		ShaderVariants::Mask variant = 0;
+		if (options.mode != RenderMode::Legacy)
+			variant |= variants.keyword("INSTANCED");
+		if (options.mode == RenderMode::Gpu)
+			variant |= variants.keyword("INDIRECT");
+		if (residency.bindless())
+			variant |= variants.keyword("BINDLESS");
+
+		// Every variant this driver can build, so an edit that breaks one the current mode doesn't use shows up too
+		if (options.shader_variants == ShaderVariantsMode::All)
+		{
+			std::vector<ShaderVariants::Mask> masks;
+			for (ShaderVariants::Mask mask = 0; mask <= variants.all_keywords(); mask++)
+			{
+				if (gl_extensions.bindless_texture || (mask & variants.keyword("BINDLESS")) == 0)
+					masks.push_back(mask);
+			}
+			variants.prewarm(masks);
+		}
+		ShaderProgram& program = variants.get(variant);
+		const double shader_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shader_start).count();
+
+		const auto& variant_stats = variants.stats();
+		spdlog::info("Shader variant {}, {} variants built as {} programs from {} compiled stages ({} shared)",
+			variants.keyword_names(variant), variant_stats.variants, variant_stats.programs, variant_stats.shaders, variant_stats.shared_shaders);
+		if (program_cache && program_cache->enabled())
+		{
+			const auto& cache_stats = program_cache->stats();
+			spdlog::info("Shader programs ready in {:.2f} ms, {} cache ({} hits, {} misses, {} rejected)",
+				shader_ms, cache_stats.misses == 0 ? "warm" : "cold", cache_stats.hits, cache_stats.misses, cache_stats.rejected);
+		}
+		else
+		{
+			spdlog::info("Shader programs ready in {:.2f} ms, no cache", shader_ms);
+		}
 
-		program.use();
+		// Edits under res/shaders are rebuilt in the background and swapped in once linked
+		ShaderReloader reloader("res/shaders", preprocessor, program_cache ? &*program_cache : nullptr);
+		reloader.watch(variants, variant);
 
-		auto uModel = glGetUniformLocation(program.id, "model");
-		assert(uModel != -1);
-		auto uView = glGetUniformLocation(program.id, "view");
-		assert(uView != -1);
-		auto uProj = glGetUniformLocation(program.id, "proj");
-		assert(uProj != -1);
+		// Transient data of the frame being drawn, dropped after the swap. Declared first, the
+		// queue keeps arena containers until it goes
+		FrameArena frame_arena(1 << 20);
 
-		auto model = glm::mat4(1.0f);
-		auto proj = glm::mat4(1.0f);
-		auto view = glm::lookAt(
-			glm::vec3(0.0f, 0.0f, 3.0f),
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 1.0f, 0.0f)
-		);
+		// Draws are keyed by program, textures, vao and depth and sorted before submission
+		RenderQueue queue;
 
-		proj = glm::perspective(glm::radians(45.0f), (float_t)WIDTH / (float_t)HEIGHT, 0.1f, 100.0f);
+		FrameStatsReporter reporter(render_mode_name(options.mode), options.stats_interval);
 
-		glUniformMatrix4fv(uProj, 1, GL_FALSE, glm::value_ptr(proj));
-		glUniformMatrix4fv(uView, 1, GL_FALSE, glm::value_ptr(view));
+		Profiler::Settings profiler_settings;
+		profiler_settings.report_interval = options.stats_interval;
+		profiler_settings.trace_path = options.trace_path;
+		Profiler profiler(profiler_settings);
 
-		const float_t radius = 10.0f;
-		float_t camX;
-		float_t camZ;
+		// Frames are copied into mapped buffers by the gpu and encoded on the workers a few
+		// frames later. Headless runs wait for a free buffer instead of dropping frames
+		std::optional<FrameCapture> capture;
+		if (!options.capture_dir.empty())
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(options.capture_dir, ec);
+			if (ec)
+			{
+				spdlog::error("Failed to create {}: {}", options.capture_dir, ec.message());
+				exit(EXIT_FAILURE);
+			}
+
+			FrameCapture::Settings capture_settings;
+			capture_settings.directory = options.capture_dir;
+			capture_settings.format = options.capture_format == CaptureFormat::Raw ? FrameCapture::Format::Raw : FrameCapture::Format::Png;
+			capture_settings.every = options.capture_every;
+			capture_settings.wait_when_busy = headless.has_value();
+			capture.emplace(jobs, capture_settings);
+			spdlog::info("Capturing 1 in {} frames to {} as {}", options.capture_every, options.capture_dir, options.capture_format == CaptureFormat::Raw ? "raw RGBA8" : "PNG");
+		}
+
+		// Headless runs advance a fixed 60 Hz clock per frame, so every run renders the same frames
+		BenchmarkReport benchmark(options.headless_frames);
+		const auto should_close = [&](uint32_t frame_index) {
+			return headless ? frame_index >= options.headless_frames : glfwWindowShouldClose(window);
+		};
 
-		while (!glfwWindowShouldClose(window))
+		// Everything drawing a frame needs from the simulation. The simulation fills one while
+		// the render thread draws another, so it is never changed after being published
+		struct FrameSnapshot
 		{
+			glm::mat4 view{ 1.0f };
+			glm::vec3 camera{ 0.0f };
+			std::vector<uint32_t> objects; // What survived culling, every object without it
+			std::vector<glm::mat4> models; // Model matrices of objects, in the same order
+			std::vector<float_t> depths;   // Distance to the camera over the far plane, legacy only
+		};
+
+		// Sized for every object up front, nothing is allocated per frame. Each snapshot is
+		// made by a call, copying a vector doesn't copy its capacity
+		const auto make_snapshot = [&]() {
+			FrameSnapshot snapshot;
+			if (options.mode != RenderMode::Gpu)
+			{
+				snapshot.objects.reserve(instance_count);
+				snapshot.models.reserve(instance_count);
+				if (options.mode == RenderMode::Legacy)
+					snapshot.depths.reserve(instance_count);
+			}
+			return snapshot;
+		};
+
+		// Camera, culling and transforms, no GL. The heavy parts are split over the job system
+		const auto simulate = [&](FrameSnapshot& frame, uint32_t frame_index) {
+			PROFILE_CPU("simulate");
+			const double time = headless ? frame_index / 60.0 : glfwGetTime();
+			frame.camera = glm::vec3(sin(time) * radius, 0.0f, cos(time) * radius);
+			frame.view = glm::lookAt(frame.camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+			// The gpu culls and transforms for itself
+			if (options.mode == RenderMode::Gpu)
+				return;
+
+			// Only objects inside the view frustum are submitted
+			frame.objects.clear();
+			if (options.cull != CullMode::Off)
+			{
+				PROFILE_CPU("cull");
+				if (options.cull == CullMode::Refit || options.cull == CullMode::Rebuild)
+				{
+					compute_world_bounds(jobs, transforms, mesh_bounds, bounds);
+					if (options.cull == CullMode::Refit)
+						bvh.refit(jobs, bounds);
+					else
+						bvh.build(bounds);
+				}
+				bvh.cull(jobs, extract_frustum(proj * frame.view), bounds, frame.objects);
+			}
+			else
+			{
+				frame.objects.resize(instance_count);
+				std::iota(frame.objects.begin(), frame.objects.end(), 0u);
+			}
+
+			const size_t count = frame.objects.size();
+			frame.models.resize(count);
+			if (count > 0)
+			{
+				auto* matrices = glm::value_ptr(frame.models[0]);
+				if (options.cull != CullMode::Off)
+					build_model_matrices(jobs, transforms, frame.objects.data(), count, matrices);
+				else
+					build_model_matrices(jobs, transforms, matrices);
+			}
+
+			if (options.mode == RenderMode::Legacy)
+			{
+				frame.depths.resize(count);
+				jobs.parallel_for(static_cast<uint32_t>(count), parallel_grain, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t n = begin; n < end; n++)
+						frame.depths[n] = glm::length(positions[frame.objects[n]] - frame.camera) / far_plane;
+				});
+			}
+		};
+
+		// Everything GL, on whichever thread holds the context
+		// Loading is done and every pool, ring and arena had time to grow: from here on a frame
+		// allocating on the heap is a regression
+		constexpr uint32_t alloc_warmup_frames = 8;
+		uint32_t settled_frames = 0;
+		uint64_t last_allocations = alloc_stats().allocations;
+
+		const auto render = [&](const FrameSnapshot& frame) {
+			profiler.begin_frame(frame_arena);
+			PROFILE_CPU("frame");
+
+			benchmark.begin_frame();
+			reporter.begin_frame();
+			FrameStats stats;
+			const uint64_t avoided_before = gl_state.stats().avoided;
+
+			apply_window_events();
+			reloader.update();
+			if (debug_output)
+				debug_output->update();
+			if (capture)
+				capture->update();
+
+			const uint32_t stalls_before = ring.stalls();
+			ring.begin_frame();
+
+			ring.bind(GL_UNIFORM_BUFFER, 0, ring.push(FrameBlock{ frame.view, proj }));
+
 			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture0);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture1);
-			
-			// model = glm::mat4(1.0f);
-			// model = glm::rotate(model, glm::radians(50.0f) * (float_t)glfwGetTime(), glm::vec3(0.5f, 1.0f, 0.0f));
-			// glUniformMatrix4fv(uModel, 1, GL_FALSE, glm::value_ptr(model));
-
-			glBindVertexArray(vao);
-			for (uint32_t i = 0; i < 10; i++)
+			loader.update();
+			residency.update(loader);
+			residency.bind(6);
+
+			const uint32_t submit_count = gpu_culler ? gpu_culler->visible_count() : static_cast<uint32_t>(frame.objects.size());
+
+			// The arrays are the only textures bound, the same ones every draw
+			queue.begin_frame(frame_arena);
+			const auto arrays = queue.add_texture_set({ residency.array(0), residency.array(1), residency.array(2), residency.array(3) });
+
+			RenderQueue::Draw draw;
+			draw.texture_set = arrays;
+			draw.program = program.id;
+			draw.vao = mesh.vao.id();
+			draw.index_count = mesh.index_count;
+			draw.index_type = mesh.index_type;
+
+			{
+				PROFILE_CPU("draw");
+				PROFILE_GPU(profiler, "draw");
+				if (gpu_culler)
+				{
+					ring.bind(GL_UNIFORM_BUFFER, 1, ring.push(ObjectBlock{}));
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, object_materials.id());
+					{
+						PROFILE_GPU(profiler, "cull");
+						gpu_culler->cull(ring, extract_frustum(proj * frame.view), options.cull != CullMode::Off,
+							depth_pyramid ? &*depth_pyramid : nullptr);
+					}
+
+					// One multi draw, its instance count never reaches the cpu
+					draw.indirect = gpu_culler->indirect(0);
+					queue.submit(draw);
+				}
+				else if (options.mode == RenderMode::Instanced)
+				{
+					// Not read in this mode, but every active block needs a buffer behind it
+					ring.bind(GL_UNIFORM_BUFFER, 1, ring.push(ObjectBlock{}));
+
+					// One instanced draw whatever the materials, the matrices were built by the
+					// simulation and are copied into the ring as they are
+					if (submit_count > 0)
+					{
+						draw.instances = ring.allocate(sizeof(glm::mat4) * submit_count);
+						std::memcpy(draw.instances.data, frame.models.data(), sizeof(glm::mat4) * submit_count);
+
+						const auto instance_materials = ring.allocate(sizeof(uint32_t) * submit_count);
+						auto* material_indices = static_cast<uint32_t*>(instance_materials.data);
+						for (uint32_t n = 0; n < submit_count; n++)
+							material_indices[n] = frame.objects[n] % material_count;
+						ring.bind(GL_SHADER_STORAGE_BUFFER, 5, instance_materials);
+
+						draw.instance_count = submit_count;
+						queue.submit(draw);
+					}
+				}
+				else
+				{
+					for (uint32_t n = 0; n < submit_count; n++)
+					{
+						draw.object = ring.push(ObjectBlock{ frame.models[n], frame.objects[n] % material_count });
+						draw.depth = frame.depths[n];
+						queue.submit(draw);
+					}
+				}
+
+				if (options.sort_draws)
+					queue.sort();
+				const auto queue_stats = queue.execute(ring);
+				stats.draw_calls = queue_stats.draws;
+				stats.program_switches = queue_stats.program_switches;
+				stats.texture_binds = queue_stats.texture_binds;
+				stats.vao_switches = queue_stats.vao_switches;
+
+				if (gpu_culler)
+					gpu_culler->end_frame();
+			}
+			if (depth_pyramid)
 			{
-				model = glm::mat4(1.0f);
-				model = glm::translate(model, cubePositions[i]);
-				float_t angle = 20.0f * i;
-				model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-				glUniformMatrix4fv(uModel, 1, GL_FALSE, glm::value_ptr(model));
+				// What this frame drew hides objects from the next one
+				PROFILE_GPU(profiler, "hiz");
+				depth_pyramid->build(headless ? headless->framebuffer() : 0, proj * frame.view);
+			}
+			stats.instances = submit_count;
+			stats.triangles = uint64_t(submit_count) * (mesh.index_count / 3);
+			stats.occluded = gpu_culler ? gpu_culler->occluded_count() : 0;
+			stats.culled = instance_count - submit_count - stats.occluded;
+
+			ring.end_frame();
+			stats.ring_stalls = ring.stalls() - stalls_before;
+			stats.binds_avoided = static_cast<uint32_t>(gl_state.stats().avoided - avoided_before);
 
-				glDrawArrays(GL_TRIANGLES, 0, 36);
+			if (capture)
+			{
+				PROFILE_CPU("capture");
+				capture->capture();
 			}
 
-			camX = sin(glfwGetTime()) * radius;
-			camZ = cos(glfwGetTime()) * radius;
-			view = glm::lookAt(
-				glm::vec3(camX, 0.0, camZ),
-				glm::vec3(0.0),
-				glm::vec3(0.0, 1.0, 0.0)
-			);
+			// Counted swap to swap, so the simulation of the next frame and every worker are included
+			const uint64_t allocations = alloc_stats().allocations;
+			stats.allocations = static_cast<uint32_t>(allocations - last_allocations);
+			last_allocations = allocations;
+			settled_frames = loader.idle() ? settled_frames + 1 : 0;
+
+			reporter.end_frame(stats);
+
+			if (headless)
+			{
+				PROFILE_CPU("present");
+				headless->present();
+				benchmark.end_frame(stats, settled_frames > alloc_warmup_frames);
+				frame_arena.reset();
+				return;
+			}
 
-			glUniformMatrix4fv(uView, 1, GL_FALSE, glm::value_ptr(view));
+			{
+				PROFILE_CPU("swap");
+				glfwSwapBuffers(window);
+			}
+			frame_arena.reset();
+		};
 
-			glfwPollEvents();
-			glfwSwapBuffers(window);
+		if (!options.render_thread)
+		{
+			// Simulated and drawn in turn, one snapshot is enough
+			FrameSnapshot frame = make_snapshot();
+			for (uint32_t frame_index = 0; !should_close(frame_index); frame_index++)
+			{
+				if (window)
+					glfwPollEvents();
+				simulate(frame, frame_index);
+				render(frame);
+			}
 		}
+		else
+		{
+			// This thread polls input and simulates the next frame while the render thread,
+			// holding the context, draws the last one and waits on the swap
+			TripleBuffer<FrameSnapshot> snapshots(make_snapshot);
+			std::exception_ptr render_error;
+
+			make_context_current(false);
+			std::thread render_thread([&]() {
+				set_profiler_thread_name("render");
+				try {
+					make_context_current(true);
+					while (const FrameSnapshot* frame = snapshots.acquire())
+						render(*frame);
+				}
+				catch (...)
+				{
+					render_error = std::current_exception();
+				}
+				snapshots.close();
+				make_context_current(false);
+			});
+
+			for (uint32_t frame_index = 0; !should_close(frame_index); frame_index++)
+			{
+				if (window)
+					glfwPollEvents();
+				simulate(snapshots.back(), frame_index);
+				if (!snapshots.publish())
+					break;
+			}
+			snapshots.close();
+			render_thread.join();
 
-		glDeleteBuffers(1, &vbo);
+			// Back here for the report and the cleanup
+			make_context_current(true);
+			if (render_error)
+				std::rethrow_exception(render_error);
+		}
 
-		glDeleteTextures(1, &texture0);
-		glDeleteTextures(1, &texture1);
+		if (headless)
+		{
+			glFinish();
+			const BenchmarkReport::Info info{
+				(const char*)glGetString(GL_RENDERER),
+				(const char*)glGetString(GL_VERSION),
+				render_mode_name(options.mode),
+				cull_mode_name(options.cull),
+				instance_count,
+				headless->width(),
+				headless->height(),
+			};
+			if (!benchmark.write(options.report_path, info))
+				exit_code = EXIT_FAILURE;
+			if (options.alloc_check && benchmark.steady_state_allocations() > 0)
+			{
+				spdlog::error("{} heap allocations after warm-up, expected none", benchmark.steady_state_allocations());
+				exit_code = EXIT_FAILURE;
+			}
+			// Textures still loading or too few frames, a pass would mean nothing
+			if (options.alloc_check && benchmark.steady_frames() == 0)
+			{
+				spdlog::error("No frame reached steady state, nothing was checked for allocations");
+				exit_code = EXIT_FAILURE;
+			}
+		}
 
-		glDeleteVertexArrays(1, &vao);
 	}
 	catch (gl_error& ecx)
 	{
@@ -299,6 +772,9 @@ int main()
 		exit(EXIT_FAILURE);
 	}
 
+	// GL objects have to go while the context is still current
+	mesh = GpuMesh{};
+	debug_output.reset();
 	glfwTerminate();
-	return 0;
+	return exit_code;
 }
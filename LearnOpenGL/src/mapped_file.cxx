@@ -0,0 +1,129 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#if defined(WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+#if defined(WINDOWS)
+		m_file = std::exchange(other.m_file, nullptr);
+		m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+	}
+	return *this;
+}
+
+auto MappedFile::open(const char* path) -> bool
+{
+	close();
+
+#if defined(WINDOWS)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+#elif defined(POSIX)
+	const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = static_cast<size_t>(st.st_size);
+	return true;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+void MappedFile::prefetch() const noexcept
+{
+	if (!m_data)
+		return;
+
+#if defined(WINDOWS)
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<uint8_t*>(m_data), m_size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#elif defined(POSIX)
+	madvise(const_cast<uint8_t*>(m_data), m_size, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::close() noexcept
+{
+	if (!m_data)
+		return;
+
+#if defined(WINDOWS)
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	CloseHandle(m_file);
+	m_file = nullptr;
+	m_mapping = nullptr;
+#elif defined(POSIX)
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,297 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+
+struct VertexKey
+{
+	MeshVertex v;
+
+	bool operator==(const VertexKey& other) const noexcept
+	{
+		// Bitwise so -0.0 and 0.0 stay distinct, like the bytes the gpu would see
+		return std::memcmp(&v, &other.v, sizeof(MeshVertex)) == 0;
+	}
+};
+
+struct VertexKeyHash
+{
+	size_t operator()(const VertexKey& key) const noexcept
+	{
+		uint32_t words[sizeof(MeshVertex) / sizeof(uint32_t)];
+		std::memcpy(words, &key.v, sizeof(words));
+
+		size_t h = 0xcbf29ce484222325ull;
+		for (uint32_t w : words)
+		{
+			h ^= w;
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+};
+
+}
+
+auto build_indexed_mesh(const float_t* data, size_t vertex_count, size_t stride_floats) -> Mesh
+{
+	Mesh mesh;
+	mesh.indices.reserve(vertex_count);
+
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+	unique.reserve(vertex_count);
+
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		const float_t* src = data + i * stride_floats;
+		const VertexKey key{ { glm::vec3(src[0], src[1], src[2]), glm::vec2(src[3], src[4]) } };
+
+		auto [it, inserted] = unique.try_emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+		if (inserted)
+			mesh.vertices.push_back(key.v);
+		mesh.indices.push_back(it->second);
+	}
+
+	return mesh;
+}
+
+void optimize_vertex_cache(Mesh& mesh, uint32_t cache_size)
+{
+	const auto vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+	const auto triangle_count = static_cast<uint32_t>(mesh.indices.size() / 3);
+	if (triangle_count == 0)
+		return;
+
+	const auto& indices = mesh.indices;
+
+	// Vertex -> triangle adjacency in compressed row form
+	std::vector<uint32_t> live(vertex_count, 0);
+	for (uint32_t index : indices)
+		live[index]++;
+
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] = offsets[v] + live[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t t = 0; t < triangle_count; t++)
+			for (uint32_t k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+	}
+
+	std::vector<uint32_t> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint32_t timestamp = cache_size + 1;
+	uint32_t cursor = 0;
+	int64_t fanning = 0;
+
+	while (fanning >= 0)
+	{
+		const auto f = static_cast<uint32_t>(fanning);
+		candidates.clear();
+
+		for (uint32_t a = offsets[f]; a < offsets[f + 1]; a++)
+		{
+			const uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const uint32_t v = indices[t * 3 + k];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (timestamp - cache_time[v] > cache_size)
+					cache_time[v] = timestamp++;
+			}
+			emitted[t] = true;
+		}
+
+		// Next fanning vertex: the candidate still in cache that will stay there longest
+		fanning = -1;
+		int64_t best_priority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (timestamp - cache_time[v] + 2 * live[v] <= cache_size)
+				priority = timestamp - cache_time[v];
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				fanning = v;
+			}
+		}
+
+		if (fanning >= 0)
+			continue;
+
+		// Dead end, backtrack through recently used vertices
+		while (!dead_end.empty())
+		{
+			const uint32_t v = dead_end.back();
+			dead_end.pop_back();
+			if (live[v] > 0)
+			{
+				fanning = v;
+				break;
+			}
+		}
+
+		// Then fall back to the next vertex in input order that still has triangles
+		while (fanning < 0 && cursor < vertex_count)
+		{
+			if (live[cursor] > 0)
+				fanning = cursor;
+			cursor++;
+		}
+	}
+
+	// Renumber vertices in first use order
+	constexpr uint32_t unassigned = UINT32_MAX;
+	std::vector<uint32_t> remap(vertex_count, unassigned);
+	std::vector<MeshVertex> vertices;
+	vertices.reserve(vertex_count);
+	for (auto& index : output)
+	{
+		if (remap[index] == unassigned)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	mesh.vertices = std::move(vertices);
+	mesh.indices = std::move(output);
+}
+
+auto compute_acmr(const std::vector<uint32_t>& indices, uint32_t cache_size) -> float_t
+{
+	if (indices.size() < 3)
+		return 0.0f;
+
+	// FIFO, what most hardware implements, a miss pushes the oldest entry out
+	std::vector<uint32_t> fifo(cache_size, UINT32_MAX);
+	uint32_t head = 0;
+	size_t misses = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (std::find(fifo.begin(), fifo.end(), index) != fifo.end())
+			continue;
+
+		fifo[head] = index;
+		head = (head + 1) % cache_size;
+		misses++;
+	}
+
+	return static_cast<float_t>(misses) / static_cast<float_t>(indices.size() / 3);
+}
+
+auto quantize_mesh(const Mesh& mesh) -> QuantizedMesh
+{
+	QuantizedMesh out;
+	out.vertices.reserve(mesh.vertices.size());
+
+	for (const auto& v : mesh.vertices)
+	{
+		if (glm::any(glm::lessThan(v.uv, glm::vec2(0.0f))) || glm::any(glm::greaterThan(v.uv, glm::vec2(1.0f))))
+		{
+			throw std::invalid_argument("Texture coordinate outside [0, 1] can't be stored as unorm16");
+		}
+
+		QuantizedVertex q;
+		q.position[0] = glm::packHalf1x16(v.position.x);
+		q.position[1] = glm::packHalf1x16(v.position.y);
+		q.position[2] = glm::packHalf1x16(v.position.z);
+		q.position[3] = 0;
+		q.uv[0] = static_cast<uint16_t>(std::lround(v.uv.x * 65535.0f));
+		q.uv[1] = static_cast<uint16_t>(std::lround(v.uv.y * 65535.0f));
+		out.vertices.push_back(q);
+	}
+
+	out.index_count = static_cast<uint32_t>(mesh.indices.size());
+	if (mesh.vertices.size() <= UINT16_MAX + 1)
+	{
+		out.index_type = GL_UNSIGNED_SHORT;
+		out.indices.resize(mesh.indices.size() * sizeof(uint16_t));
+		auto* dst = reinterpret_cast<uint16_t*>(out.indices.data());
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			dst[i] = static_cast<uint16_t>(mesh.indices[i]);
+	}
+	else
+	{
+		out.index_type = GL_UNSIGNED_INT;
+		out.indices.resize(mesh.indices.size() * sizeof(uint32_t));
+		std::memcpy(out.indices.data(), mesh.indices.data(), out.indices.size());
+	}
+
+	return out;
+}
+
+auto upload_mesh(const QuantizedMesh& mesh) -> GpuMesh
+{
+	return upload_mesh(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.index_count, mesh.index_type);
+}
+
+auto upload_mesh(const QuantizedVertex* vertices, size_t vertex_count, const void* indices, uint32_t index_count,
+	uint32_t index_type, bool uv_half) -> GpuMesh
+{
+	GpuMesh gpu;
+	gpu.index_count = index_count;
+	gpu.index_type = index_type;
+
+	const size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	gpu.vbo = Buffer::create(vertex_count * sizeof(QuantizedVertex), vertices);
+	gpu.ebo = Buffer::create(size_t(index_count) * index_size, indices);
+
+	gpu.vao = VertexArray::create();
+	gpu.vao.vertex_buffer(0, gpu.vbo, 0, sizeof(QuantizedVertex));
+	gpu.vao.element_buffer(gpu.ebo);
+
+	// Position attribute, half floats are converted to float by the fetch hardware
+	gpu.vao.attrib_format(0, 0, 3, GL_HALF_FLOAT, false, offsetof(QuantizedVertex, position));
+
+	// Texure coord attribute, normalized so 0 .. 65535 reads as 0.0 .. 1.0
+	if (uv_half)
+		gpu.vao.attrib_format(1, 0, 2, GL_HALF_FLOAT, false, offsetof(QuantizedVertex, uv));
+	else
+		gpu.vao.attrib_format(1, 0, 2, GL_UNSIGNED_SHORT, true, offsetof(QuantizedVertex, uv));
+
+	return gpu;
+}
+
+void log_mesh_report(const char* name, size_t raw_vertex_count, size_t raw_vertex_size,
+	const Mesh& welded, const Mesh& optimized, const QuantizedMesh& quantized)
+{
+	const size_t raw_bytes = raw_vertex_count * raw_vertex_size;
+	const size_t vertex_bytes = quantized.vertices.size() * sizeof(QuantizedVertex);
+	const size_t index_bytes = quantized.indices.size();
+
+	// An unindexed draw has no reuse at all, so its ACMR is always 3
+	spdlog::info("Mesh {}: {} -> {} vertices, {} -> {} bytes ({} vertex + {} index), ACMR 3.000 unindexed, {:.3f} welded, {:.3f} optimized",
+		name,
+		raw_vertex_count, quantized.vertices.size(),
+		raw_bytes, vertex_bytes + index_bytes, vertex_bytes, index_bytes,
+		compute_acmr(welded.indices), compute_acmr(optimized.indices));
+}
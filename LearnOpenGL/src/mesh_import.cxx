@@ -0,0 +1,599 @@
+#include "mesh_import.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+#include <spdlog/spdlog.h>
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "text_scan.h"
+
+static_assert(sizeof(QuantizedVertex) == mesh_file_vertex_size);
+
+namespace
+{
+
+constexpr size_t min_chunk_size = 1 << 20; // Smaller slices aren't worth a thread
+constexpr uint32_t no_uv = ~0u;
+
+struct Corner
+{
+	uint32_t position;
+	uint32_t uv;
+};
+
+// Start of a usemtl / o / g group
+struct Group
+{
+	uint32_t first_triangle;
+	uint64_t name_hash;
+};
+
+// A slice of the file cut at line ends. Every chunk is counted first, so it knows where its
+// elements go in the shared arrays, then parsed straight into them
+struct Chunk
+{
+	const char* begin = nullptr;
+	const char* end = nullptr;
+	uint32_t positions = 0;
+	uint32_t uvs = 0;
+	uint32_t triangles = 0;
+	uint32_t groups = 0;
+	uint32_t position_base = 0;
+	uint32_t uv_base = 0;
+	uint32_t triangle_base = 0;
+	uint32_t group_base = 0;
+	const char* error = nullptr;
+};
+
+struct ObjData
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<Corner> corners; // 3 per triangle
+	std::vector<Group> groups;
+};
+
+// Runs fn(i) for every i below count as separate jobs
+template<typename Fn>
+void for_each_job(JobSystem& jobs, uint32_t count, Fn&& fn)
+{
+	jobs.parallel_for(count, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
+			fn(i);
+	});
+}
+
+auto parse_float(const char*& p, const char* end, float_t& out) noexcept -> bool
+{
+	p = skip_spaces(p, end);
+	if (p != end && *p == '+')
+		p++;
+	const auto [ptr, ec] = std::from_chars(p, end, out);
+	if (ec == std::errc::result_out_of_range)
+		out = 0.0f;
+	else if (ec != std::errc())
+		return false;
+	p = ptr;
+	return true;
+}
+
+// 1 based, negative counts back from the newest element, 0 is invalid
+auto resolve_index(const char*& p, const char* end, uint32_t seen, uint32_t total, uint32_t& out) noexcept -> bool
+{
+	int64_t index = 0;
+	const auto [ptr, ec] = std::from_chars(p, end, index);
+	if (ec != std::errc() || index == 0)
+		return false;
+	p = ptr;
+
+	const int64_t resolved = index > 0 ? index - 1 : int64_t(seen) + index;
+	if (resolved < 0 || resolved >= int64_t(total))
+		return false;
+	out = static_cast<uint32_t>(resolved);
+	return true;
+}
+
+// One face corner, p, p/t, p/t/n or p//n. Normals aren't used
+auto parse_corner(const char*& p, const char* end, const Chunk& chunk, const ObjData& obj,
+	uint32_t positions, uint32_t uvs, Corner& corner) noexcept -> bool
+{
+	corner.uv = no_uv;
+	if (!resolve_index(p, end, chunk.position_base + positions, static_cast<uint32_t>(obj.positions.size()), corner.position))
+		return false;
+
+	if (p != end && *p == '/')
+	{
+		p++;
+		if (p != end && *p != '/' && !is_space(*p)
+			&& !resolve_index(p, end, chunk.uv_base + uvs, static_cast<uint32_t>(obj.uvs.size()), corner.uv))
+			return false;
+
+		if (p != end && *p == '/')
+			p = skip_token(p + 1, end);
+	}
+	return p == end || is_space(*p);
+}
+
+// Counting and filling walk the lines the same way, so both agree on every index
+template<bool fill>
+void parse_chunk(Chunk& chunk, ObjData& obj) noexcept
+{
+	uint32_t positions = 0;
+	uint32_t uvs = 0;
+	uint32_t triangles = 0;
+	uint32_t groups = 0;
+
+	for (const char* p = chunk.begin; p < chunk.end; p = line_end(p, chunk.end) + 1)
+	{
+		const char* eol = line_end(p, chunk.end);
+		const char* s = skip_spaces(p, eol);
+		const char* args = skip_token(s, eol);
+		const std::string_view keyword(s, static_cast<size_t>(args - s));
+
+		if (keyword == "v")
+		{
+			if constexpr (fill)
+			{
+				glm::vec3 v;
+				if (!parse_float(args, eol, v.x) || !parse_float(args, eol, v.y) || !parse_float(args, eol, v.z))
+				{
+					chunk.error = "malformed vertex position";
+					return;
+				}
+				obj.positions[chunk.position_base + positions] = v;
+			}
+			positions++;
+		}
+		else if (keyword == "vt")
+		{
+			if constexpr (fill)
+			{
+				// v is optional
+				glm::vec2 uv(0.0f);
+				if (!parse_float(args, eol, uv.x))
+				{
+					chunk.error = "malformed texture coordinate";
+					return;
+				}
+				parse_float(args, eol, uv.y);
+				obj.uvs[chunk.uv_base + uvs] = uv;
+			}
+			uvs++;
+		}
+		else if (keyword == "f")
+		{
+			// Polygons are fanned around their first corner
+			uint32_t count = 0;
+			Corner first{};
+			Corner previous{};
+			for (const char* q = skip_spaces(args, eol); q != eol && *q != '#'; q = skip_spaces(q, eol))
+			{
+				if constexpr (fill)
+				{
+					Corner corner;
+					if (!parse_corner(q, eol, chunk, obj, positions, uvs, corner))
+					{
+						chunk.error = "malformed face or index out of range";
+						return;
+					}
+
+					if (count == 0)
+						first = corner;
+					else if (count >= 2)
+					{
+						Corner* out = &obj.corners[(size_t(chunk.triangle_base) + triangles + count - 2) * 3];
+						out[0] = first;
+						out[1] = previous;
+						out[2] = corner;
+					}
+					previous = corner;
+				}
+				else
+				{
+					q = skip_token(q, eol);
+				}
+				count++;
+			}
+			if (count >= 3)
+				triangles += count - 2;
+		}
+		else if (keyword == "usemtl" || keyword == "o" || keyword == "g")
+		{
+			if constexpr (fill)
+			{
+				const char* name = skip_spaces(args, eol);
+				const char* name_end = eol;
+				while (name_end != name && is_space(name_end[-1]))
+					name_end--;
+				obj.groups[chunk.group_base + groups] = { chunk.triangle_base + triangles,
+					fnv1a(std::string_view(name, static_cast<size_t>(name_end - name))) };
+			}
+			groups++;
+		}
+	}
+
+	chunk.positions = positions;
+	chunk.uvs = uvs;
+	chunk.triangles = triangles;
+	chunk.groups = groups;
+}
+
+auto quantize_vertex(const MeshVertex& v, bool uv_half) noexcept -> QuantizedVertex
+{
+	QuantizedVertex q;
+	q.position[0] = glm::packHalf1x16(v.position.x);
+	q.position[1] = glm::packHalf1x16(v.position.y);
+	q.position[2] = glm::packHalf1x16(v.position.z);
+	q.position[3] = 0;
+	if (uv_half)
+	{
+		q.uv[0] = glm::packHalf1x16(v.uv.x);
+		q.uv[1] = glm::packHalf1x16(v.uv.y);
+	}
+	else
+	{
+		q.uv[0] = static_cast<uint16_t>(std::lround(v.uv.x * 65535.0f));
+		q.uv[1] = static_cast<uint16_t>(std::lround(v.uv.y * 65535.0f));
+	}
+	return q;
+}
+
+auto align_up(uint64_t value, uint64_t alignment) -> uint64_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+auto import_obj(JobSystem& jobs, const uint8_t* data, size_t size) -> ImportedMesh
+{
+	// One chunk per thread, the counts of each chunk are needed before the next pass
+	const auto thread_count = static_cast<uint32_t>(std::clamp<size_t>(size / min_chunk_size, 1, jobs.thread_count()));
+
+	std::vector<Chunk> chunks(thread_count);
+	const char* text = reinterpret_cast<const char*>(data);
+	const char* end = text + size;
+	const char* begin = text;
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		const char* cut = i + 1 == thread_count ? end : std::max(begin, text + size * (i + 1) / thread_count);
+		if (cut != end)
+			cut = std::min(line_end(cut, end) + 1, end);
+		chunks[i].begin = begin;
+		chunks[i].end = cut;
+		begin = cut;
+	}
+
+	ObjData obj;
+	for_each_job(jobs, thread_count, [&](uint32_t t) { parse_chunk<false>(chunks[t], obj); });
+
+	uint64_t positions = 0;
+	uint64_t uvs = 0;
+	uint64_t triangles = 0;
+	uint64_t groups = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.position_base = static_cast<uint32_t>(positions);
+		chunk.uv_base = static_cast<uint32_t>(uvs);
+		chunk.triangle_base = static_cast<uint32_t>(triangles);
+		chunk.group_base = static_cast<uint32_t>(groups);
+		positions += chunk.positions;
+		uvs += chunk.uvs;
+		triangles += chunk.triangles;
+		groups += chunk.groups;
+	}
+	if (triangles == 0)
+		throw std::runtime_error("no faces");
+	if (triangles * 3 > UINT32_MAX || positions > UINT32_MAX || uvs >= no_uv)
+		throw std::runtime_error("more than 2^32 indices");
+
+	obj.positions.resize(positions);
+	obj.uvs.resize(uvs);
+	obj.corners.resize(triangles * 3);
+	obj.groups.resize(groups);
+	for_each_job(jobs, thread_count, [&](uint32_t t) { parse_chunk<true>(chunks[t], obj); });
+
+	for (const auto& chunk : chunks)
+	{
+		if (chunk.error)
+			throw std::runtime_error(chunk.error);
+	}
+
+	ImportedMesh out;
+
+	// Fit into the unit cube the scene's objects occupy, half float positions keep ~3 digits
+	std::vector<Aabb> thread_bounds(thread_count, Aabb{ glm::vec3(INFINITY), glm::vec3(-INFINITY) });
+	for_each_job(jobs, thread_count, [&](uint32_t t) {
+		const size_t first = obj.positions.size() * t / thread_count;
+		const size_t last = obj.positions.size() * (t + 1) / thread_count;
+		for (size_t i = first; i < last; i++)
+		{
+			thread_bounds[t].min = glm::min(thread_bounds[t].min, obj.positions[i]);
+			thread_bounds[t].max = glm::max(thread_bounds[t].max, obj.positions[i]);
+		}
+	});
+	Aabb source_bounds = thread_bounds[0];
+	for (const auto& bounds : thread_bounds)
+	{
+		source_bounds.min = glm::min(source_bounds.min, bounds.min);
+		source_bounds.max = glm::max(source_bounds.max, bounds.max);
+	}
+	const glm::vec3 extent = source_bounds.max - source_bounds.min;
+	const float_t largest = std::max({ extent.x, extent.y, extent.z });
+	out.source_center = (source_bounds.min + source_bounds.max) * 0.5f;
+	out.source_scale = largest > 0.0f ? 1.0f / largest : 1.0f;
+
+	const bool uv_half = !std::all_of(obj.uvs.begin(), obj.uvs.end(), [](const glm::vec2& uv) {
+		return uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+	});
+	out.uv_format = uv_half ? MeshFileUv::Half : MeshFileUv::Unorm16;
+
+	// Groups without triangles (a g straight before its usemtl) are dropped
+	obj.groups.insert(obj.groups.begin(), Group{ 0, 0 });
+	std::vector<MeshFileSubmesh> submeshes;
+	for (size_t g = 0; g < obj.groups.size(); g++)
+	{
+		const uint32_t first = obj.groups[g].first_triangle;
+		const uint32_t last = g + 1 < obj.groups.size() ? obj.groups[g + 1].first_triangle : static_cast<uint32_t>(triangles);
+		if (last > first)
+			submeshes.push_back({ first * 3, (last - first) * 3, {}, {}, obj.groups[g].name_hash });
+	}
+
+	// Each submesh gets its own vertices, so it can be reordered for the vertex cache on
+	// its own. The variants of a position (one per uv) are chained from head, which is
+	// reset lazily through stamp instead of cleared for every submesh
+	std::vector<Mesh> meshes(submeshes.size());
+	{
+		std::vector<uint32_t> head(obj.positions.size());
+		std::vector<uint32_t> stamp(obj.positions.size(), ~0u);
+		std::vector<uint32_t> next;
+		std::vector<uint32_t> variant_uv;
+		for (uint32_t s = 0; s < submeshes.size(); s++)
+		{
+			auto& mesh = meshes[s];
+			next.clear();
+			variant_uv.clear();
+			mesh.indices.reserve(submeshes[s].index_count);
+
+			const Corner* corners = obj.corners.data() + submeshes[s].first_index;
+			for (uint32_t c = 0; c < submeshes[s].index_count; c++)
+			{
+				const Corner corner = corners[c];
+				if (stamp[corner.position] != s)
+				{
+					stamp[corner.position] = s;
+					head[corner.position] = ~0u;
+				}
+
+				uint32_t vertex = head[corner.position];
+				while (vertex != ~0u && variant_uv[vertex] != corner.uv)
+					vertex = next[vertex];
+
+				if (vertex == ~0u)
+				{
+					vertex = static_cast<uint32_t>(mesh.vertices.size());
+					const glm::vec2 uv = corner.uv != no_uv ? obj.uvs[corner.uv] : glm::vec2(0.0f);
+					mesh.vertices.push_back({ (obj.positions[corner.position] - out.source_center) * out.source_scale, uv });
+					variant_uv.push_back(corner.uv);
+					next.push_back(head[corner.position]);
+					head[corner.position] = vertex;
+				}
+				mesh.indices.push_back(vertex);
+			}
+		}
+	}
+	obj = {};
+
+	// Submeshes differ wildly in size, stealing evens that out
+	const auto mesh_count = static_cast<uint32_t>(meshes.size());
+	for_each_job(jobs, mesh_count, [&](uint32_t s) { optimize_vertex_cache(meshes[s]); });
+
+	std::vector<uint32_t> vertex_base(meshes.size());
+	uint64_t vertex_count = 0;
+	for (size_t s = 0; s < meshes.size(); s++)
+	{
+		vertex_base[s] = static_cast<uint32_t>(vertex_count);
+		vertex_count += meshes[s].vertices.size();
+	}
+	if (vertex_count > UINT32_MAX)
+		throw std::runtime_error("more than 2^32 vertices");
+
+	out.index_count = static_cast<uint32_t>(triangles * 3);
+	out.index_type = vertex_count <= UINT16_MAX + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	out.vertices.resize(vertex_count);
+	out.indices.resize(size_t(out.index_count) * (out.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t)));
+
+	// Bounds are taken from the quantized positions, they're what the gpu will draw
+	for_each_job(jobs, mesh_count, [&](uint32_t s) {
+		const auto& mesh = meshes[s];
+		auto& submesh = submeshes[s];
+		glm::vec3 min(INFINITY);
+		glm::vec3 max(-INFINITY);
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			const auto q = quantize_vertex(mesh.vertices[v], uv_half);
+			out.vertices[vertex_base[s] + v] = q;
+			const glm::vec3 p(glm::unpackHalf1x16(q.position[0]), glm::unpackHalf1x16(q.position[1]), glm::unpackHalf1x16(q.position[2]));
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		std::memcpy(submesh.bounds_min, &min, sizeof(submesh.bounds_min));
+		std::memcpy(submesh.bounds_max, &max, sizeof(submesh.bounds_max));
+
+		if (out.index_type == GL_UNSIGNED_SHORT)
+		{
+			auto* dst = reinterpret_cast<uint16_t*>(out.indices.data()) + submesh.first_index;
+			for (size_t i = 0; i < mesh.indices.size(); i++)
+				dst[i] = static_cast<uint16_t>(vertex_base[s] + mesh.indices[i]);
+		}
+		else
+		{
+			auto* dst = reinterpret_cast<uint32_t*>(out.indices.data()) + submesh.first_index;
+			for (size_t i = 0; i < mesh.indices.size(); i++)
+				dst[i] = vertex_base[s] + mesh.indices[i];
+		}
+	});
+
+	out.bounds = { glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+	for (const auto& submesh : submeshes)
+	{
+		out.bounds.min = glm::min(out.bounds.min, glm::vec3(submesh.bounds_min[0], submesh.bounds_min[1], submesh.bounds_min[2]));
+		out.bounds.max = glm::max(out.bounds.max, glm::vec3(submesh.bounds_max[0], submesh.bounds_max[1], submesh.bounds_max[2]));
+	}
+	out.submeshes = std::move(submeshes);
+	return out;
+}
+
+auto write_mesh_file(const std::filesystem::path& path, const ImportedMesh& mesh, uint64_t source_size, int64_t source_time) -> bool
+{
+	MeshFileHeader header{};
+	std::memcpy(header.magic, mesh_file_magic, sizeof(mesh_file_magic));
+	header.version = mesh_file_version;
+	header.uv_format = mesh.uv_format;
+	header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+	header.index_count = mesh.index_count;
+	header.index_type = mesh.index_type;
+	header.submesh_count = static_cast<uint32_t>(mesh.submeshes.size());
+	header.vertex_offset = align_up(sizeof(MeshFileHeader) + sizeof(MeshFileSubmesh) * mesh.submeshes.size(), 16);
+	header.index_offset = align_up(header.vertex_offset + sizeof(QuantizedVertex) * mesh.vertices.size(), 16);
+	std::memcpy(header.bounds_min, &mesh.bounds.min, sizeof(header.bounds_min));
+	std::memcpy(header.bounds_max, &mesh.bounds.max, sizeof(header.bounds_max));
+	header.source_scale = mesh.source_scale;
+	std::memcpy(header.source_center, &mesh.source_center, sizeof(header.source_center));
+	header.source_size = source_size;
+	header.source_time = source_time;
+
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		constexpr char zeros[16] = {};
+		const auto pad_to = [&](uint64_t offset) {
+			file.write(zeros, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(mesh.submeshes.data()), static_cast<std::streamsize>(sizeof(MeshFileSubmesh) * mesh.submeshes.size()));
+		pad_to(header.vertex_offset);
+		file.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<std::streamsize>(sizeof(QuantizedVertex) * mesh.vertices.size()));
+		pad_to(header.index_offset);
+		file.write(reinterpret_cast<const char*>(mesh.indices.data()), static_cast<std::streamsize>(mesh.indices.size()));
+
+		if (!file)
+		{
+			file.close();
+			std::error_code ec;
+			std::filesystem::remove(temp_path, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+auto load_model(JobSystem& jobs, const std::filesystem::path& path) -> std::optional<Model>
+{
+	const auto start = std::chrono::steady_clock::now();
+	const auto elapsed_ms = [&] {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	std::error_code ec;
+	const uint64_t source_size = std::filesystem::file_size(path, ec);
+	const auto write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+	{
+		spdlog::error("Failed to open model {}: {}", path.string(), ec.message());
+		return std::nullopt;
+	}
+	const auto source_time = static_cast<int64_t>(write_time.time_since_epoch().count());
+
+	auto cache_path = path;
+	cache_path += mesh_file_extension;
+
+	MappedFile cache;
+	if (cache.open(cache_path.string().c_str()))
+	{
+		const auto* header = parse_mesh_file(cache.data(), cache.size());
+		if (header && header->source_size == source_size && header->source_time == source_time)
+		{
+			// glNamedBufferStorage reads the vertices and indices straight from the mapped pages
+			Model model;
+			model.mesh = upload_mesh(reinterpret_cast<const QuantizedVertex*>(cache.data() + header->vertex_offset), header->vertex_count,
+				cache.data() + header->index_offset, header->index_count, header->index_type, header->uv_format == MeshFileUv::Half);
+			model.bounds = { glm::vec3(header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]),
+				glm::vec3(header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]) };
+			const auto* submeshes = mesh_file_submeshes(header);
+			model.submeshes.assign(submeshes, submeshes + header->submesh_count);
+
+			spdlog::info("Model {}: mapped {} ({} vertices, {} triangles, {} submeshes) in {:.1f} ms",
+				path.string(), cache_path.string(), header->vertex_count, header->index_count / 3, header->submesh_count, elapsed_ms());
+			return model;
+		}
+
+		if (header)
+			spdlog::info("Mesh cache {} is out of date, importing again", cache_path.string());
+		else
+			spdlog::warn("Mesh cache {} is corrupt or from another version, importing again", cache_path.string());
+		cache = MappedFile{};
+	}
+
+	const auto extension = path.extension();
+	if (extension != ".obj" && extension != ".OBJ")
+	{
+		spdlog::error("Can't import {}, only Wavefront .obj models are supported", path.string());
+		return std::nullopt;
+	}
+
+	MappedFile source;
+	if (!source.open(path.string().c_str()))
+	{
+		spdlog::error("Failed to map model {}", path.string());
+		return std::nullopt;
+	}
+	source.prefetch();
+
+	ImportedMesh imported;
+	try
+	{
+		imported = import_obj(jobs, source.data(), source.size());
+	}
+	catch (const std::exception& e)
+	{
+		spdlog::error("Failed to import {}: {}", path.string(), e.what());
+		return std::nullopt;
+	}
+	const double import_ms = elapsed_ms();
+
+	if (!write_mesh_file(cache_path, imported, source_size, source_time))
+		spdlog::warn("Failed to write mesh cache {}, the next run imports again", cache_path.string());
+
+	Model model;
+	model.mesh = upload_mesh(imported.vertices.data(), imported.vertices.size(), imported.indices.data(),
+		imported.index_count, imported.index_type, imported.uv_format == MeshFileUv::Half);
+	model.bounds = imported.bounds;
+	model.submeshes = std::move(imported.submeshes);
+
+	spdlog::info("Model {}: imported {} bytes ({} vertices, {} triangles, {} submeshes) in {:.1f} ms, cached to {}",
+		path.string(), source_size, imported.vertices.size(), imported.index_count / 3, model.submeshes.size(), import_ms, cache_path.string());
+	return model;
+}
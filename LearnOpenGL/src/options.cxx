@@ -0,0 +1,336 @@
+#include "options.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#include <spdlog/spdlog.h>
+
+static void print_usage(const char* exe)
+{
+	spdlog::info(
+		"Usage: {} [options]\n"
+		"  --mode <legacy|instanced|gpu>\n"
+		"                             Draw path, gpu culls on the gpu and draws indirect (default: instanced)\n"
+		"  --instances <n>            Number of cubes in the scene (default: 10)\n"
+		"  --cull <off|static|refit|rebuild>\n"
+		"                             Frustum culling, and how the bvh is kept up to date (default: static),\n"
+		"                             --mode gpu tests every object every frame, off draws them all\n"
+		"  --occlusion <on|off>       With --mode gpu, also cull what last frame's depth hid (default: on)\n"
+		"  --stats-interval <sec>     Seconds between frame stat reports (default: 2)\n"
+		"  --stream-test <n>          Queue n extra texture loads at startup to measure streaming\n"
+		"  --shader-cache <on|off|clear>\n"
+		"                             Program binary cache, clear empties it first (default: on)\n"
+		"  --shader-variants <used|all>\n"
+		"                             Build only the shader variant in use, or every keyword combination\n"
+		"                             at startup to check they all compile (default: used)\n"
+		"  --trace <file.json>        Write a Chrome trace / Perfetto profile on exit\n"
+		"  --headless <frames>        Render the given number of frames offscreen (EGL) without vsync,\n"
+		"                             on a fixed 60 Hz clock, then write a benchmark report\n"
+		"  --report <file.json>       Where --headless writes its report (default: benchmark.json)\n"
+		"  --materials <n>            Distinct texture sets cycled through the objects (default: 1)\n"
+		"  --sort <on|off>            Sort the render queue by state before submitting (default: on)\n"
+		"  --bindless <on|off>        Bindless texture handles where the driver has them, off forces\n"
+		"                             texture arrays (default: on)\n"
+		"  --model <file.obj>         Draw this model in place of the cube, cooked into <file.obj>.lmesh\n"
+		"                             on the first run and mapped from there afterwards\n"
+		"  --render-thread <on|off>   Render on a thread of its own while the main thread polls input\n"
+		"                             and simulates the next frame, off does both in turn (default: on)\n"
+		"  --threads <n>              Job system threads, the main thread included (default: one per core)\n"
+		"  --alloc-check <on|off>     Make --headless fail if any frame after warm-up allocates on the\n"
+		"                             heap (default: off, the count is always in the report)\n"
+		"  --capture <dir>            Read frames back asynchronously and write them to dir as\n"
+		"                             frame_NNNNNN.png (or .rgba), encoded on the job system\n"
+		"  --capture-format <png|raw> File format of --capture, raw is headerless RGBA8 (default: png)\n"
+		"  --capture-every <n>        Capture every nth frame (default: 1)\n"
+		"  --gl-debug <sync|async|off>\n"
+		"                             GL debug output in debug builds, F2 toggles sync (default: sync)",
+		exe);
+}
+
+template<typename T>
+static auto parse_number(std::string_view arg, std::string_view value) -> T
+{
+	T result{};
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+	if (ec != std::errc() || ptr != value.data() + value.size())
+	{
+		spdlog::error("Invalid value '{}' for {}", value, arg);
+		exit(EXIT_FAILURE);
+	}
+	return result;
+}
+
+auto parse_options(int argc, char** argv) -> Options
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string_view arg = argv[i];
+
+		if (arg == "-h" || arg == "--help")
+		{
+			print_usage(argv[0]);
+			exit(EXIT_SUCCESS);
+		}
+
+		if (i + 1 >= argc)
+		{
+			spdlog::error("Missing value for {}", arg);
+			print_usage(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+		const std::string_view value = argv[++i];
+
+		if (arg == "--mode")
+		{
+			if (value == "legacy")
+				options.mode = RenderMode::Legacy;
+			else if (value == "instanced")
+				options.mode = RenderMode::Instanced;
+			else if (value == "gpu")
+				options.mode = RenderMode::Gpu;
+			else
+			{
+				spdlog::error("Unknown render mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--cull")
+		{
+			if (value == "off")
+				options.cull = CullMode::Off;
+			else if (value == "static")
+				options.cull = CullMode::Static;
+			else if (value == "refit")
+				options.cull = CullMode::Refit;
+			else if (value == "rebuild")
+				options.cull = CullMode::Rebuild;
+			else
+			{
+				spdlog::error("Unknown cull mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--instances")
+		{
+			options.instance_count = parse_number<uint32_t>(arg, value);
+			if (options.instance_count == 0)
+			{
+				spdlog::error("--instances must be at least 1");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--stats-interval")
+		{
+			options.stats_interval = parse_number<double>(arg, value);
+		}
+		else if (arg == "--stream-test")
+		{
+			options.stream_test = parse_number<uint32_t>(arg, value);
+		}
+		else if (arg == "--trace")
+		{
+			options.trace_path = value;
+		}
+		else if (arg == "--headless")
+		{
+			options.headless_frames = parse_number<uint32_t>(arg, value);
+			if (options.headless_frames == 0)
+			{
+				spdlog::error("--headless needs at least 1 frame");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--report")
+		{
+			options.report_path = value;
+		}
+		else if (arg == "--materials")
+		{
+			options.material_count = parse_number<uint32_t>(arg, value);
+			if (options.material_count == 0 || options.material_count > 4096)
+			{
+				spdlog::error("--materials must be between 1 and 4096");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--occlusion")
+		{
+			if (value == "on")
+				options.occlusion = true;
+			else if (value == "off")
+				options.occlusion = false;
+			else
+			{
+				spdlog::error("Unknown occlusion mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--sort")
+		{
+			if (value == "on")
+				options.sort_draws = true;
+			else if (value == "off")
+				options.sort_draws = false;
+			else
+			{
+				spdlog::error("Unknown sort mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--bindless")
+		{
+			if (value == "on")
+				options.bindless = true;
+			else if (value == "off")
+				options.bindless = false;
+			else
+			{
+				spdlog::error("Unknown bindless mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--model")
+		{
+			options.model_path = value;
+		}
+		else if (arg == "--render-thread")
+		{
+			if (value == "on")
+				options.render_thread = true;
+			else if (value == "off")
+				options.render_thread = false;
+			else
+			{
+				spdlog::error("Unknown render thread mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--threads")
+		{
+			options.job_threads = parse_number<uint32_t>(arg, value);
+			if (options.job_threads == 0)
+			{
+				spdlog::error("--threads must be at least 1");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--alloc-check")
+		{
+			if (value == "on")
+				options.alloc_check = true;
+			else if (value == "off")
+				options.alloc_check = false;
+			else
+			{
+				spdlog::error("Unknown alloc check mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--capture")
+		{
+			options.capture_dir = value;
+		}
+		else if (arg == "--capture-format")
+		{
+			if (value == "png")
+				options.capture_format = CaptureFormat::Png;
+			else if (value == "raw")
+				options.capture_format = CaptureFormat::Raw;
+			else
+			{
+				spdlog::error("Unknown capture format '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--capture-every")
+		{
+			options.capture_every = parse_number<uint32_t>(arg, value);
+			if (options.capture_every == 0)
+			{
+				spdlog::error("--capture-every must be at least 1");
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--gl-debug")
+		{
+			if (value == "sync")
+				options.gl_debug = GlDebugMode::Sync;
+			else if (value == "async")
+				options.gl_debug = GlDebugMode::Async;
+			else if (value == "off")
+				options.gl_debug = GlDebugMode::Off;
+			else
+			{
+				spdlog::error("Unknown gl debug mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--shader-cache")
+		{
+			if (value == "on")
+				options.shader_cache = ShaderCacheMode::On;
+			else if (value == "off")
+				options.shader_cache = ShaderCacheMode::Off;
+			else if (value == "clear")
+				options.shader_cache = ShaderCacheMode::Clear;
+			else
+			{
+				spdlog::error("Unknown shader cache mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--shader-variants")
+		{
+			if (value == "used")
+				options.shader_variants = ShaderVariantsMode::Used;
+			else if (value == "all")
+				options.shader_variants = ShaderVariantsMode::All;
+			else
+			{
+				spdlog::error("Unknown shader variants mode '{}'", value);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else
+		{
+			spdlog::error("Unknown option {}", arg);
+			print_usage(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return options;
+}
+
+auto render_mode_name(RenderMode mode) -> const char*
+{
+	switch (mode)
+	{
+	case RenderMode::Legacy:
+		return "legacy";
+	case RenderMode::Instanced:
+		return "instanced";
+	case RenderMode::Gpu:
+		return "gpu";
+	}
+	return "unknown";
+}
+
+auto cull_mode_name(CullMode mode) -> const char*
+{
+	switch (mode)
+	{
+	case CullMode::Off:
+		return "off";
+	case CullMode::Static:
+		return "static";
+	case CullMode::Refit:
+		return "refit";
+	case CullMode::Rebuild:
+		return "rebuild";
+	}
+	return "unknown";
+}
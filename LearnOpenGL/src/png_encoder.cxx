@@ -0,0 +1,314 @@
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+
+constexpr size_t window_size = 32768;
+constexpr size_t min_match = 4;
+constexpr size_t max_match = 258;
+constexpr uint32_t hash_bits = 15;
+
+// RFC 1951 3.2.5, the base and extra bits of every length and distance code
+constexpr std::array<uint16_t, 29> length_base{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr std::array<uint8_t, 29> length_extra{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr std::array<uint16_t, 30> distance_base{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr std::array<uint8_t, 30> distance_extra{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+constexpr auto reverse_bits(uint32_t code, uint32_t length) -> uint32_t
+{
+	uint32_t reversed = 0;
+	for (uint32_t i = 0; i < length; i++)
+		reversed |= ((code >> i) & 1) << (length - 1 - i);
+	return reversed;
+}
+
+struct HuffmanCode
+{
+	uint16_t bits;
+	uint8_t length;
+};
+
+// The fixed literal / length code of RFC 1951 3.2.6, bit reversed since Huffman codes
+// are packed starting from their most significant bit
+constexpr auto make_fixed_codes() -> std::array<HuffmanCode, 288>
+{
+	std::array<HuffmanCode, 288> codes{};
+	for (uint32_t symbol = 0; symbol < codes.size(); symbol++)
+	{
+		uint32_t code = 0, length = 0;
+		if (symbol < 144)
+		{
+			code = 0x30 + symbol;
+			length = 8;
+		}
+		else if (symbol < 256)
+		{
+			code = 0x190 + symbol - 144;
+			length = 9;
+		}
+		else if (symbol < 280)
+		{
+			code = symbol - 256;
+			length = 7;
+		}
+		else
+		{
+			code = 0xc0 + symbol - 280;
+			length = 8;
+		}
+		codes[symbol] = { static_cast<uint16_t>(reverse_bits(code, length)), static_cast<uint8_t>(length) };
+	}
+	return codes;
+}
+
+// Match length to its index in length_base
+constexpr auto make_length_codes() -> std::array<uint8_t, max_match + 1>
+{
+	std::array<uint8_t, max_match + 1> codes{};
+	uint8_t code = 0;
+	for (size_t length = min_match; length <= max_match; length++)
+	{
+		while (code + 1u < length_base.size() && length_base[code + 1] <= length)
+			code++;
+		codes[length] = code;
+	}
+	return codes;
+}
+
+constexpr auto make_distance_codes() -> std::array<uint8_t, distance_base.size()>
+{
+	std::array<uint8_t, distance_base.size()> codes{};
+	for (uint32_t code = 0; code < codes.size(); code++)
+		codes[code] = static_cast<uint8_t>(reverse_bits(code, 5));
+	return codes;
+}
+
+constexpr auto make_crc_table() -> std::array<uint32_t, 256>
+{
+	std::array<uint32_t, 256> table{};
+	for (uint32_t n = 0; n < table.size(); n++)
+	{
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		table[n] = c;
+	}
+	return table;
+}
+
+constexpr auto fixed_codes = make_fixed_codes();
+constexpr auto length_codes = make_length_codes();
+constexpr auto distance_codes = make_distance_codes();
+constexpr auto crc_table = make_crc_table();
+
+// Deflate streams are packed starting from the least significant bit of each byte
+class BitWriter
+{
+private:
+	uint8_t* m_out;
+	uint64_t m_bits = 0;
+	uint32_t m_count = 0;
+public:
+	explicit BitWriter(uint8_t* out) noexcept : m_out(out) {}
+
+	void put(uint32_t bits, uint32_t length) noexcept
+	{
+		m_bits |= uint64_t(bits) << m_count;
+		m_count += length;
+		if (m_count >= 32)
+		{
+			for (int i = 0; i < 4; i++)
+				m_out[i] = static_cast<uint8_t>(m_bits >> (i * 8));
+			m_out += 4;
+			m_bits >>= 32;
+			m_count -= 32;
+		}
+	}
+
+	void put(const HuffmanCode& code) noexcept { put(code.bits, code.length); }
+
+	auto finish() noexcept -> uint8_t*
+	{
+		for (; m_count > 0; m_count = m_count > 8 ? m_count - 8 : 0)
+		{
+			*m_out++ = static_cast<uint8_t>(m_bits);
+			m_bits >>= 8;
+		}
+		m_bits = 0;
+		m_count = 0;
+		return m_out;
+	}
+};
+
+auto load_u32(const uint8_t* data) noexcept -> uint32_t
+{
+	uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+auto hash_u32(uint32_t value) noexcept -> uint32_t
+{
+	return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+auto store_be32(uint8_t* out, uint32_t value) noexcept -> uint8_t*
+{
+	out[0] = static_cast<uint8_t>(value >> 24);
+	out[1] = static_cast<uint8_t>(value >> 16);
+	out[2] = static_cast<uint8_t>(value >> 8);
+	out[3] = static_cast<uint8_t>(value);
+	return out + 4;
+}
+
+auto crc32(const uint8_t* data, size_t size) noexcept -> uint32_t
+{
+	uint32_t crc = ~0u;
+	for (size_t i = 0; i < size; i++)
+		crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+auto adler32(const uint8_t* data, size_t size) noexcept -> uint32_t
+{
+	// 5552 bytes is the most that can be summed before b overflows
+	uint32_t a = 1, b = 0;
+	while (size > 0)
+	{
+		const size_t n = std::min<size_t>(size, 5552);
+		for (size_t i = 0; i < n; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += n;
+		size -= n;
+	}
+	return (b << 16) | a;
+}
+
+// Length, type and crc around data already written at out + 8, returns the end of the chunk
+auto close_chunk(uint8_t* out, const char (&type)[5], size_t size) noexcept -> uint8_t*
+{
+	store_be32(out, static_cast<uint32_t>(size));
+	std::memcpy(out + 4, type, 4);
+	return store_be32(out + 8 + size, crc32(out + 4, size + 4));
+}
+
+// Fixed Huffman literals take at most 9 bits, so compressed data never gets much
+// bigger than its input. The rest is the signature, the chunk headers and zlib's
+auto max_png_size(size_t filtered_size) noexcept -> size_t
+{
+	return filtered_size / 8 * 9 + 128;
+}
+
+}
+
+auto PngEncoder::deflate(uint8_t* out) -> uint8_t*
+{
+	const uint8_t* data = m_filtered.data();
+	const size_t size = m_filtered.size();
+
+	BitWriter writer(out);
+	writer.put(1, 1); // Last block
+	writer.put(1, 2); // Fixed Huffman codes
+
+	// One probe per position, and only match starts are hashed: a zero run (an unchanged
+	// row after the Up filter) still turns into a chain of 258 byte matches
+	m_head.assign(size_t(1) << hash_bits, -1);
+	size_t pos = 0;
+	while (pos + min_match <= size)
+	{
+		const uint32_t hash = hash_u32(load_u32(data + pos));
+		const int32_t candidate = m_head[hash];
+		m_head[hash] = static_cast<int32_t>(pos);
+
+		if (candidate < 0 || pos - candidate > window_size || load_u32(data + candidate) != load_u32(data + pos))
+		{
+			writer.put(fixed_codes[data[pos++]]);
+			continue;
+		}
+
+		const size_t limit = std::min(max_match, size - pos);
+		size_t length = min_match;
+		while (length < limit && data[candidate + length] == data[pos + length])
+			length++;
+		const size_t distance = pos - candidate;
+
+		const uint32_t length_code = length_codes[length];
+		writer.put(fixed_codes[257 + length_code]);
+		writer.put(static_cast<uint32_t>(length - length_base[length_code]), length_extra[length_code]);
+
+		const auto distance_code = static_cast<uint32_t>(std::upper_bound(distance_base.begin(), distance_base.end(), distance) - distance_base.begin() - 1);
+		writer.put(distance_codes[distance_code], 5);
+		writer.put(static_cast<uint32_t>(distance - distance_base[distance_code]), distance_extra[distance_code]);
+		pos += length;
+	}
+	while (pos < size)
+		writer.put(fixed_codes[data[pos++]]);
+
+	writer.put(fixed_codes[256]); // End of block
+	return writer.finish();
+}
+
+void PngEncoder::reserve(uint32_t width, uint32_t height)
+{
+	// RGBA, opaque encodes need less
+	const size_t filtered_size = (size_t(width) * 4 + 1) * height;
+	m_filtered.reserve(filtered_size);
+	m_out.reserve(max_png_size(filtered_size));
+	m_head.reserve(size_t(1) << hash_bits);
+}
+
+auto PngEncoder::encode(const uint8_t* pixels, uint32_t width, uint32_t height, ptrdiff_t row_stride, bool opaque) -> std::span<const uint8_t>
+{
+	const uint32_t channels = opaque ? 3 : 4;
+	const size_t row_bytes = size_t(width) * channels;
+	m_filtered.resize((row_bytes + 1) * height);
+
+	// Up filter, every byte minus the one above it. The first row has nothing above and
+	// is stored as it is
+	uint8_t* dst = m_filtered.data();
+	const uint8_t* above = nullptr;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* row = pixels + ptrdiff_t(y) * row_stride;
+		*dst++ = above ? 2 : 0;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			for (uint32_t c = 0; c < channels; c++)
+				*dst++ = static_cast<uint8_t>(row[x * 4 + c] - (above ? above[x * 4 + c] : 0));
+		}
+		above = row;
+	}
+
+	constexpr uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	m_out.resize(max_png_size(m_filtered.size()));
+	uint8_t* out = m_out.data();
+
+	std::memcpy(out, signature, sizeof(signature));
+	out += sizeof(signature);
+
+	uint8_t* header = out + 8;
+	header = store_be32(header, width);
+	header = store_be32(header, height);
+	const uint8_t format[5] = { 8, static_cast<uint8_t>(opaque ? 2 : 6), 0, 0, 0 }; // Depth, RGB or RGBA, deflate, no interlacing
+	std::memcpy(header, format, sizeof(format));
+	out = close_chunk(out, "IHDR", 13);
+
+	uint8_t* stream = out + 8;
+	stream[0] = 0x78; // zlib, 32 KiB window
+	stream[1] = 0x01;
+	uint8_t* end = deflate(stream + 2);
+	end = store_be32(end, adler32(m_filtered.data(), m_filtered.size()));
+	out = close_chunk(out, "IDAT", static_cast<size_t>(end - stream));
+
+	out = close_chunk(out, "IEND", 0);
+	return { m_out.data(), static_cast<size_t>(out - m_out.data()) };
+}
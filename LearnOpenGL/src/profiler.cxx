@@ -0,0 +1,332 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include "hash.h"
+
+std::atomic<bool> g_profiling{ false };
+
+namespace
+{
+	struct CpuEvent
+	{
+		const char* name;
+		uint64_t begin_ns;
+		uint64_t end_ns;
+	};
+
+	// Single producer (the owning thread), single consumer (Profiler::begin_frame)
+	struct ThreadEvents
+	{
+		static constexpr uint64_t capacity = 16384;
+
+		uint32_t tid = 0;
+		std::string name;
+		std::array<CpuEvent, capacity> events;
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<uint64_t> tail{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+	};
+
+	// Buffers live until exit, a thread that finished may still have events to drain
+	std::mutex g_threads_mutex;
+	std::vector<std::unique_ptr<ThreadEvents>> g_threads;
+	thread_local ThreadEvents* t_events = nullptr;
+
+	auto thread_events() -> ThreadEvents*
+	{
+		if (!t_events)
+		{
+			auto events = std::make_unique<ThreadEvents>();
+			std::lock_guard lock(g_threads_mutex);
+			events->tid = static_cast<uint32_t>(g_threads.size()) + 1;
+			events->name = "thread " + std::to_string(events->tid);
+			t_events = events.get();
+			g_threads.push_back(std::move(events));
+		}
+		return t_events;
+	}
+
+	// Gpu events go on their own track in traces
+	constexpr uint32_t gpu_tid = 0;
+}
+
+void record_cpu_event(const char* name, uint64_t begin_ns, uint64_t end_ns) noexcept
+{
+	ThreadEvents* events;
+	try
+	{
+		events = thread_events();
+	}
+	catch (...)
+	{
+		return;
+	}
+
+	const uint64_t head = events->head.load(std::memory_order_relaxed);
+	if (head - events->tail.load(std::memory_order_acquire) >= ThreadEvents::capacity)
+	{
+		events->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	events->events[head & (ThreadEvents::capacity - 1)] = { name, begin_ns, end_ns };
+	events->head.store(head + 1, std::memory_order_release);
+}
+
+void set_profiler_thread_name(const char* name)
+{
+	auto* events = thread_events();
+	std::lock_guard lock(g_threads_mutex);
+	events->name = name;
+}
+
+Profiler::Profiler(const Settings& settings)
+	: m_settings(settings)
+{
+	m_settings.gpu_latency = std::max(m_settings.gpu_latency, 2u);
+	m_gpu_frames.resize(m_settings.gpu_latency);
+	for (auto& frame : m_gpu_frames)
+	{
+		frame.queries.resize(m_settings.max_gpu_scopes * 2);
+		glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		frame.scopes.reserve(m_settings.max_gpu_scopes);
+	}
+
+	// Line the gpu clock up with the cpu one, good enough to place gpu work under the frame that issued it
+	int64_t gpu_now = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	m_gpu_offset_ns = static_cast<int64_t>(profiler_now_ns()) - gpu_now;
+
+	if (!m_settings.trace_path.empty())
+		m_trace.reserve(std::min<size_t>(m_settings.max_trace_events, 1 << 16));
+
+	// The constructing thread is the one that owns the frame
+	set_profiler_thread_name("main");
+	m_last_report_ns = profiler_now_ns();
+	g_profiling.store(true, std::memory_order_relaxed);
+}
+
+Profiler::~Profiler()
+{
+	g_profiling.store(false, std::memory_order_relaxed);
+	drain_cpu_events();
+
+	for (auto& frame : m_gpu_frames)
+		glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+
+	if (!m_settings.trace_path.empty())
+		write_trace();
+}
+
+void Profiler::begin_frame(FrameArena& arena)
+{
+	m_frame++;
+	auto& frame = m_gpu_frames[m_frame % m_gpu_frames.size()];
+	read_gpu_frame(frame);
+	drain_cpu_events();
+
+	const uint64_t now = profiler_now_ns();
+	if ((now - m_last_report_ns) * 1e-9 >= m_settings.report_interval)
+	{
+		report(arena);
+		m_last_report_ns = now;
+	}
+}
+
+auto Profiler::gpu_begin(const char* name) noexcept -> uint32_t
+{
+	auto& frame = m_gpu_frames[m_frame % m_gpu_frames.size()];
+	if (frame.busy || frame.scopes.size() >= m_settings.max_gpu_scopes)
+		return UINT32_MAX;
+
+	const auto index = static_cast<uint32_t>(frame.scopes.size());
+	frame.scopes.push_back({ name, frame.queries[index * 2], frame.queries[index * 2 + 1] });
+	glQueryCounter(frame.queries[index * 2], GL_TIMESTAMP);
+	return index;
+}
+
+void Profiler::gpu_end(uint32_t scope) noexcept
+{
+	if (scope == UINT32_MAX)
+		return;
+
+	auto& frame = m_gpu_frames[m_frame % m_gpu_frames.size()];
+	glQueryCounter(frame.scopes[scope].end, GL_TIMESTAMP);
+}
+
+// Issued gpu_latency frames ago, normally long done. If not, rather than waiting the pool
+// stays untouched and this frame goes without gpu scopes, it's tried again next time around
+void Profiler::read_gpu_frame(GpuFrame& frame)
+{
+	frame.busy = false;
+	if (frame.scopes.empty())
+		return;
+
+	int32_t available = GL_FALSE;
+	glGetQueryObjectiv(frame.scopes.back().end, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == GL_FALSE)
+	{
+		m_gpu_missed++;
+		frame.busy = true;
+		return;
+	}
+
+	for (const auto& scope : frame.scopes)
+	{
+		uint64_t begin = 0;
+		uint64_t end = 0;
+		glGetQueryObjectui64v(scope.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(scope.end, GL_QUERY_RESULT, &end);
+		add_sample(scope.name, true, gpu_tid, begin + m_gpu_offset_ns, end + m_gpu_offset_ns);
+	}
+	frame.scopes.clear();
+}
+
+void Profiler::drain_cpu_events()
+{
+	std::lock_guard lock(g_threads_mutex);
+	for (auto& events : g_threads)
+	{
+		const uint64_t tail = events->tail.load(std::memory_order_relaxed);
+		const uint64_t head = events->head.load(std::memory_order_acquire);
+		for (uint64_t i = tail; i < head; i++)
+		{
+			const auto& event = events->events[i & (ThreadEvents::capacity - 1)];
+			add_sample(event.name, false, events->tid, event.begin_ns, event.end_ns);
+		}
+		events->tail.store(head, std::memory_order_release);
+	}
+}
+
+void Profiler::add_sample(const char* name, bool gpu, uint32_t tid, uint64_t begin_ns, uint64_t end_ns)
+{
+	// Keyed by content, the same literal can have a different address in every translation unit
+	const uint64_t key = fnv1a(std::string_view(name), gpu ? 1 : 0);
+	auto& stats = m_stats[key];
+	if (stats.samples_ms.empty())
+	{
+		stats.name = name;
+		stats.gpu = gpu;
+		stats.samples_ms.reserve(m_settings.stats_window);
+	}
+
+	const float ms = static_cast<float>((end_ns - begin_ns) * 1e-6);
+	if (stats.samples_ms.size() < m_settings.stats_window)
+		stats.samples_ms.push_back(ms);
+	else
+		stats.samples_ms[stats.next] = ms;
+	stats.next = (stats.next + 1) % m_settings.stats_window;
+	stats.count++;
+
+	if (!m_settings.trace_path.empty() && !m_trace_full)
+	{
+		if (m_trace.size() < m_settings.max_trace_events)
+		{
+			m_trace.push_back({ name, tid, begin_ns, end_ns - begin_ns });
+		}
+		else
+		{
+			m_trace_full = true;
+			spdlog::warn("Trace reached {} events, later events aren't recorded", m_settings.max_trace_events);
+		}
+	}
+}
+
+void Profiler::report(FrameArena& arena)
+{
+	std::pmr::vector<const ScopeStats*> active(&arena);
+	active.reserve(m_stats.size());
+	for (auto& [key, stats] : m_stats)
+	{
+		if (stats.count > 0)
+			active.push_back(&stats);
+	}
+	std::sort(active.begin(), active.end(), [](const ScopeStats* a, const ScopeStats* b) {
+		return a->gpu != b->gpu ? !a->gpu : a->name < b->name;
+	});
+
+	uint64_t dropped = 0;
+	{
+		std::lock_guard lock(g_threads_mutex);
+		for (auto& events : g_threads)
+			dropped += events->dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	spdlog::info("Profile over the last {} samples per scope ({} cpu events dropped, {} gpu readbacks missed):",
+		m_settings.stats_window, dropped, m_gpu_missed);
+
+	std::pmr::vector<float> sorted(&arena);
+	sorted.reserve(m_settings.stats_window);
+	for (const auto* stats : active)
+	{
+		sorted.assign(stats->samples_ms.begin(), stats->samples_ms.end());
+		const auto percentile = [&](double p) {
+			const auto index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+			std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(index), sorted.end());
+			return sorted[index];
+		};
+		spdlog::info("  {} {:<24} p50 {:>8.3f} ms  p95 {:>8.3f} ms  p99 {:>8.3f} ms",
+			stats->gpu ? "gpu" : "cpu", stats->name, percentile(0.5), percentile(0.95), percentile(0.99));
+	}
+
+	for (auto& [key, stats] : m_stats)
+		stats.count = 0;
+	m_gpu_missed = 0;
+}
+
+static void write_json_string(std::ofstream& out, std::string_view str)
+{
+	out << '"';
+	for (const char c : str)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\';
+		out << c;
+	}
+	out << '"';
+}
+
+// Chrome trace event format, opens in chrome://tracing and ui.perfetto.dev
+void Profiler::write_trace() const
+{
+	std::ofstream out(m_settings.trace_path, std::ios::trunc);
+	if (!out)
+	{
+		spdlog::error("Failed to write trace {}", m_settings.trace_path);
+		return;
+	}
+
+	const uint64_t origin = m_trace.empty() ? 0 : std::min_element(m_trace.begin(), m_trace.end(), [](const TraceEvent& a, const TraceEvent& b) {
+		return a.begin_ns < b.begin_ns;
+	})->begin_ns;
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << gpu_tid << ",\"name\":\"thread_name\",\"args\":{\"name\":\"gpu\"}}";
+	{
+		std::lock_guard lock(g_threads_mutex);
+		for (const auto& events : g_threads)
+		{
+			out << ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":" << events->tid << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+			write_json_string(out, events->name);
+			out << "}}";
+		}
+	}
+
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	for (const auto& event : m_trace)
+	{
+		out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << event.tid << ",\"name\":";
+		write_json_string(out, event.name);
+		out << ",\"ts\":" << (event.begin_ns - origin) * 1e-3 << ",\"dur\":" << event.duration_ns * 1e-3 << "}";
+	}
+	out << "\n]}\n";
+
+	spdlog::info("Wrote {} trace events to {}", m_trace.size(), m_settings.trace_path);
+}
@@ -0,0 +1,209 @@
+#include "program_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fmt/core.h>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include "hash.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+
+constexpr uint32_t entry_magic = 0x4e42474c; // "LGBN"
+
+struct EntryHeader
+{
+	uint32_t magic;
+	uint32_t format; // The GLenum glGetProgramBinary returned
+	uint64_t key;
+	uint64_t size;   // Bytes of binary following the header
+};
+
+static auto gl_string(GLenum name) -> std::string_view
+{
+	const auto* str = reinterpret_cast<const char*>(glGetString(name));
+	return str ? str : "";
+}
+
+ProgramCache::ProgramCache(const Settings& settings)
+	: m_settings(settings)
+{
+	int32_t format_count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+	if (format_count == 0)
+	{
+		spdlog::info("Driver has no program binary formats, shader cache disabled");
+		return;
+	}
+
+	std::error_code ec;
+	fs::create_directories(m_settings.directory, ec);
+	if (ec)
+	{
+		spdlog::warn("Failed to create shader cache directory {}: {}", m_settings.directory.string(), ec.message());
+		return;
+	}
+
+	// '\n' separators so adjacent strings can't run together into the same hash
+	using namespace std::string_view_literals;
+	uint64_t hash = fnv1a(gl_string(GL_VENDOR));
+	hash = fnv1a("\n"sv, hash);
+	hash = fnv1a(gl_string(GL_RENDERER), hash);
+	hash = fnv1a("\n"sv, hash);
+	hash = fnv1a(gl_string(GL_VERSION), hash);
+	m_driver_hash = hash;
+	m_enabled = true;
+
+	evict();
+}
+
+auto ProgramCache::key(const char* vert_src, const char* frag_src) const noexcept -> uint64_t
+{
+	uint64_t hash = fnv1a(std::string_view(vert_src), m_driver_hash);
+	hash = fnv1a(std::string_view("\0", 1), hash);
+	return fnv1a(std::string_view(frag_src), hash);
+}
+
+auto ProgramCache::entry_path(uint64_t key) const -> fs::path
+{
+	return m_settings.directory / fmt::format("{:016x}.bin", key);
+}
+
+auto ProgramCache::load(uint32_t program, uint64_t key) -> bool
+{
+	if (!m_enabled)
+		return false;
+
+	const auto path = entry_path(key);
+	MappedFile file;
+	if (!file.open(path.string().c_str()))
+	{
+		m_stats.misses++;
+		return false;
+	}
+
+	EntryHeader header{};
+	if (file.size() >= sizeof(header))
+		std::memcpy(&header, file.data(), sizeof(header));
+
+	bool linked = false;
+	if (header.magic == entry_magic && header.key == key && header.size == file.size() - sizeof(header))
+	{
+		glProgramBinary(program, header.format, file.data() + sizeof(header), static_cast<GLsizei>(header.size));
+
+		int32_t link_status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+		linked = link_status == GL_TRUE;
+	}
+
+	std::error_code ec;
+	if (!linked)
+	{
+		// Truncated, or built by a driver that no longer accepts it, the caller recompiles and overwrites it
+		m_stats.rejected++;
+		m_stats.misses++;
+		return false;
+	}
+
+	// Modification time doubles as the last use time for eviction
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+	m_stats.hits++;
+	return true;
+}
+
+void ProgramCache::store(uint32_t program, uint64_t key)
+{
+	if (!m_enabled)
+		return;
+
+	int32_t length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<uint8_t> data(sizeof(EntryHeader) + length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, data.data() + sizeof(EntryHeader));
+
+	const EntryHeader header{ entry_magic, format, key, static_cast<uint64_t>(length) };
+	std::memcpy(data.data(), &header, sizeof(header));
+
+	// Written aside and renamed so a crash mid write never leaves a torn entry
+	const auto path = entry_path(key);
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(sizeof(header) + length));
+		if (!out)
+		{
+			spdlog::warn("Failed to write shader cache entry {}", temp_path.string());
+			return;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(temp_path, path, ec);
+	if (ec)
+		spdlog::warn("Failed to write shader cache entry {}: {}", path.string(), ec.message());
+}
+
+// Drops entries unused for longer than max_age, then the least recently used until the cache fits max_bytes
+void ProgramCache::evict()
+{
+	struct Entry
+	{
+		fs::path path;
+		fs::file_time_type last_used;
+		uint64_t size;
+	};
+
+	std::error_code ec;
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+	const auto now = fs::file_time_type::clock::now();
+	size_t removed = 0;
+
+	for (const auto& item : fs::directory_iterator(m_settings.directory, ec))
+	{
+		if (!item.is_regular_file(ec))
+			continue;
+
+		Entry entry{ item.path(), item.last_write_time(ec), item.file_size(ec) };
+		if (ec)
+			continue;
+
+		// Leftover temp files are from a store that never finished
+		if (entry.path.extension() != ".bin" || now - entry.last_used > m_settings.max_age)
+		{
+			removed += fs::remove(entry.path, ec) ? 1 : 0;
+			continue;
+		}
+
+		total += entry.size;
+		entries.push_back(std::move(entry));
+	}
+
+	if (total > m_settings.max_bytes)
+	{
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+		for (const auto& entry : entries)
+		{
+			if (total <= m_settings.max_bytes)
+				break;
+			if (fs::remove(entry.path, ec))
+			{
+				total -= entry.size;
+				removed++;
+			}
+		}
+	}
+
+	if (removed > 0)
+		spdlog::info("Evicted {} shader cache entries, {:.1f} KiB left", removed, total / 1024.0);
+}
@@ -0,0 +1,207 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <fmt/core.h>
+#include "gl_error.h"
+#include "gl_state.h"
+#include "gl_extensions.h"
+
+constexpr uint32_t id_bits = 12;
+constexpr uint64_t id_mask = (1u << id_bits) - 1;
+constexpr uint32_t depth_bits = 24;
+constexpr uint64_t depth_max = (1u << depth_bits) - 1;
+
+void radix_sort_keys(uint64_t* keys, uint32_t* values, size_t count, uint64_t* scratch_keys, uint32_t* scratch_values)
+{
+	// One read to build all eight histograms
+	std::array<std::array<uint32_t, 256>, 8> histograms{};
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint64_t key = keys[i];
+		for (uint32_t pass = 0; pass < 8; pass++)
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	uint64_t* src_keys = keys;
+	uint32_t* src_values = values;
+	uint64_t* dst_keys = scratch_keys;
+	uint32_t* dst_values = scratch_values;
+	for (uint32_t pass = 0; pass < 8; pass++)
+	{
+		auto& histogram = histograms[pass];
+		const uint32_t shift = pass * 8;
+
+		// Every key has the same byte here, e.g. the unused layer bits
+		if (histogram[(src_keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (auto& bucket : histogram)
+		{
+			const uint32_t size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t slot = histogram[(src_keys[i] >> shift) & 0xFF]++;
+			dst_keys[slot] = src_keys[i];
+			dst_values[slot] = src_values[i];
+		}
+		std::swap(src_keys, dst_keys);
+		std::swap(src_values, dst_values);
+	}
+
+	if (src_keys != keys)
+	{
+		std::memcpy(keys, src_keys, count * sizeof(uint64_t));
+		std::memcpy(values, src_values, count * sizeof(uint32_t));
+	}
+}
+
+static_assert(std::is_trivially_copyable_v<RenderQueue::Draw>, "draws are copied into raw pool pages");
+
+RenderQueue::~RenderQueue()
+{
+	release_pages();
+}
+
+void RenderQueue::release_pages() noexcept
+{
+	for (Draw* page : m_pages)
+		m_page_pool->free_block(page);
+	m_pages.clear();
+}
+
+void RenderQueue::begin_frame(FrameArena& arena)
+{
+	if (m_frame)
+		m_last_draw_count = m_frame->draw_count;
+	release_pages();
+
+	// The old arrays point into memory the arena handed out again, they are dropped unread
+	m_frame.emplace(&arena);
+	m_frame->keys.reserve(m_last_draw_count);
+	m_frame->order.reserve(m_last_draw_count);
+}
+
+auto RenderQueue::dense_id(std::vector<uint32_t>& names, uint32_t name) -> uint64_t
+{
+	// A handful of programs and vaos, a linear search beats hashing
+	const auto it = std::find(names.begin(), names.end(), name);
+	if (it != names.end())
+		return static_cast<uint64_t>(it - names.begin());
+
+	if (names.size() > id_mask)
+		throw gl_error(fmt::format("Render queue supports at most {} programs and vaos", id_mask + 1));
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+auto RenderQueue::add_texture_set(std::initializer_list<uint32_t> textures) -> uint32_t
+{
+	if (textures.size() > max_textures)
+		throw gl_error(fmt::format("Texture sets hold at most {} textures", max_textures));
+	auto& texture_sets = m_frame->texture_sets;
+	if (texture_sets.size() > id_mask)
+		throw gl_error(fmt::format("Render queue supports at most {} texture sets per frame", id_mask + 1));
+
+	TextureSet set{};
+	std::copy(textures.begin(), textures.end(), set.begin());
+	texture_sets.push_back(set);
+	return static_cast<uint32_t>(texture_sets.size() - 1);
+}
+
+void RenderQueue::submit(const Draw& draw)
+{
+	const uint64_t depth = static_cast<uint64_t>(std::clamp(draw.depth, 0.0f, 1.0f) * depth_max);
+	const uint64_t key =
+		(uint64_t(draw.layer & 0xF) << 60) |
+		(dense_id(m_programs, draw.program) << 48) |
+		(uint64_t(draw.texture_set & id_mask) << 36) |
+		(dense_id(m_vaos, draw.vao) << 24) |
+		depth;
+
+	auto& frame = *m_frame;
+	const uint32_t index = frame.draw_count;
+	if (index % draws_per_page == 0)
+	{
+		// Every page of a frame comes from the same pool, the one release_pages() returns them to
+		if (m_pages.empty())
+			m_page_pool = &thread_pool<DrawPage>();
+		m_pages.push_back(static_cast<Draw*>(m_page_pool->allocate_block()));
+	}
+	m_pages.back()[index % draws_per_page] = draw;
+
+	frame.keys.push_back(key);
+	frame.order.push_back(index);
+	frame.draw_count++;
+}
+
+void RenderQueue::sort()
+{
+	auto& frame = *m_frame;
+	const size_t count = frame.keys.size();
+	if (count < 2)
+		return;
+
+	frame.scratch_keys.resize(count);
+	frame.scratch_order.resize(count);
+	radix_sort_keys(frame.keys.data(), frame.order.data(), count, frame.scratch_keys.data(), frame.scratch_order.data());
+}
+
+auto RenderQueue::execute(const StreamBuffer& ring) const -> Stats
+{
+	// gl_state drops binds that are already in place, the stats count the ones that weren't
+	Stats stats;
+	if (!m_frame)
+		return stats;
+
+	for (const uint32_t index : m_frame->order)
+	{
+		const auto& draw = draw_at(index);
+
+		if (gl_state.use_program(draw.program))
+			stats.program_switches++;
+		if (gl_state.bind_vertex_array(draw.vao))
+			stats.vao_switches++;
+
+		const auto& set = m_frame->texture_sets[draw.texture_set];
+		for (uint32_t unit = 0; unit < max_textures; unit++)
+		{
+			if (set[unit] != 0 && gl_state.bind_texture_unit(unit, set[unit]))
+				stats.texture_binds++;
+		}
+
+		if (draw.object.size != 0)
+			ring.bind(GL_UNIFORM_BUFFER, 1, draw.object);
+		if (draw.instances.size != 0)
+			ring.bind(GL_SHADER_STORAGE_BUFFER, 0, draw.instances);
+
+		if (draw.indirect.buffer != 0)
+		{
+			gl_state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, draw.indirect.buffer);
+			const auto* commands = reinterpret_cast<const void*>(draw.indirect.offset);
+			if (draw.indirect.parameter_buffer != 0 && gl_extensions.indirect_parameters)
+			{
+				gl_state.bind_buffer(GL_PARAMETER_BUFFER, draw.indirect.parameter_buffer);
+				gl_extensions.multi_draw_elements_indirect_count(GL_TRIANGLES, draw.index_type, commands,
+					static_cast<GLintptr>(draw.indirect.parameter_offset), static_cast<GLsizei>(draw.indirect.draw_count), 0);
+			}
+			else
+			{
+				glMultiDrawElementsIndirect(GL_TRIANGLES, draw.index_type, commands, static_cast<GLsizei>(draw.indirect.draw_count), 0);
+			}
+		}
+		else if (draw.instance_count == 1)
+			glDrawElements(GL_TRIANGLES, draw.index_count, draw.index_type, nullptr);
+		else
+			glDrawElementsInstanced(GL_TRIANGLES, draw.index_count, draw.index_type, nullptr, draw.instance_count);
+		stats.draws++;
+	}
+
+	return stats;
+}
@@ -0,0 +1,82 @@
+#include "scene.h"
+
+#include <algorithm>
+
+constexpr glm::vec3 cubePositions[]{
+	glm::vec3( 0.0f,  0.0f,  0.0f),
+	glm::vec3( 2.0f,  5.0f, -15.0f),
+	glm::vec3(-1.5f, -2.2f, -2.5f),
+	glm::vec3(-3.8f, -2.0f, -12.3f),
+	glm::vec3( 2.4f, -0.4f, -3.5f),
+	glm::vec3(-1.7f,  3.0f, -7.5f),
+	glm::vec3( 1.3f, -2.0f, -2.5f),
+	glm::vec3( 1.5f,  2.0f, -2.5f),
+	glm::vec3( 1.5f,  0.2f, -1.5f),
+	glm::vec3(-1.3f,  1.0f, -1.5f)
+};
+constexpr uint32_t hand_placed_count = sizeof(cubePositions) / sizeof(cubePositions[0]);
+
+constexpr float_t grid_spacing = 3.0f;
+
+static auto grid_size(uint32_t count) -> uint32_t
+{
+	return static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+}
+
+// Cheap integer hash so the layout is identical between runs
+static auto jitter(uint32_t i) -> float_t
+{
+	i ^= i >> 16;
+	i *= 0x7feb352dU;
+	i ^= i >> 15;
+	i *= 0x846ca68bU;
+	i ^= i >> 16;
+	return (static_cast<float_t>(i & 0xffff) / 65535.0f - 0.5f) * grid_spacing * 0.5f;
+}
+
+auto make_cube_positions(uint32_t count) -> std::vector<glm::vec3>
+{
+	std::vector<glm::vec3> positions;
+	positions.reserve(count);
+
+	for (uint32_t i = 0; i < std::min(count, hand_placed_count); i++)
+	{
+		positions.push_back(cubePositions[i]);
+	}
+
+	if (count <= hand_placed_count)
+		return positions;
+
+	const uint32_t n = grid_size(count);
+	const float_t offset = (n - 1) * grid_spacing * 0.5f;
+	for (uint32_t i = hand_placed_count; i < count; i++)
+	{
+		const uint32_t x = i % n;
+		const uint32_t y = (i / n) % n;
+		const uint32_t z = i / (n * n);
+		positions.emplace_back(
+			x * grid_spacing - offset + jitter(i * 3 + 0),
+			y * grid_spacing - offset + jitter(i * 3 + 1),
+			z * grid_spacing - offset + jitter(i * 3 + 2));
+	}
+
+	return positions;
+}
+
+auto scene_extent(uint32_t count) -> float_t
+{
+	// Covers the hand placed cubes, the furthest of which sits at z = -15
+	float_t extent = 16.0f;
+	if (count > hand_placed_count)
+	{
+		extent = std::max(extent, grid_size(count) * grid_spacing * 0.5f + grid_spacing);
+	}
+	return extent;
+}
+
+auto orbit_radius(uint32_t count) -> float_t
+{
+	if (count <= hand_placed_count)
+		return 10.0f;
+	return std::max(10.0f, scene_extent(count) * 2.0f);
+}
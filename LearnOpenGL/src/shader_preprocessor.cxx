@@ -0,0 +1,141 @@
+#include "shader_preprocessor.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include "file.h"
+#include "text_scan.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// The name in #include "name" or #include <name>, empty when the line is something else
+auto include_name(std::string_view line) noexcept -> std::string_view
+{
+	size_t pos = skip_spaces(line, 0);
+	if (pos == line.size() || line[pos] != '#')
+		return {};
+	pos = skip_spaces(line, pos + 1);
+
+	constexpr std::string_view directive = "include";
+	if (line.substr(pos, directive.size()) != directive)
+		return {};
+	pos = skip_spaces(line, pos + directive.size());
+
+	if (pos == line.size() || (line[pos] != '"' && line[pos] != '<'))
+		return {};
+	const char close = line[pos] == '"' ? '"' : '>';
+	const size_t end = line.find(close, pos + 1);
+	if (end == std::string_view::npos)
+		return {};
+	return line.substr(pos + 1, end - pos - 1);
+}
+
+}
+
+auto ShaderPreprocessor::file(const fs::path& path, std::string& error) -> const File*
+{
+	std::error_code ec;
+	const auto write_time = fs::last_write_time(path, ec);
+	if (ec)
+	{
+		error = fmt::format("can't open {}: {}", path.string(), ec.message());
+		return nullptr;
+	}
+
+	auto [it, inserted] = m_files.try_emplace(path.string());
+	auto& file = it->second;
+	if (!inserted && file.write_time == write_time)
+	{
+		m_stats.hits++;
+		return &file;
+	}
+
+	// Copied out rather than mapped, editors often rewrite shaders in place
+	auto text = read_file(path, ec);
+	if (ec)
+	{
+		m_files.erase(it);
+		error = fmt::format("can't read {}: {}", path.string(), ec.message());
+		return nullptr;
+	}
+	m_stats.reads++;
+
+	file.text = std::move(text);
+	file.write_time = write_time;
+	file.includes.clear();
+
+	for_each_line(file.text, [&](std::string_view line, size_t begin, uint32_t number) {
+		// Cheap reject first, nearly every line starts with something else
+		const size_t first = skip_spaces(line, 0);
+		if (first < line.size() && line[first] == '#')
+		{
+			const auto name = include_name(line);
+			if (!name.empty())
+				file.includes.push_back({ begin, begin + line.size(), number, (path.parent_path() / name).lexically_normal() });
+		}
+		return true;
+	});
+	return &file;
+}
+
+auto ShaderPreprocessor::expand(const fs::path& path, Source& source, std::string& error) -> bool
+{
+	const File* file = this->file(path, error);
+	if (!file)
+		return false;
+
+	const auto index = static_cast<uint32_t>(source.files.size());
+	source.files.push_back(path);
+
+	size_t pos = 0;
+	for (const auto& include : file->includes)
+	{
+		source.text.append(file->text, pos, include.begin - pos);
+		pos = include.end;
+
+		// Already pasted, the blank line keeps the numbering
+		if (std::find(source.files.begin(), source.files.end(), include.path) != source.files.end())
+		{
+			source.text += '\n';
+			continue;
+		}
+
+		fmt::format_to(std::back_inserter(source.text), "#line 1 {}\n", source.files.size());
+		if (!expand(include.path, source, error))
+		{
+			error = fmt::format("{}({}): {}", path.string(), include.line, error);
+			return false;
+		}
+		if (!source.text.empty() && source.text.back() != '\n')
+			source.text += '\n';
+		fmt::format_to(std::back_inserter(source.text), "#line {} {}\n", include.line + 1, index);
+	}
+	source.text.append(file->text, pos, std::string::npos);
+	return true;
+}
+
+auto ShaderPreprocessor::load(const fs::path& path) -> std::optional<Source>
+{
+	Source source;
+	std::string error;
+	if (!expand(path.lexically_normal(), source, error))
+	{
+		spdlog::error("Failed to load shader {}: {}", path.string(), error);
+		return std::nullopt;
+	}
+	return source;
+}
+
+auto ShaderPreprocessor::describe_files(const std::vector<fs::path>& files) -> std::string
+{
+	std::string out;
+	for (size_t i = 0; i < files.size(); i++)
+		fmt::format_to(std::back_inserter(out), "{}{}: {}", i == 0 ? "" : ", ", i, files[i].string());
+	return out;
+}
@@ -1,12 +1,12 @@
 #include "shader_program.h"
 
-#include <vector>
-#include <stdexcept>
+#include <utility>
 #include <glad/glad.h>
 #include <fmt/core.h>
 #include <spdlog/spdlog.h>
-#include "file.h"
 #include "gl_error.h"
+#include "program_cache.h"
+#include "gl_state.h"
 
 
 // ShaderProgram members return codes
@@ -18,12 +18,51 @@
 // -11: Error compiling shader
 // -12: Error linking program
 
-ShaderProgram::~ShaderProgram() noexcept { glDeleteProgram(id); }
+ShaderProgram::~ShaderProgram() noexcept
+{
+    if (id == 0)
+        return;
+    gl_state.forget_program(id);
+    glDeleteProgram(id);
+}
+
+ShaderProgram::ShaderProgram(ShaderProgram&& other) noexcept
+    : m_uniforms(std::move(other.m_uniforms)), id(std::exchange(other.id, 0))
+{
+}
+
+ShaderProgram& ShaderProgram::operator=(ShaderProgram&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (id != 0)
+        {
+            gl_state.forget_program(id);
+            glDeleteProgram(id);
+        }
+        m_uniforms = std::move(other.m_uniforms);
+        id = std::exchange(other.id, 0);
+    }
+    return *this;
+}
 
-ShaderProgram::ShaderProgram(const char* vert_src, const char* frag_src)
+ShaderProgram::ShaderProgram(const char* vert_src, const char* frag_src, ProgramCache* cache)
 {
     id = glCreateProgram();
 
+    uint64_t cache_key = 0;
+    if (cache && cache->enabled())
+    {
+        cache_key = cache->key(vert_src, frag_src);
+        if (cache->load(id, cache_key))
+        {
+            m_uniforms = UniformTable::reflect(id);
+            return;
+        }
+
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     uint32_t vert_shader;
     uint32_t frag_shader;
 
@@ -55,98 +94,81 @@ ShaderProgram::ShaderProgram(const char* vert_src, const char* frag_src)
     glGetProgramiv(id, GL_LINK_STATUS, &link_status);
     if (link_status == GL_FALSE)
     {
-        int info_log_len;
-        glGetProgramiv(id, GL_INFO_LOG_LENGTH, &info_log_len);
-
-        std::vector<char> info_log(info_log_len);
-        glGetProgramInfoLog(id, info_log_len, &info_log_len, &info_log[0]);
-
-        std::string info_log_str(info_log.begin(), info_log.end());
-
-        write_file("info.log", info_log_str.c_str());
-
+        spdlog::error("Program {} failed to link:\n{}", id, program_info_log(id));
         throw gl_error(fmt::format("Error linking program {}", id));
     }
-}
 
-void ShaderProgram::use() noexcept { glUseProgram(id); }
+    if (cache && cache->enabled())
+        cache->store(id, cache_key);
 
-// throw gl_error(fmt::format("Uniform {} not found", name));
+    m_uniforms = UniformTable::reflect(id);
+}
 
-void ShaderProgram::setUniform(const char* name, std::vector<float_t> value)
+ShaderProgram::ShaderProgram(const char* comp_src)
 {
-    if(value.empty())
-    {
-        throw std::invalid_argument("Not enough elements in vertex");
+    id = glCreateProgram();
+
+    uint32_t comp_shader;
+    try {
+        comp_shader = make_shader(comp_src, GL_COMPUTE_SHADER);
     }
-    else if (value.size() > 4)
-    {
-        throw std::invalid_argument("too many elements, max is 4");
+    catch (gl_error&){
+        throw gl_error(fmt::format("Error compiling compute shader for program {}", id));
     }
 
-    if(!m_uniforms.contains(name))
-    {
-        auto uniform = glGetUniformLocation(id, name);
-        if (uniform == -1)
-        {
-            throw gl_error(fmt::format("Uniform {} not found", name));
-        }
-        m_uniforms.insert({name, uniform});
-    }
+    glAttachShader(id, comp_shader);
+    glLinkProgram(id);
+    glDetachShader(id, comp_shader);
+    glDeleteShader(comp_shader);
 
-    switch (value.size())
+    int link_status;
+    glGetProgramiv(id, GL_LINK_STATUS, &link_status);
+    if (link_status == GL_FALSE)
     {
-    case 1:
-        glUniform1f(m_uniforms.at(name), value[0]);
-        break;
-    case 2:
-        glUniform2f(m_uniforms.at(name), value[0], value[1]);
-        break;
-    case 3:
-        glUniform3f(m_uniforms.at(name), value[0], value[1], value[2]);
-        break;
-    case 4:
-        glUniform4f(m_uniforms.at(name), value[0], value[1], value[2], value[3]);
-        break;
+        spdlog::error("Program {} failed to link:\n{}", id, program_info_log(id));
+        throw gl_error(fmt::format("Error linking program {}", id));
     }
+
+    m_uniforms = UniformTable::reflect(id);
 }
 
-void ShaderProgram::setUniform(const char* name, std::vector<int32_t> value)
+ShaderProgram::ShaderProgram(uint32_t linked_program)
+    : m_uniforms(UniformTable::reflect(linked_program)), id(linked_program)
 {
-    if(value.empty())
-    {
-        throw std::invalid_argument("Not enough elements in vector");
-    }
-    else if(value.size() > 4)
-    {
-        throw std::invalid_argument("too many elements, max is 4");
-    }
+}
 
-    if(!m_uniforms.contains(name))
-    {
-        auto uniform = glGetUniformLocation(id, name);
-        if (uniform == -1)
-        {
-            throw gl_error(fmt::format("Uniform {} not found", name));
-        }
-        m_uniforms.insert({name, uniform});
-    }
+void ShaderProgram::use() noexcept { gl_state.use_program(id); }
 
-    switch (value.size())
-    {
-    case 1:
-        glUniform1i(m_uniforms.at(name), value[0]);
-        break;
-    case 2:
-        glUniform2i(m_uniforms.at(name), value[0], value[1]);
-        break;
-    case 3:
-        glUniform3i(m_uniforms.at(name), value[0], value[1], value[2]);
-        break;
-    case 4:
-        glUniform4i(m_uniforms.at(name), value[0], value[1], value[2], value[3]);
-        break;
-    }
+void ShaderProgram::adopt(uint32_t program)
+{
+    gl_state.forget_program(id);
+    glDeleteProgram(id);
+    id = program;
+    m_uniforms = UniformTable::reflect(id);
+}
+
+auto shader_info_log(uint32_t shader) -> std::string
+{
+    int info_log_len = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_len);
+
+    std::string info_log(static_cast<size_t>(info_log_len), '\0');
+    if (info_log_len > 0)
+        glGetShaderInfoLog(shader, info_log_len, &info_log_len, info_log.data());
+    info_log.resize(static_cast<size_t>(info_log_len));
+    return info_log;
+}
+
+auto program_info_log(uint32_t program) -> std::string
+{
+    int info_log_len = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_len);
+
+    std::string info_log(static_cast<size_t>(info_log_len), '\0');
+    if (info_log_len > 0)
+        glGetProgramInfoLog(program, info_log_len, &info_log_len, info_log.data());
+    info_log.resize(static_cast<size_t>(info_log_len));
+    return info_log;
 }
 
 auto make_shader(const char* src, uint32_t type) -> uint32_t
@@ -160,15 +182,9 @@ auto make_shader(const char* src, uint32_t type) -> uint32_t
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
     if (compile_status == GL_FALSE)
     {
-        int info_log_len = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_len);
-
-        std::vector<char> info_log(info_log_len);
-        glGetShaderInfoLog(shader, info_log_len, &info_log_len, &info_log[0]);
-
-        std::string info_log_str(info_log.begin(), info_log.end());
-
-        write_file("info.log", info_log_str.c_str());
+        const char* stage = type == GL_VERTEX_SHADER ? "vertex" : type == GL_FRAGMENT_SHADER ? "fragment" : "compute";
+        spdlog::error("Failed to compile {} shader:\n{}", stage, shader_info_log(shader));
+        glDeleteShader(shader);
         throw gl_error("Failed to compile shader");
     }
 
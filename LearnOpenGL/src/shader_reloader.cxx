@@ -0,0 +1,253 @@
+#include "shader_reloader.h"
+
+#include <algorithm>
+#include <string>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include "gl_extensions.h"
+#include "program_cache.h"
+#include "profiler.h"
+
+namespace fs = std::filesystem;
+
+// Without the parallel compile extension every query blocks until the driver is done anyway
+static auto shader_complete(uint32_t shader) -> bool
+{
+	if (!gl_extensions.parallel_shader_compile)
+		return true;
+
+	int32_t status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPLETION_STATUS_KHR, &status);
+	return status == GL_TRUE;
+}
+
+static auto program_complete(uint32_t program) -> bool
+{
+	if (!gl_extensions.parallel_shader_compile)
+		return true;
+
+	int32_t status = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &status);
+	return status == GL_TRUE;
+}
+
+ShaderReloader::ShaderReloader(const fs::path& directory, ShaderPreprocessor& preprocessor, ProgramCache* cache)
+	: m_watcher(directory), m_preprocessor(&preprocessor), m_cache(cache)
+{
+	spdlog::info("Watching {} for shader changes, parallel compile {}",
+		directory.string(), gl_extensions.parallel_shader_compile ? "available" : "unavailable");
+}
+
+ShaderReloader::~ShaderReloader() noexcept
+{
+	for (auto& build : m_builds)
+		discard(build);
+}
+
+void ShaderReloader::watch(ShaderProgram& program, const fs::path& vert_path, const fs::path& frag_path, ReloadCallback on_reload)
+{
+	Watched watched;
+	watched.program = &program;
+	watched.vert_path = vert_path.lexically_normal();
+	watched.frag_path = frag_path.lexically_normal();
+	watched.on_reload = std::move(on_reload);
+
+	// Both were just loaded for the program itself, so this only finds out what they include
+	if (auto vert = load(watched, GL_VERTEX_SHADER))
+		watched.vert_files = std::move(vert->files);
+	if (auto frag = load(watched, GL_FRAGMENT_SHADER))
+		watched.frag_files = std::move(frag->files);
+	m_watched.push_back(std::move(watched));
+}
+
+void ShaderReloader::watch(ShaderVariants& variants, ShaderVariants::Mask mask, ReloadCallback on_reload)
+{
+	Watched watched;
+	watched.program = &variants.get(mask);
+	watched.vert_path = variants.vert_path();
+	watched.frag_path = variants.frag_path();
+	watched.on_reload = std::move(on_reload);
+	watched.variants = &variants;
+	watched.mask = mask;
+
+	if (auto vert = load(watched, GL_VERTEX_SHADER))
+		watched.vert_files = std::move(vert->files);
+	if (auto frag = load(watched, GL_FRAGMENT_SHADER))
+		watched.frag_files = std::move(frag->files);
+	m_watched.push_back(std::move(watched));
+}
+
+auto ShaderReloader::load(const Watched& watched, uint32_t type) -> std::optional<ShaderPreprocessor::Source>
+{
+	if (watched.variants)
+		return watched.variants->source(type, watched.mask);
+	return m_preprocessor->load(type == GL_VERTEX_SHADER ? watched.vert_path : watched.frag_path);
+}
+
+static auto uses(const std::vector<fs::path>& files, const fs::path& path) -> bool
+{
+	return std::find(files.begin(), files.end(), path) != files.end();
+}
+
+void ShaderReloader::update()
+{
+	PROFILE_CPU("shader reload");
+	for (const auto& changed : m_watcher.poll())
+	{
+		const auto path = changed.lexically_normal();
+		for (size_t i = 0; i < m_watched.size(); i++)
+		{
+			const auto& watched = m_watched[i];
+			if (watched.vert_path != path && watched.frag_path != path && !uses(watched.vert_files, path) && !uses(watched.frag_files, path))
+				continue;
+
+			// A newer save supersedes a build that hasn't finished yet
+			auto running = std::find_if(m_builds.begin(), m_builds.end(), [i](const Build& build) { return build.watched == i; });
+			if (running != m_builds.end())
+			{
+				discard(*running);
+				m_builds.erase(running);
+			}
+			start(i);
+		}
+	}
+
+	for (size_t i = 0; i < m_builds.size();)
+	{
+		if (advance(m_builds[i]))
+			m_builds.erase(m_builds.begin() + static_cast<std::ptrdiff_t>(i));
+		else
+			i++;
+	}
+}
+
+void ShaderReloader::start(size_t watched)
+{
+	auto& target = m_watched[watched];
+	const auto start_time = clock::now();
+
+	// An editor may be halfway through saving, the next change event retries
+	const auto vert = load(target, GL_VERTEX_SHADER);
+	const auto frag = load(target, GL_FRAGMENT_SHADER);
+	if (!vert || !frag)
+	{
+		spdlog::warn("Keeping program {}", target.program->id);
+		return;
+	}
+	target.vert_files = vert->files;
+	target.frag_files = frag->files;
+
+	Build build{ watched, Stage::Compiling, glCreateProgram(), 0, 0, 0, 0, start_time };
+	if (target.variants)
+		build.variant_key = ShaderVariants::program_key(vert->text, frag->text);
+
+	// Reverting an edit usually lands on a binary that is still cached
+	if (m_cache && m_cache->enabled())
+	{
+		build.cache_key = m_cache->key(vert->text.c_str(), frag->text.c_str());
+		if (m_cache->load(build.program, build.cache_key))
+		{
+			finish(build, "from cache");
+			return;
+		}
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	const char* vert_str = vert->text.c_str();
+	const char* frag_str = frag->text.c_str();
+	build.vert = glCreateShader(GL_VERTEX_SHADER);
+	build.frag = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.vert, 1, &vert_str, nullptr);
+	glShaderSource(build.frag, 1, &frag_str, nullptr);
+	glCompileShader(build.vert);
+	glCompileShader(build.frag);
+
+	m_builds.push_back(build);
+}
+
+// Returns true once the build is over, successful or not
+auto ShaderReloader::advance(Build& build) -> bool
+{
+	const auto& target = m_watched[build.watched];
+
+	if (build.stage == Stage::Compiling)
+	{
+		if (!shader_complete(build.vert) || !shader_complete(build.frag))
+			return false;
+
+		bool compiled = true;
+		for (const auto& [shader, files] : { std::pair{ build.vert, &target.vert_files }, std::pair{ build.frag, &target.frag_files } })
+		{
+			int32_t status = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			if (status == GL_FALSE)
+			{
+				spdlog::error("Failed to compile {}, keeping program {}:\n{}", ShaderPreprocessor::describe_files(*files), target.program->id, shader_info_log(shader));
+				compiled = false;
+			}
+		}
+		if (!compiled)
+		{
+			discard(build);
+			return true;
+		}
+
+		glAttachShader(build.program, build.vert);
+		glAttachShader(build.program, build.frag);
+		glLinkProgram(build.program);
+		glDetachShader(build.program, build.vert);
+		glDetachShader(build.program, build.frag);
+		glDeleteShader(build.vert);
+		glDeleteShader(build.frag);
+		build.vert = 0;
+		build.frag = 0;
+		build.stage = Stage::Linking;
+		return false;
+	}
+
+	if (!program_complete(build.program))
+		return false;
+
+	int32_t status = GL_FALSE;
+	glGetProgramiv(build.program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE)
+	{
+		spdlog::error("Failed to link {} + {}, keeping program {}:\n{}",
+			target.vert_path.string(), target.frag_path.string(), target.program->id, program_info_log(build.program));
+		discard(build);
+		return true;
+	}
+
+	if (m_cache && m_cache->enabled())
+		m_cache->store(build.program, build.cache_key);
+
+	finish(build, "compiled");
+	return true;
+}
+
+void ShaderReloader::finish(const Build& build, const char* how)
+{
+	auto& target = m_watched[build.watched];
+	const uint32_t old_id = target.program->id;
+
+	target.program->adopt(build.program);
+	if (target.variants)
+		target.variants->relinked(*target.program, build.variant_key);
+	if (target.on_reload)
+		target.on_reload(*target.program);
+
+	spdlog::info("Reloaded {} + {} ({}) in {:.1f} ms, program {} -> {}",
+		target.vert_path.string(), target.frag_path.string(), how,
+		std::chrono::duration<double, std::milli>(clock::now() - build.start).count(),
+		old_id, build.program);
+}
+
+void ShaderReloader::discard(Build& build) noexcept
+{
+	if (build.vert)
+		glDeleteShader(build.vert);
+	if (build.frag)
+		glDeleteShader(build.frag);
+	glDeleteProgram(build.program);
+	build = {};
+}
@@ -0,0 +1,319 @@
+#include "shader_variants.h"
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+#include <fmt/format.h>
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include "gl_error.h"
+#include "hash.h"
+#include "program_cache.h"
+#include "text_scan.h"
+
+namespace fs = std::filesystem;
+
+constexpr uint32_t max_keywords = 32;
+
+namespace
+{
+
+// What follows "#<directive>" on line, nullopt when the line is something else
+auto directive_args(std::string_view line, std::string_view directive) noexcept -> std::optional<std::string_view>
+{
+	size_t pos = skip_spaces(line, 0);
+	if (pos == line.size() || line[pos] != '#')
+		return std::nullopt;
+	pos = skip_spaces(line, pos + 1);
+	if (line.substr(pos, directive.size()) != directive)
+		return std::nullopt;
+	pos += directive.size();
+	if (pos < line.size() && !is_space(line[pos]) && line[pos] != '\n')
+		return std::nullopt;
+	return line.substr(pos);
+}
+
+auto stage_key(uint32_t type, std::string_view text) noexcept -> uint64_t
+{
+	return fnv1a(text, fnv1a_bytes(&type, sizeof(type)));
+}
+
+auto stage_name(uint32_t type) noexcept -> const char*
+{
+	return type == GL_VERTEX_SHADER ? "vertex" : "fragment";
+}
+
+auto compiled(uint32_t shader) -> bool
+{
+	int32_t status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+}
+
+ShaderVariants::ShaderVariants(ShaderPreprocessor& preprocessor, const fs::path& vert_path, const fs::path& frag_path, ProgramCache* cache)
+	: m_preprocessor(&preprocessor), m_cache(cache),
+	m_vert{ GL_VERTEX_SHADER, vert_path.lexically_normal() }, m_frag{ GL_FRAGMENT_SHADER, frag_path.lexically_normal() }
+{
+	for (const auto* stage : { &m_vert, &m_frag })
+	{
+		const auto source = m_preprocessor->load(stage->path);
+		if (!source)
+			throw gl_error(fmt::format("Failed to load {}", stage->path.string()));
+		declare(source->text);
+	}
+}
+
+ShaderVariants::~ShaderVariants() noexcept
+{
+	for (const auto& [key, shader] : m_shaders)
+		glDeleteShader(shader);
+}
+
+// Numbers the keywords text declares that haven't been seen yet, returns all of them as a mask
+auto ShaderVariants::declare(const std::string& text) -> Mask
+{
+	Mask declared = 0;
+	for_each_line(text, [&](std::string_view line, size_t, uint32_t) {
+		const auto pragma = directive_args(line, "pragma");
+		if (!pragma)
+			return true;
+		auto args = *pragma;
+		const size_t name_begin = skip_spaces(args, 0);
+		if (args.substr(name_begin, 8) != "keywords")
+			return true;
+		args.remove_prefix(name_begin + 8);
+
+		for (size_t pos = 0; pos < args.size();)
+		{
+			const size_t begin = args.find_first_not_of(" \t\r\n", pos);
+			if (begin == std::string_view::npos)
+				break;
+			const size_t end = std::min(args.find_first_of(" \t\r\n", begin), args.size());
+			const auto name = args.substr(begin, end - begin);
+			pos = end;
+
+			auto it = std::find(m_keywords.begin(), m_keywords.end(), name);
+			if (it == m_keywords.end())
+			{
+				if (m_keywords.size() == max_keywords)
+				{
+					spdlog::warn("Shader keyword {} ignored, {} and {} declare more than {}", name, m_vert.path.string(), m_frag.path.string(), max_keywords);
+					continue;
+				}
+				it = m_keywords.emplace(m_keywords.end(), name);
+			}
+			declared |= Mask(1) << (it - m_keywords.begin());
+		}
+		return true;
+	});
+	return declared;
+}
+
+auto ShaderVariants::keyword(std::string_view name) const noexcept -> Mask
+{
+	const auto it = std::find(m_keywords.begin(), m_keywords.end(), name);
+	return it == m_keywords.end() ? 0 : Mask(1) << (it - m_keywords.begin());
+}
+
+auto ShaderVariants::keyword_names(Mask mask) const -> std::string
+{
+	std::string names;
+	for (size_t i = 0; i < m_keywords.size(); i++)
+	{
+		if (mask & (Mask(1) << i))
+			fmt::format_to(std::back_inserter(names), "{}{}", names.empty() ? "" : " ", m_keywords[i]);
+	}
+	return names.empty() ? "no keywords" : names;
+}
+
+auto ShaderVariants::source(uint32_t type, Mask mask) -> std::optional<ShaderPreprocessor::Source>
+{
+	auto source = m_preprocessor->load(type == GL_VERTEX_SHADER ? m_vert.path : m_frag.path);
+	if (!source)
+		return std::nullopt;
+
+	// Only what this stage declares, so a keyword of the other stage leaves its source alone
+	const Mask defined = mask & declare(source->text);
+	if (defined == 0)
+		return source;
+
+	// #version has to stay first, the defines go right after it. Without one they lead
+	size_t insert_at = 0;
+	uint32_t next_line = 1;
+	for_each_line(source->text, [&](std::string_view line, size_t begin, uint32_t number) {
+		if (!directive_args(line, "version"))
+			return true;
+		insert_at = begin + line.size();
+		next_line = number + 1;
+		return false;
+	});
+
+	std::string defines;
+	if (insert_at > 0 && source->text[insert_at - 1] != '\n')
+		defines += '\n';
+	for (size_t i = 0; i < m_keywords.size(); i++)
+	{
+		if (defined & (Mask(1) << i))
+			fmt::format_to(std::back_inserter(defines), "#define {} 1\n", m_keywords[i]);
+	}
+	fmt::format_to(std::back_inserter(defines), "#line {} 0\n", next_line);
+	source->text.insert(insert_at, defines);
+	return source;
+}
+
+auto ShaderVariants::program_key(std::string_view vert_src, std::string_view frag_src) noexcept -> uint64_t
+{
+	const uint64_t frag_key = stage_key(GL_FRAGMENT_SHADER, frag_src);
+	return fnv1a_bytes(&frag_key, sizeof(frag_key), stage_key(GL_VERTEX_SHADER, vert_src));
+}
+
+auto ShaderVariants::prepare(Mask mask) -> std::optional<Build>
+{
+	auto vert = source(GL_VERTEX_SHADER, mask);
+	auto frag = source(GL_FRAGMENT_SHADER, mask);
+	if (!vert || !frag)
+		return std::nullopt;
+
+	Build build{ mask, std::move(*vert), std::move(*frag) };
+	build.vert_key = stage_key(GL_VERTEX_SHADER, build.vert.text);
+	build.frag_key = stage_key(GL_FRAGMENT_SHADER, build.frag.text);
+	build.program_key = fnv1a_bytes(&build.frag_key, sizeof(build.frag_key), build.vert_key);
+	return build;
+}
+
+// Compile started, not checked. The same source is compiled once for every program using it
+auto ShaderVariants::shader(const Stage& stage, const ShaderPreprocessor::Source& source, uint64_t key) -> uint32_t
+{
+	auto [it, inserted] = m_shaders.try_emplace(key, 0);
+	if (!inserted)
+	{
+		m_stats.shared_shaders++;
+		return it->second;
+	}
+
+	const char* text = source.text.c_str();
+	it->second = glCreateShader(stage.type);
+	glShaderSource(it->second, 1, &text, nullptr);
+	glCompileShader(it->second);
+	m_stats.shaders++;
+	return it->second;
+}
+
+// Every compile and link is issued before any status is read, the first query is what waits
+auto ShaderVariants::compile(std::span<Build> builds) -> bool
+{
+	const bool cached = m_cache && m_cache->enabled();
+	for (auto& build : builds)
+	{
+		// An earlier build of this batch may already make the same program
+		const bool duplicate = std::any_of(builds.data(), &build, [&build](const Build& other) { return other.program_key == build.program_key; });
+		if (duplicate || m_by_source.contains(build.program_key))
+			continue;
+
+		build.program = glCreateProgram();
+		if (cached)
+		{
+			if (m_cache->load(build.program, m_cache->key(build.vert.text.c_str(), build.frag.text.c_str())))
+				continue;
+			glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		const uint32_t vert = shader(m_vert, build.vert, build.vert_key);
+		const uint32_t frag = shader(m_frag, build.frag, build.frag_key);
+		glAttachShader(build.program, vert);
+		glAttachShader(build.program, frag);
+		glLinkProgram(build.program);
+		glDetachShader(build.program, vert);
+		glDetachShader(build.program, frag);
+	}
+
+	bool built = true;
+	for (auto& build : builds)
+	{
+		if (build.program == 0)
+			continue;
+
+		int32_t status = GL_FALSE;
+		glGetProgramiv(build.program, GL_LINK_STATUS, &status);
+		if (status == GL_FALSE)
+		{
+			// Usually a stage that didn't compile, which is the more useful log
+			bool reported = false;
+			for (const auto& [stage, source, key] : { std::tuple{ &m_vert, &build.vert, build.vert_key }, std::tuple{ &m_frag, &build.frag, build.frag_key } })
+			{
+				const uint32_t shader = m_shaders.at(key);
+				if (compiled(shader))
+					continue;
+				spdlog::error("Failed to compile the {} stage of variant {} ({}):\n{}", stage_name(stage->type),
+					keyword_names(build.mask), ShaderPreprocessor::describe_files(source->files), shader_info_log(shader));
+				reported = true;
+			}
+			if (!reported)
+			{
+				spdlog::error("Failed to link variant {} of {} + {}:\n{}", keyword_names(build.mask),
+					m_vert.path.string(), m_frag.path.string(), program_info_log(build.program));
+			}
+			glDeleteProgram(build.program);
+			built = false;
+			continue;
+		}
+
+		if (cached)
+			m_cache->store(build.program, m_cache->key(build.vert.text.c_str(), build.frag.text.c_str()));
+
+		m_programs.push_back(std::make_unique<ShaderProgram>(build.program));
+		m_by_source.emplace(build.program_key, m_programs.back().get());
+		m_stats.programs++;
+	}
+
+	// Programs made by an earlier batch or an earlier build of this one, or just now
+	for (const auto& build : builds)
+	{
+		const auto program = m_by_source.find(build.program_key);
+		if (program != m_by_source.end() && m_variants.emplace(build.mask, program->second).second)
+			m_stats.variants++;
+	}
+	return built;
+}
+
+auto ShaderVariants::get(Mask mask) -> ShaderProgram&
+{
+	mask &= all_keywords();
+	if (const auto variant = m_variants.find(mask); variant != m_variants.end())
+		return *variant->second;
+
+	prewarm({ &mask, 1 });
+	return *m_variants.at(mask);
+}
+
+void ShaderVariants::prewarm(std::span<const Mask> masks)
+{
+	std::vector<Build> builds;
+	uint32_t failed = 0;
+	for (Mask mask : masks)
+	{
+		mask &= all_keywords();
+		const bool queued = std::any_of(builds.begin(), builds.end(), [mask](const Build& build) { return build.mask == mask; });
+		if (queued || m_variants.contains(mask))
+			continue;
+
+		auto build = prepare(mask);
+		if (!build)
+		{
+			failed++;
+			continue;
+		}
+		builds.push_back(std::move(*build));
+	}
+
+	if (!compile(builds) || failed > 0)
+		throw gl_error(fmt::format("Failed to build shader variants of {} + {}", m_vert.path.string(), m_frag.path.string()));
+}
+
+void ShaderVariants::relinked(ShaderProgram& program, uint64_t program_key)
+{
+	std::erase_if(m_by_source, [&program](const auto& entry) { return entry.second == &program; });
+	m_by_source.try_emplace(program_key, &program);
+}
@@ -0,0 +1,85 @@
+#include "stream_buffer.h"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include "gl_error.h"
+
+auto StreamBuffer::binding_alignment() noexcept -> size_t
+{
+	int32_t uniform_alignment = 0;
+	int32_t storage_alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+
+	// Both are powers of two, so the larger one satisfies either target
+	return static_cast<size_t>(std::max({ uniform_alignment, storage_alignment, 16 }));
+}
+
+StreamBuffer::StreamBuffer(size_t frame_bytes, uint32_t frames)
+	: m_alignment(binding_alignment()), m_frame_count(std::clamp(frames, 1u, max_frames))
+{
+	m_frame_bytes = aligned_size(std::max<size_t>(frame_bytes, 1));
+	const size_t total = m_frame_bytes * m_frame_count;
+
+	// Persistent + coherent, filled by plain stores while the gpu reads the other regions
+	constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	m_buffer = Buffer::create(total, nullptr, flags);
+	m_mapped = static_cast<uint8_t*>(m_buffer.map_range(0, total, flags));
+
+	if (!m_mapped)
+		throw gl_error(fmt::format("Failed to map a {} byte stream buffer", total));
+
+	// Starts on the last region so the first begin_frame() lands on region 0
+	m_frame = m_frame_count - 1;
+}
+
+StreamBuffer::~StreamBuffer() noexcept
+{
+	for (auto fence : m_fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+
+	m_buffer.unmap();
+}
+
+void StreamBuffer::begin_frame()
+{
+	m_frame = (m_frame + 1) % m_frame_count;
+	m_head = 0;
+
+	auto& fence = m_fences[m_frame];
+	if (!fence)
+		return;
+
+	// Normally signaled long ago, only a gpu more than frame_count - 1 frames behind waits here
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		m_stalls++;
+		do
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void StreamBuffer::end_frame()
+{
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+auto StreamBuffer::allocate(size_t size) -> Allocation
+{
+	const size_t aligned = aligned_size(size);
+	if (m_head + aligned > m_frame_bytes)
+		throw gl_error(fmt::format("Stream buffer region of {} bytes is full, {} more requested", m_frame_bytes, size));
+
+	const size_t offset = m_frame * m_frame_bytes + m_head;
+	m_head += aligned;
+	return { m_mapped + offset, offset, size };
+}
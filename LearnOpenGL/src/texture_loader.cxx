@@ -0,0 +1,385 @@
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <spdlog/spdlog.h>
+#include "profiler.h"
+#include "gl_state.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+constexpr size_t staging_alignment = 16;
+
+static auto align_up(size_t value, size_t alignment) -> size_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static auto mip_levels(int32_t width, int32_t height) -> int32_t
+{
+	int32_t levels = 1;
+	while ((width | height) >> levels)
+		levels++;
+	return levels;
+}
+
+TextureLoader::TextureLoader(JobSystem& jobs, const Settings& settings)
+	: m_jobs(jobs), m_settings(settings), m_requests(1024), m_decoded(1024)
+{
+	// 2x2 magenta / black checker, obvious if something never finishes loading
+	constexpr uint8_t checker[] = {
+		255, 0, 255, 255,   0, 0, 0, 255,
+		  0, 0,   0, 255, 255, 0, 255, 255,
+	};
+	m_placeholder = Texture::create(GL_TEXTURE_2D);
+	m_placeholder.storage_2d(1, GL_RGBA8, 2, 2);
+	m_placeholder.sub_image_2d(0, 2, 2, GL_RGBA, GL_UNSIGNED_BYTE, checker);
+	m_placeholder.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	m_placeholder.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// Persistent + coherent, written by memcpy and read by the gpu with no map/unmap per upload
+	constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	m_pbo = Buffer::create(m_settings.staging_bytes, nullptr, flags);
+	m_mapped = static_cast<uint8_t*>(m_pbo.map_range(0, m_settings.staging_bytes, flags));
+
+	m_last_update = clock::now();
+}
+
+TextureLoader::~TextureLoader()
+{
+	// Jobs still queued find the flag and drop their request
+	m_stopping.store(true, std::memory_order_release);
+	m_jobs.wait(m_decoding);
+
+	Decoded image;
+	while (m_decoded.try_pop(image))
+		stbi_image_free(image.pixels);
+	for (auto& ready : m_ready)
+		stbi_image_free(ready.pixels);
+
+	for (auto& in_flight : m_in_flight)
+		glDeleteSync(in_flight.fence);
+
+	m_pbo.unmap();
+}
+
+void TextureLoader::decode_job(void* loader, uint32_t, uint32_t)
+{
+	static_cast<TextureLoader*>(loader)->decode_next();
+}
+
+void TextureLoader::decode_next()
+{
+	// Every job matches one pushed request, but a push may still be publishing
+	Request request;
+	while (!m_requests.try_pop(request))
+		std::this_thread::yield();
+	if (m_stopping.load(std::memory_order_acquire))
+		return;
+
+	// The flag is per thread, image rows are flipped so uv (0, 0) is the bottom left like GL expects
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	PROFILE_CPU("texture load");
+	Decoded image;
+	image.handle = request.handle;
+
+	const auto cooked_path = request.path + texture_file_extension;
+	if (image.cooked.open(cooked_path.c_str()))
+	{
+		image.header = parse_texture_file(image.cooked.data(), image.cooked.size());
+		if (image.header)
+		{
+			// Fault the pages in here rather than on the GL thread during upload
+			image.cooked.prefetch();
+			image.width = static_cast<int32_t>(image.header->width);
+			image.height = static_cast<int32_t>(image.header->height);
+			image.channels = 4;
+		}
+		else
+		{
+			spdlog::warn("Ignoring invalid or outdated texture container {}", cooked_path);
+		}
+	}
+
+	if (!image.header)
+	{
+		image.pixels = stbi_load(request.path.c_str(), &image.width, &image.height, &image.channels, 0);
+		if (!image.pixels)
+		{
+			spdlog::error("Failed to load image {}: {}", request.path, stbi_failure_reason());
+		}
+	}
+
+	while (!m_decoded.try_push(image))
+	{
+		if (m_stopping.load(std::memory_order_acquire))
+		{
+			stbi_image_free(image.pixels);
+			return;
+		}
+		std::this_thread::yield();
+	}
+}
+
+auto TextureLoader::load(const char* path) -> Handle
+{
+	const auto handle = static_cast<Handle>(m_slots.size());
+
+	Slot slot;
+	slot.path = path;
+	slot.texture = Texture::create(GL_TEXTURE_2D);
+	m_slots.push_back(std::move(slot));
+
+	if (m_outstanding == 0)
+	{
+		m_stream_start = clock::now();
+		m_streamed_count = 0;
+		m_streamed_bytes = 0;
+		m_streamed_cooked = 0;
+		m_worst_frame_ms = 0.0;
+		m_worst_update_ms = 0.0;
+	}
+	m_outstanding++;
+
+	Request request{ handle, path };
+	if (m_overflow.empty() && m_requests.try_push(request))
+		m_jobs.run(&TextureLoader::decode_job, this, 0, 1, &m_decoding);
+	else
+		m_overflow.push_back(std::move(request));
+
+	return handle;
+}
+
+auto TextureLoader::texture(Handle handle) const noexcept -> uint32_t
+{
+	const auto& slot = m_slots[handle];
+	return slot.resident ? slot.texture.id() : m_placeholder.id();
+}
+
+void TextureLoader::retire_staging()
+{
+	while (!m_in_flight.empty())
+	{
+		auto& oldest = m_in_flight.front();
+		const auto status = glClientWaitSync(oldest.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(oldest.fence);
+		m_in_flight.pop_front();
+	}
+
+	if (m_in_flight.empty())
+		m_head = 0;
+}
+
+// Carves size bytes out of the ring without overwriting anything the gpu may still read
+auto TextureLoader::allocate_staging(size_t size) -> size_t
+{
+	const size_t capacity = m_settings.staging_bytes;
+	size = align_up(size, staging_alignment);
+
+	if (m_in_flight.empty())
+	{
+		if (m_head + size > capacity)
+			return no_space;
+		const size_t offset = m_head;
+		m_head += size;
+		return offset;
+	}
+
+	const size_t tail = m_in_flight.front().begin;
+	if (m_head >= tail)
+	{
+		// Free space is [head, capacity) then [0, tail)
+		if (m_head + size <= capacity)
+		{
+			const size_t offset = m_head;
+			m_head += size;
+			return offset;
+		}
+		if (size < tail)
+		{
+			m_head = size;
+			return 0;
+		}
+		return no_space;
+	}
+
+	// Wrapped, free space is [head, tail)
+	if (m_head + size < tail)
+	{
+		const size_t offset = m_head;
+		m_head += size;
+		return offset;
+	}
+	return no_space;
+}
+
+void TextureLoader::allocate_texture(const Texture& texture, int32_t levels, GLenum internal_format, int32_t width, int32_t height)
+{
+	texture.storage_2d(levels, internal_format, width, height);
+
+	texture.parameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+	texture.parameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	texture.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	texture.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void TextureLoader::upload(const Decoded& image, size_t staging_offset)
+{
+	static constexpr GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	static constexpr GLenum internal_formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+
+	const GLenum format = formats[image.channels - 1];
+	const GLenum internal_format = internal_formats[image.channels - 1];
+	const auto& texture = m_slots[image.handle].texture;
+	allocate_texture(texture, mip_levels(image.width, image.height), internal_format, image.width, image.height);
+
+	// Rows of 1-3 channel images aren't necessarily 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (staging_offset != no_space)
+	{
+		gl_state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, m_pbo.id());
+		texture.sub_image_2d(0, image.width, image.height, format, GL_UNSIGNED_BYTE, (void*)staging_offset);
+		gl_state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		// Bigger than the whole ring, upload straight from client memory
+		texture.sub_image_2d(0, image.width, image.height, format, GL_UNSIGNED_BYTE, image.pixels);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	texture.generate_mipmap();
+}
+
+// Every level was built by the cook step, each one goes to the driver straight from the mapping
+void TextureLoader::upload_cooked(const Decoded& image)
+{
+	const auto* header = image.header;
+	const auto* levels = texture_file_levels(header);
+	const auto& texture = m_slots[image.handle].texture;
+	allocate_texture(texture, static_cast<int32_t>(header->level_count), GL_RGBA8, image.width, image.height);
+
+	for (uint32_t i = 0; i < header->level_count; i++)
+	{
+		const auto& level = levels[i];
+		texture.sub_image_2d(static_cast<int32_t>(i), level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, image.cooked.data() + level.offset);
+	}
+}
+
+void TextureLoader::update()
+{
+	const auto start = clock::now();
+	if (m_outstanding > 0)
+		m_worst_frame_ms = std::max(m_worst_frame_ms, std::chrono::duration<double, std::milli>(start - m_last_update).count());
+	m_last_update = start;
+
+	if (m_outstanding == 0)
+		return;
+
+	PROFILE_CPU("texture upload");
+	while (!m_overflow.empty() && m_requests.try_push(m_overflow.front()))
+	{
+		m_overflow.pop_front();
+		m_jobs.run(&TextureLoader::decode_job, this, 0, 1, &m_decoding);
+	}
+
+	// Without workers nobody else runs the decode jobs, parallel_for runs its range inline
+	// and never gets to them. Decoded here instead, a hitch but --threads 1 still loads
+	if (m_jobs.thread_count() == 1)
+		m_jobs.wait(m_decoding);
+
+	Decoded image;
+	while (m_decoded.try_pop(image))
+		m_ready.push_back(std::move(image));
+
+	retire_staging();
+
+	const size_t frame_begin = m_head;
+	bool staged = false;
+	bool uploaded = false;
+	size_t budget = m_settings.upload_budget;
+
+	while (!m_ready.empty())
+	{
+		auto& next = m_ready.front();
+		auto& slot = m_slots[next.handle];
+
+		if (!next.pixels && !next.header)
+		{
+			slot.failed = true;
+			m_ready.pop_front();
+			m_outstanding--;
+			continue;
+		}
+
+		size_t size = static_cast<size_t>(next.width) * next.height * next.channels;
+		if (next.header)
+		{
+			size = 0;
+			const auto* levels = texture_file_levels(next.header);
+			for (uint32_t i = 0; i < next.header->level_count; i++)
+				size += levels[i].size;
+		}
+
+		// Always let one through so a texture bigger than the budget still makes progress
+		if (size > budget && uploaded)
+			break;
+
+		if (next.header)
+		{
+			upload_cooked(next);
+			m_streamed_cooked++;
+		}
+		else
+		{
+			size_t offset = no_space;
+			if (size <= m_settings.staging_bytes)
+			{
+				offset = allocate_staging(size);
+				// The ring is full of data the gpu hasn't consumed yet, try again next frame
+				if (offset == no_space)
+					break;
+				std::memcpy(m_mapped + offset, next.pixels, size);
+				staged = true;
+			}
+			upload(next, offset);
+		}
+
+		slot.resident = true;
+		uploaded = true;
+
+		budget -= std::min(budget, size);
+		m_streamed_count++;
+		m_streamed_bytes += size;
+		m_outstanding--;
+
+		stbi_image_free(next.pixels);
+		m_ready.pop_front();
+	}
+
+	if (staged)
+	{
+		// One fence covers every upload this frame
+		m_in_flight.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frame_begin, m_head });
+	}
+
+	const auto end = clock::now();
+	m_worst_update_ms = std::max(m_worst_update_ms, std::chrono::duration<double, std::milli>(end - start).count());
+
+	if (m_outstanding == 0)
+	{
+		spdlog::info("Streamed {} textures ({} cooked, {:.1f} MiB) in {:.1f} ms, worst frame {:.2f} ms, worst upload step {:.2f} ms",
+			m_streamed_count,
+			m_streamed_cooked,
+			m_streamed_bytes / (1024.0 * 1024.0),
+			std::chrono::duration<double, std::milli>(end - m_stream_start).count(),
+			m_worst_frame_ms,
+			m_worst_update_ms);
+	}
+}
@@ -0,0 +1,175 @@
+#include "texture_residency.h"
+
+#include <algorithm>
+#include <utility>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include "gl_error.h"
+#include "gl_extensions.h"
+
+constexpr int32_t initial_layers = 8;
+
+TextureResidency::TextureResidency(const Sampler& sampler, bool allow_bindless)
+	: m_sampler(sampler.id()), m_bindless(allow_bindless && gl_extensions.bindless_texture)
+{
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_max_layers);
+}
+
+TextureResidency::~TextureResidency() noexcept
+{
+	for (const auto handle : m_handles)
+		gl_extensions.make_texture_handle_non_resident(handle);
+}
+
+auto TextureResidency::add_material(std::initializer_list<TextureLoader::Handle> textures) -> uint32_t
+{
+	if (textures.size() > textures_per_material)
+		throw gl_error(fmt::format("Materials hold at most {} textures", textures_per_material));
+
+	const uint32_t material = material_count();
+	m_table.resize(m_table.size() + textures_per_material, Entry{ missing, missing });
+
+	uint32_t slot = 0;
+	for (const auto texture : textures)
+		m_pending.push_back({ material * textures_per_material + slot++, texture });
+	return material;
+}
+
+void TextureResidency::update(const TextureLoader& loader)
+{
+	for (size_t i = 0; i < m_pending.size();)
+	{
+		const auto pending = m_pending[i];
+		if (!loader.failed(pending.texture) && !loader.resident(pending.texture))
+		{
+			i++;
+			continue;
+		}
+
+		// Failed loads keep the placeholder for good
+		if (!loader.failed(pending.texture))
+		{
+			if (pending.texture >= m_resident.size())
+				m_resident.resize(pending.texture + 1, Entry{ missing, missing });
+			auto& entry = m_resident[pending.texture];
+			if (entry[0] == missing)
+				entry = make_resident(loader.texture(pending.texture));
+
+			m_table[pending.entry] = entry;
+			m_dirty_begin = std::min<size_t>(m_dirty_begin, pending.entry);
+			m_dirty_end = std::max<size_t>(m_dirty_end, pending.entry + 1);
+		}
+
+		m_pending[i] = m_pending.back();
+		m_pending.pop_back();
+	}
+
+	if (m_table.empty())
+		return;
+
+	if (m_table_capacity < m_table.size())
+	{
+		m_table_buffer = Buffer::create(sizeof(Entry) * m_table.size(), m_table.data(), GL_DYNAMIC_STORAGE_BIT);
+		m_table_capacity = m_table.size();
+	}
+	else if (m_dirty_begin < m_dirty_end)
+	{
+		m_table_buffer.sub_data(sizeof(Entry) * m_dirty_begin, sizeof(Entry) * (m_dirty_end - m_dirty_begin), m_table.data() + m_dirty_begin);
+	}
+	m_dirty_begin = SIZE_MAX;
+	m_dirty_end = 0;
+}
+
+void TextureResidency::bind(uint32_t binding) const noexcept
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_table_buffer.id());
+}
+
+auto TextureResidency::make_resident(uint32_t texture) -> Entry
+{
+	if (!m_bindless)
+		return add_layer(texture);
+
+	const GLuint64 handle = gl_extensions.get_texture_sampler_handle(texture, m_sampler);
+	gl_extensions.make_texture_handle_resident(handle);
+	m_handles.push_back(handle);
+	return { static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32) };
+}
+
+auto TextureResidency::add_layer(uint32_t texture) -> Entry
+{
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t internal_format = 0;
+	int32_t levels = 0;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+	glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+
+	auto it = std::find_if(m_arrays.begin(), m_arrays.end(), [&](const TextureArray& array) {
+		return array.width == width && array.height == height && array.internal_format == static_cast<GLenum>(internal_format) && array.levels == levels;
+	});
+
+	if (it == m_arrays.end())
+	{
+		if (m_arrays.size() == max_arrays)
+		{
+			if (!std::exchange(m_full_logged, true))
+				spdlog::warn("Textures come in more than {} sizes and formats, the rest keep the placeholder", max_arrays);
+			return { missing, missing };
+		}
+
+		TextureArray array;
+		array.internal_format = static_cast<GLenum>(internal_format);
+		array.width = width;
+		array.height = height;
+		array.levels = levels;
+		grow(array, std::min(initial_layers, m_max_layers));
+		m_arrays.push_back(std::move(array));
+		it = m_arrays.end() - 1;
+	}
+
+	auto& array = *it;
+	if (array.layers == array.capacity)
+	{
+		if (array.capacity >= m_max_layers)
+		{
+			if (!std::exchange(m_full_logged, true))
+				spdlog::warn("Texture array {}x{} is at the limit of {} layers, the rest keep the placeholder", width, height, m_max_layers);
+			return { missing, missing };
+		}
+		grow(array, std::min(array.capacity * 2, m_max_layers));
+	}
+
+	// Copied on the gpu, the source texture stays with the loader
+	const int32_t layer = array.layers++;
+	for (int32_t level = 0; level < levels; level++)
+	{
+		glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0,
+			array.texture.id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+			std::max(width >> level, 1), std::max(height >> level, 1), 1);
+	}
+
+	const auto index = static_cast<uint32_t>(it - m_arrays.begin());
+	return { index << 24 | static_cast<uint32_t>(layer), 0 };
+}
+
+void TextureResidency::grow(TextureArray& array, int32_t capacity)
+{
+	auto texture = Texture::create(GL_TEXTURE_2D_ARRAY);
+	texture.storage_3d(array.levels, array.internal_format, array.width, array.height, capacity);
+
+	if (array.layers > 0)
+	{
+		for (int32_t level = 0; level < array.levels; level++)
+		{
+			glCopyImageSubData(array.texture.id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+				texture.id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+				std::max(array.width >> level, 1), std::max(array.height >> level, 1), array.layers);
+		}
+	}
+
+	array.texture = std::move(texture);
+	array.capacity = capacity;
+}
@@ -0,0 +1,249 @@
+#include "transform.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "platfrom.h"
+#include "transform_simd.h"
+
+#if defined(SIMD_X86)
+#include <emmintrin.h>
+#if defined(MSVC)
+#include <intrin.h>
+#endif
+#endif
+
+void TransformSoA::reserve(size_t count)
+{
+	pos_x.reserve(count);
+	pos_y.reserve(count);
+	pos_z.reserve(count);
+	axis_x.reserve(count);
+	axis_y.reserve(count);
+	axis_z.reserve(count);
+	angle.reserve(count);
+	scale.reserve(count);
+}
+
+void TransformSoA::push_back(const glm::vec3& position, const glm::vec3& axis, float_t angle_radians, float_t uniform_scale)
+{
+	const auto n = glm::normalize(axis);
+
+	pos_x.push_back(position.x);
+	pos_y.push_back(position.y);
+	pos_z.push_back(position.z);
+	axis_x.push_back(n.x);
+	axis_y.push_back(n.y);
+	axis_z.push_back(n.z);
+	angle.push_back(static_cast<float_t>(std::remainder(static_cast<double>(angle_radians), 2.0 * glm::pi<double>())));
+	scale.push_back(uniform_scale);
+}
+
+#if defined(SIMD_X86)
+
+namespace
+{
+
+struct Sse2
+{
+	using f = __m128;
+	using i = __m128i;
+	static constexpr size_t width = 4;
+
+	static f load(const float* p) { return _mm_loadu_ps(p); }
+	static f set1(float v) { return _mm_set1_ps(v); }
+	static f add(f a, f b) { return _mm_add_ps(a, b); }
+	static f sub(f a, f b) { return _mm_sub_ps(a, b); }
+	static f mul(f a, f b) { return _mm_mul_ps(a, b); }
+	static f and_(f a, f b) { return _mm_and_ps(a, b); }
+	static f andnot(f a, f b) { return _mm_andnot_ps(a, b); }
+	static f or_(f a, f b) { return _mm_or_ps(a, b); }
+	static f xor_(f a, f b) { return _mm_xor_ps(a, b); }
+	static f sign_mask() { return _mm_castsi128_ps(_mm_set1_epi32(INT32_MIN)); }
+
+	static i set1_i(int32_t v) { return _mm_set1_epi32(v); }
+	static i cvtt(f a) { return _mm_cvttps_epi32(a); }
+	static f cvt(i a) { return _mm_cvtepi32_ps(a); }
+	static f cast_f(i a) { return _mm_castsi128_ps(a); }
+	static i add_i(i a, i b) { return _mm_add_epi32(a, b); }
+	static i sub_i(i a, i b) { return _mm_sub_epi32(a, b); }
+	static i and_i(i a, i b) { return _mm_and_si128(a, b); }
+	static i andnot_i(i a, i b) { return _mm_andnot_si128(a, b); }
+	static i cmpeq_i(i a, i b) { return _mm_cmpeq_epi32(a, b); }
+	static i shl29(i a) { return _mm_slli_epi32(a, 29); }
+
+	// Transposes a, b, c, d so object k gets (a[k], b[k], c[k], d[k]) at dst + k * 16
+	static void store_columns(float* dst, f a, f b, f c, f d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_storeu_ps(dst + 0, a);
+		_mm_storeu_ps(dst + 16, b);
+		_mm_storeu_ps(dst + 32, c);
+		_mm_storeu_ps(dst + 48, d);
+	}
+};
+
+}
+
+static auto cpu_has_avx2() noexcept -> bool
+{
+#if defined(GCC)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(MSVC)
+	int regs[4];
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool fma = (regs[2] & (1 << 12)) != 0;
+	if (!osxsave || !fma)
+		return false;
+	// The OS has to save the ymm registers on context switch
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+#endif // defined(SIMD_X86)
+
+auto best_simd_level() noexcept -> SimdLevel
+{
+#if defined(SIMD_X86)
+	static const SimdLevel level = cpu_has_avx2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+	return level;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+auto simd_level_name(SimdLevel level) -> const char*
+{
+	switch (level)
+	{
+	case SimdLevel::Scalar:
+		return "scalar";
+	case SimdLevel::SSE2:
+		return "sse2";
+	case SimdLevel::AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+#if defined(SIMD_X86)
+
+static auto arrays_of(const TransformSoA& t) -> transform_simd::TransformArrays
+{
+	return { t.pos_x.data(), t.pos_y.data(), t.pos_z.data(), t.axis_x.data(), t.axis_y.data(), t.axis_z.data(), t.angle.data(), t.scale.data() };
+}
+
+static auto arrays_of(const transform_simd::TransformGather& t) -> transform_simd::TransformArrays
+{
+	return { t.pos_x, t.pos_y, t.pos_z, t.axis_x, t.axis_y, t.axis_z, t.angle, t.scale };
+}
+
+#endif // defined(SIMD_X86)
+
+template<typename Transforms>
+static auto model_matrix(const Transforms& t, size_t i) -> glm::mat4
+{
+	auto model = glm::translate(glm::mat4(1.0f), glm::vec3(t.pos_x[i], t.pos_y[i], t.pos_z[i]));
+	model = glm::rotate(model, t.angle[i], glm::vec3(t.axis_x[i], t.axis_y[i], t.axis_z[i]));
+	return glm::scale(model, glm::vec3(t.scale[i]));
+}
+
+// Matrices of transforms begin .. end, written to out + begin * 16
+template<typename Transforms>
+static void build_model_range(const Transforms& transforms, size_t begin, size_t end, float_t* out, SimdLevel level)
+{
+	size_t first = begin;
+
+#if defined(SIMD_X86)
+	if (level == SimdLevel::AVX2)
+		first = transform_simd::build_models_avx2(arrays_of(transforms), begin, end, out);
+	else if (level == SimdLevel::SSE2)
+		first = transform_simd::build_models<Sse2>(arrays_of(transforms), begin, end, out);
+#endif
+
+	// Scalar fallback, also handles the tail that does not fill a whole batch
+	auto* dst = reinterpret_cast<glm::mat4*>(out);
+	for (size_t i = first; i < end; i++)
+	{
+		dst[i] = model_matrix(transforms, i);
+	}
+}
+
+void build_model_matrices(const TransformSoA& transforms, float_t* out, SimdLevel level)
+{
+	build_model_range(transforms, 0, transforms.size(), out, level);
+}
+
+void build_model_matrices(const TransformSoA& transforms, const uint32_t* indices, size_t count, float_t* out, SimdLevel level)
+{
+	// Gather small chunks into a contiguous scratch copy on the stack that stays in cache, then
+	// run the batch kernel on it. Nothing to allocate, whichever thread runs this
+	transform_simd::TransformGather chunk;
+	constexpr size_t chunk_size = transform_simd::TransformGather::capacity;
+
+	for (size_t first = 0; first < count; first += chunk_size)
+	{
+		const size_t n = std::min(chunk_size, count - first);
+		const uint32_t* ids = indices + first;
+
+		for (size_t i = 0; i < n; i++)
+		{
+			const uint32_t id = ids[i];
+			chunk.pos_x[i] = transforms.pos_x[id];
+			chunk.pos_y[i] = transforms.pos_y[id];
+			chunk.pos_z[i] = transforms.pos_z[id];
+			chunk.axis_x[i] = transforms.axis_x[id];
+			chunk.axis_y[i] = transforms.axis_y[id];
+			chunk.axis_z[i] = transforms.axis_z[id];
+			chunk.angle[i] = transforms.angle[id];
+			chunk.scale[i] = transforms.scale[id];
+		}
+
+		build_model_range(chunk, 0, n, out + first * 16, level);
+	}
+}
+
+void build_model_matrices(JobSystem& jobs, const TransformSoA& transforms, float_t* out, SimdLevel level)
+{
+	// Ranges start on a multiple of 8, so only the last one has a scalar tail and every
+	// matrix comes out of the same kernel as it does on one thread
+	const auto batches = static_cast<uint32_t>((transforms.size() + 7) / 8);
+	jobs.parallel_for(batches, parallel_grain / 8, [&](uint32_t begin, uint32_t end) {
+		build_model_range(transforms, size_t(begin) * 8, std::min(size_t(end) * 8, transforms.size()), out, level);
+	});
+}
+
+void build_model_matrices(JobSystem& jobs, const TransformSoA& transforms, const uint32_t* indices, size_t count, float_t* out, SimdLevel level)
+{
+	const auto batches = static_cast<uint32_t>((count + 7) / 8);
+	jobs.parallel_for(batches, parallel_grain / 8, [&](uint32_t begin, uint32_t end) {
+		const size_t first = size_t(begin) * 8;
+		build_model_matrices(transforms, indices + first, std::min(size_t(end) * 8, count) - first, out + first * 16, level);
+	});
+}
+
+void build_mvp_matrices(const TransformSoA& transforms, const glm::mat4& view_proj, float_t* out, SimdLevel level)
+{
+	size_t first = 0;
+
+#if defined(SIMD_X86)
+	if (level == SimdLevel::AVX2)
+		first = transform_simd::build_mvps_avx2(arrays_of(transforms), transforms.size(), glm::value_ptr(view_proj), out);
+	else if (level == SimdLevel::SSE2)
+		first = transform_simd::build_mvps<Sse2>(arrays_of(transforms), transforms.size(), glm::value_ptr(view_proj), out);
+#endif
+
+	auto* dst = reinterpret_cast<glm::mat4*>(out);
+	for (size_t i = first; i < transforms.size(); i++)
+	{
+		dst[i] = view_proj * model_matrix(transforms, i);
+	}
+}
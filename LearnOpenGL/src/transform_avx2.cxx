@@ -0,0 +1,77 @@
+// Built with AVX2 enabled (see CMakeLists.txt), only called after
+// best_simd_level() has checked the cpu supports it
+
+#include "transform_simd.h"
+
+#if defined(SIMD_X86)
+
+#include <cstdint>
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx2
+{
+	using f = __m256;
+	using i = __m256i;
+	static constexpr size_t width = 8;
+
+	static f load(const float* p) { return _mm256_loadu_ps(p); }
+	static f set1(float v) { return _mm256_set1_ps(v); }
+	static f add(f a, f b) { return _mm256_add_ps(a, b); }
+	static f sub(f a, f b) { return _mm256_sub_ps(a, b); }
+	static f mul(f a, f b) { return _mm256_mul_ps(a, b); }
+	static f and_(f a, f b) { return _mm256_and_ps(a, b); }
+	static f andnot(f a, f b) { return _mm256_andnot_ps(a, b); }
+	static f or_(f a, f b) { return _mm256_or_ps(a, b); }
+	static f xor_(f a, f b) { return _mm256_xor_ps(a, b); }
+	static f sign_mask() { return _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MIN)); }
+
+	static i set1_i(int32_t v) { return _mm256_set1_epi32(v); }
+	static i cvtt(f a) { return _mm256_cvttps_epi32(a); }
+	static f cvt(i a) { return _mm256_cvtepi32_ps(a); }
+	static f cast_f(i a) { return _mm256_castsi256_ps(a); }
+	static i add_i(i a, i b) { return _mm256_add_epi32(a, b); }
+	static i sub_i(i a, i b) { return _mm256_sub_epi32(a, b); }
+	static i and_i(i a, i b) { return _mm256_and_si256(a, b); }
+	static i andnot_i(i a, i b) { return _mm256_andnot_si256(a, b); }
+	static i cmpeq_i(i a, i b) { return _mm256_cmpeq_epi32(a, b); }
+	static i shl29(i a) { return _mm256_slli_epi32(a, 29); }
+
+	// 4x4 transpose within each 128 bit lane, the low lane holds objects 0-3 and the high lane 4-7
+	static void store_columns(float* dst, f a, f b, f c, f d)
+	{
+		const f t0 = _mm256_unpacklo_ps(a, b);
+		const f t1 = _mm256_unpackhi_ps(a, b);
+		const f t2 = _mm256_unpacklo_ps(c, d);
+		const f t3 = _mm256_unpackhi_ps(c, d);
+		const f r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		const f r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		const f r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		const f r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+		_mm_storeu_ps(dst + 0, _mm256_castps256_ps128(r0));
+		_mm_storeu_ps(dst + 16, _mm256_castps256_ps128(r1));
+		_mm_storeu_ps(dst + 32, _mm256_castps256_ps128(r2));
+		_mm_storeu_ps(dst + 48, _mm256_castps256_ps128(r3));
+		_mm_storeu_ps(dst + 64, _mm256_extractf128_ps(r0, 1));
+		_mm_storeu_ps(dst + 80, _mm256_extractf128_ps(r1, 1));
+		_mm_storeu_ps(dst + 96, _mm256_extractf128_ps(r2, 1));
+		_mm_storeu_ps(dst + 112, _mm256_extractf128_ps(r3, 1));
+	}
+};
+
+}
+
+auto transform_simd::build_models_avx2(const TransformArrays& t, size_t begin, size_t end, float* out) -> size_t
+{
+	return build_models<Avx2>(t, begin, end, out);
+}
+
+auto transform_simd::build_mvps_avx2(const TransformArrays& t, size_t size, const float* vp, float* out) -> size_t
+{
+	return build_mvps<Avx2>(t, size, vp, out);
+}
+
+#endif // defined(SIMD_X86)
@@ -0,0 +1,89 @@
+#include "uniforms.h"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include "gl_error.h"
+
+auto is_opaque_uniform_type(uint32_t type) noexcept -> bool
+{
+	// Samplers, images and atomic counters, all set through glUniform1i
+	return (type >= GL_SAMPLER_1D && type <= GL_SAMPLER_2D_RECT_SHADOW)
+		|| (type >= GL_SAMPLER_1D_ARRAY && type <= GL_UNSIGNED_INT_SAMPLER_BUFFER && type != GL_UNSIGNED_INT_VEC2
+			&& type != GL_UNSIGNED_INT_VEC3 && type != GL_UNSIGNED_INT_VEC4)
+		|| (type >= GL_SAMPLER_CUBE_MAP_ARRAY && type <= GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY)
+		|| (type >= GL_IMAGE_1D && type <= GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY)
+		|| (type >= GL_SAMPLER_2D_MULTISAMPLE && type <= GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY)
+		|| type == GL_UNSIGNED_INT_ATOMIC_COUNTER;
+}
+
+auto UniformTable::reflect(uint32_t program) -> UniformTable
+{
+	UniformTable table(program);
+
+	int32_t count = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+	int32_t max_name_length = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &max_name_length);
+	std::string name(static_cast<size_t>(std::max(max_name_length, 1)), '\0');
+
+	constexpr GLenum props[] = { GL_BLOCK_INDEX, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+	for (int32_t i = 0; i < count; i++)
+	{
+		int32_t values[std::size(props)];
+		glGetProgramResourceiv(program, GL_UNIFORM, i, static_cast<GLsizei>(std::size(props)), props, static_cast<GLsizei>(std::size(values)), nullptr, values);
+
+		// Members of uniform blocks have no location, they're set through buffers
+		if (values[0] != -1 || values[1] == -1)
+			continue;
+
+		int32_t length = 0;
+		glGetProgramResourceName(program, GL_UNIFORM, i, static_cast<GLsizei>(name.size()), &length, name.data());
+
+		// Arrays are reported as "name[0]", register them under the plain name
+		std::string_view view(name.data(), static_cast<size_t>(length));
+		if (view.ends_with("[0]"))
+			view.remove_suffix(3);
+
+		table.add(view, values[1], static_cast<uint32_t>(values[2]), values[3]);
+	}
+
+	return table;
+}
+
+void UniformTable::add(std::string_view name, int32_t location, uint32_t type, int32_t count)
+{
+	const uint64_t hash = fnv1a(name);
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), hash, [](const Entry& entry, uint64_t h) { return entry.hash < h; });
+	if (it != m_entries.end() && it->hash == hash)
+	{
+		if (it->name != name)
+			throw gl_error(fmt::format("Uniform names {} and {} hash to the same value", it->name, name));
+		it->uniform = { location, type, count };
+		return;
+	}
+
+	m_entries.insert(it, Entry{ hash, { location, type, count }, std::string(name) });
+}
+
+auto UniformTable::find(UniformName name) const -> Uniform
+{
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), name.hash, [](const Entry& entry, uint64_t h) { return entry.hash < h; });
+	// A name hashing like a different active uniform is a miss, not that uniform
+	if (it == m_entries.end() || it->hash != name.hash || it->name != name.str)
+		throw gl_error(fmt::format("Uniform {} not found in program {}", name.str, m_program));
+	return it->uniform;
+}
+
+auto UniformTable::contains(UniformName name) const noexcept -> bool
+{
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), name.hash, [](const Entry& entry, uint64_t h) { return entry.hash < h; });
+	return it != m_entries.end() && it->hash == name.hash && it->name == name.str;
+}
+
+void UniformTable::throw_type_mismatch(const Uniform& uniform, const char* cpp_type) const
+{
+	auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry) { return entry.uniform.location == uniform.location; });
+	const std::string_view name = it != m_entries.end() ? std::string_view(it->name) : std::string_view("<unresolved>");
+	throw gl_error(fmt::format("Uniform {} in program {} has GL type 0x{:x}, it can't be set from a {}", name, m_program, uniform.type, cpp_type));
+}
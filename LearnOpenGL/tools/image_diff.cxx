@@ -0,0 +1,163 @@
+// Regression check for frame captures: compares a capture against a golden image pixel
+// by pixel.
+//
+//     image_diff <expected> <actual> [--threshold <0-255>] [--max-pixels <n>] [--diff <out.png>]
+//
+// A pixel differs when any color channel is further off than the threshold (default 0).
+// Exits 0 when at most max-pixels (default 0) differ, 1 when more do or the sizes don't
+// match and 2 when an image can't be read. --diff writes the actual image dimmed, with
+// the differing pixels in red.
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <spdlog/spdlog.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "png_encoder.h"
+
+constexpr int exit_different = 1;
+constexpr int exit_error = 2;
+
+struct Image
+{
+	std::unique_ptr<uint8_t, decltype(&stbi_image_free)> pixels{ nullptr, stbi_image_free };
+	int32_t width = 0;
+	int32_t height = 0;
+};
+
+// Anything stb_image reads, expanded to RGBA8
+static auto load_image(const char* path) -> Image
+{
+	Image image;
+	int32_t channels;
+	image.pixels.reset(stbi_load(path, &image.width, &image.height, &channels, 4));
+	if (!image.pixels)
+		spdlog::error("Failed to read {}: {}", path, stbi_failure_reason());
+	return image;
+}
+
+static auto parse_u32(std::string_view arg, std::string_view value, uint32_t& result) -> bool
+{
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+	if (ec != std::errc() || ptr != value.data() + value.size())
+	{
+		spdlog::error("Invalid value '{}' for {}", value, arg);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3 || argc % 2 == 0)
+	{
+		spdlog::error("Usage: {} <expected> <actual> [--threshold <0-255>] [--max-pixels <n>] [--diff <out.png>]", argv[0]);
+		return exit_error;
+	}
+
+	uint32_t threshold = 0;
+	uint32_t max_pixels = 0;
+	const char* diff_path = nullptr;
+	for (int i = 3; i + 1 < argc; i += 2)
+	{
+		const std::string_view arg = argv[i];
+		if (arg == "--threshold")
+		{
+			if (!parse_u32(arg, argv[i + 1], threshold))
+				return exit_error;
+		}
+		else if (arg == "--max-pixels")
+		{
+			if (!parse_u32(arg, argv[i + 1], max_pixels))
+				return exit_error;
+		}
+		else if (arg == "--diff")
+		{
+			diff_path = argv[i + 1];
+		}
+		else
+		{
+			spdlog::error("Unknown option {}", arg);
+			return exit_error;
+		}
+	}
+
+	const auto expected = load_image(argv[1]);
+	const auto actual = load_image(argv[2]);
+	if (!expected.pixels || !actual.pixels)
+		return exit_error;
+
+	if (expected.width != actual.width || expected.height != actual.height)
+	{
+		spdlog::error("Size differs: {}x{} expected, {}x{} actual", expected.width, expected.height, actual.width, actual.height);
+		return exit_different;
+	}
+
+	// Alpha is left out, captures are written opaque and goldens may not be
+	const size_t pixel_count = size_t(actual.width) * actual.height;
+	const uint8_t* a = expected.pixels.get();
+	const uint8_t* b = actual.pixels.get();
+	std::vector<uint8_t> diff(diff_path ? pixel_count * 4 : 0);
+
+	size_t differing = 0;
+	uint32_t max_error = 0;
+	uint64_t squared_error = 0;
+	for (size_t i = 0; i < pixel_count; i++)
+	{
+		uint32_t error = 0;
+		for (size_t c = 0; c < 3; c++)
+		{
+			const int32_t delta = int32_t(a[i * 4 + c]) - int32_t(b[i * 4 + c]);
+			error = std::max<uint32_t>(error, std::abs(delta));
+			squared_error += uint64_t(delta * delta);
+		}
+		max_error = std::max(max_error, error);
+		const bool differs = error > threshold;
+		differing += differs ? 1 : 0;
+
+		if (diff_path)
+		{
+			uint8_t* out = diff.data() + i * 4;
+			const auto dimmed = static_cast<uint8_t>((b[i * 4] + b[i * 4 + 1] + b[i * 4 + 2]) / 9);
+			out[0] = differs ? static_cast<uint8_t>(std::min<uint32_t>(255, 128 + error)) : dimmed;
+			out[1] = differs ? 0 : dimmed;
+			out[2] = differs ? 0 : dimmed;
+			out[3] = 0xff;
+		}
+	}
+
+	const double mse = double(squared_error) / double(pixel_count * 3);
+	const double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+	spdlog::info("{}x{}: {} pixels differ by more than {} ({:.3f}%), max channel error {}, PSNR {:.2f} dB",
+		actual.width, actual.height, differing, threshold, 100.0 * differing / pixel_count, max_error, psnr);
+
+	if (diff_path)
+	{
+		PngEncoder encoder;
+		const auto png = encoder.encode(diff.data(), actual.width, actual.height, ptrdiff_t(actual.width) * 4, true);
+		std::FILE* file = std::fopen(diff_path, "wb");
+		const bool written = file && std::fwrite(png.data(), 1, png.size(), file) == png.size();
+		if (file)
+			std::fclose(file);
+		if (!written)
+		{
+			spdlog::error("Failed to write {}", diff_path);
+			return exit_error;
+		}
+	}
+
+	if (differing > max_pixels)
+	{
+		spdlog::error("{} differs from {} in {} pixels, at most {} allowed", argv[2], argv[1], differing, max_pixels);
+		return exit_different;
+	}
+	return EXIT_SUCCESS;
+}
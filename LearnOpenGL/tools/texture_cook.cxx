@@ -0,0 +1,206 @@
+// Build step: decodes an image once, builds its full mip chain and writes it out as a
+// .ltex container (see texture_file.h) that the runtime maps instead of decoding.
+//
+//     texture_cook <source image> <output .ltex>
+//
+// Sources whose hash matches the one stored in an existing output are skipped. Sources
+// that can't be read or decoded (a Git LFS pointer for one) are skipped with a warning
+// and leave no output, the runtime falls back to decoding them with stb_image.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#if defined(SIMD_X86)
+#include <emmintrin.h>
+#endif
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "texture_file.h"
+
+constexpr size_t level_alignment = 16;
+
+static auto align_up(size_t value, size_t alignment) -> size_t
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Warns and removes a stale output, the build goes on without this texture cooked
+static auto skip(const std::filesystem::path& output_path, const std::string& reason) -> int
+{
+	std::error_code ec;
+	std::filesystem::remove(output_path, ec);
+	spdlog::warn("Skipping {}: {}, it will be decoded at runtime", output_path.string(), reason);
+	return EXIT_SUCCESS;
+}
+
+static auto read_bytes(const std::filesystem::path& path) -> std::vector<uint8_t>
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return {};
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// 2x2 box filter from an RGBA8 level to the next one, odd edges clamp to the last row / column
+static void downsample(const uint8_t* src, uint32_t src_width, uint32_t src_height, uint8_t* dst, uint32_t width, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* row0 = src + size_t(std::min(y * 2, src_height - 1)) * src_width * 4;
+		const uint8_t* row1 = src + size_t(std::min(y * 2 + 1, src_height - 1)) * src_width * 4;
+		uint8_t* out = dst + size_t(y) * width * 4;
+
+		uint32_t x = 0;
+#if defined(SIMD_X86)
+		// 8 source pixels from each row -> 4 output pixels, summed in 16 bits
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(2);
+		for (; x + 4 <= width; x += 4)
+		{
+			const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+			const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+			const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+			const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+
+			// Vertical sums, two pixels per register
+			const __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+			const __m128i p23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+			const __m128i p45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+			const __m128i p67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+			// Horizontal sums land in the low half of each register
+			const __m128i s0 = _mm_add_epi16(p01, _mm_srli_si128(p01, 8));
+			const __m128i s1 = _mm_add_epi16(p23, _mm_srli_si128(p23, 8));
+			const __m128i s2 = _mm_add_epi16(p45, _mm_srli_si128(p45, 8));
+			const __m128i s3 = _mm_add_epi16(p67, _mm_srli_si128(p67, 8));
+
+			const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), round), 2);
+			const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), round), 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(lo, hi));
+		}
+#endif
+		for (; x < width; x++)
+		{
+			const uint32_t x0 = std::min(x * 2, src_width - 1) * 4;
+			const uint32_t x1 = std::min(x * 2 + 1, src_width - 1) * 4;
+			for (uint32_t c = 0; c < 4; c++)
+				out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		spdlog::error("Usage: {} <source image> <output{}>", argv[0], texture_file_extension);
+		return EXIT_FAILURE;
+	}
+
+	const std::filesystem::path source_path = argv[1];
+	const std::filesystem::path output_path = argv[2];
+	const auto start = std::chrono::steady_clock::now();
+
+	const auto source = read_bytes(source_path);
+	if (source.empty())
+		return skip(output_path, fmt::format("failed to read {}", source_path.string()));
+	const uint64_t source_hash = fnv1a_bytes(source.data(), source.size());
+
+	{
+		MappedFile existing;
+		if (existing.open(output_path.string().c_str()))
+		{
+			const auto* header = parse_texture_file(existing.data(), existing.size());
+			if (header && header->source_hash == source_hash)
+			{
+				// Touched but unchanged, bump the output so the build doesn't ask again
+				std::filesystem::last_write_time(output_path, std::filesystem::file_time_type::clock::now());
+				spdlog::info("{} is up to date", output_path.string());
+				return EXIT_SUCCESS;
+			}
+		}
+	}
+
+	// Stored bottom row first, uv (0, 0) is the bottom left in GL. Always expanded to RGBA8,
+	// 3 channel uploads make the driver convert and don't keep rows 4 byte aligned
+	int32_t width, height, channels;
+	stbi_set_flip_vertically_on_load(true);
+	uint8_t* pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &channels, 4);
+	if (!pixels)
+		return skip(output_path, fmt::format("failed to decode {}: {}", source_path.string(), stbi_failure_reason()));
+
+	std::vector<TextureFileLevel> levels;
+	for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+	{
+		levels.push_back({ 0, uint64_t(w) * h * 4, w, h });
+		if (w == 1 && h == 1)
+			break;
+	}
+
+	size_t offset = align_up(sizeof(TextureFileHeader) + levels.size() * sizeof(TextureFileLevel), level_alignment);
+	for (auto& level : levels)
+	{
+		level.offset = offset;
+		offset = align_up(offset + level.size, level_alignment);
+	}
+
+	std::vector<uint8_t> file(offset, 0);
+
+	TextureFileHeader header{};
+	std::copy(std::begin(texture_file_magic), std::end(texture_file_magic), header.magic);
+	header.version = texture_file_version;
+	header.format = TextureFileFormat::RGBA8;
+	header.width = width;
+	header.height = height;
+	header.level_count = static_cast<uint32_t>(levels.size());
+	header.source_hash = source_hash;
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(TextureFileLevel));
+
+	std::memcpy(file.data() + levels[0].offset, pixels, levels[0].size);
+	stbi_image_free(pixels);
+
+	for (size_t i = 1; i < levels.size(); i++)
+	{
+		const auto& src = levels[i - 1];
+		const auto& dst = levels[i];
+		downsample(file.data() + src.offset, src.width, src.height, file.data() + dst.offset, dst.width, dst.height);
+	}
+
+	// Written next to the output and renamed over it, a failed cook never leaves a torn file behind
+	if (output_path.has_parent_path())
+		std::filesystem::create_directories(output_path.parent_path());
+	auto temp_path = output_path;
+	temp_path += ".tmp";
+	{
+		std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+		if (!out)
+		{
+			spdlog::error("Failed to write {}", temp_path.string());
+			return EXIT_FAILURE;
+		}
+	}
+	std::filesystem::rename(temp_path, output_path);
+
+	spdlog::info("Cooked {} ({}x{}, {} levels, {:.1f} KiB) in {:.1f} ms",
+		output_path.string(),
+		width, height, levels.size(),
+		file.size() / 1024.0,
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+	return EXIT_SUCCESS;
+}